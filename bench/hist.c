@@ -0,0 +1,81 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "hist.h"
+
+/* 0-3 one bucket each, then 4 buckets for each power of 2 */
+static int hist_bucket(uint64_t ns)
+{
+	int msb;
+
+	if (ns < 4) return (int)ns;
+	msb = 63 - __builtin_clzll(ns);
+	return (msb - 1) * 4 + (int)((ns >> (msb - 2)) & 3);
+}
+
+/* the largest ns in bucket i */
+static uint64_t hist_bucket_top(int i)
+{
+	int msb;
+
+	if (i < 4) return i;
+	msb = i / 4 + 1;
+	return ((uint64_t)(4 + i % 4 + 1) << (msb - 2)) - 1;
+}
+
+void hist_add(hist_t *h, uint64_t ns)
+{
+	h->buckets[hist_bucket(ns)]++;
+	h->count++;
+	if (ns > h->max) h->max = ns;
+	return;
+}
+
+void hist_merge(hist_t *to, const hist_t *from)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) to->buckets[i] += from->buckets[i];
+	to->count += from->count;
+	if (from->max > to->max) to->max = from->max;
+	return;
+}
+
+uint64_t hist_percentile(const hist_t *h, double percent)
+{
+	int i;
+	uint64_t seen = 0;
+	uint64_t rank;
+
+	if (!h->count) return 0;
+	rank = (uint64_t)(h->count * percent / 100.0);
+	if (rank >= h->count) rank = h->count - 1;
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen > rank) break;
+	}
+	if (i == HIST_BUCKETS || hist_bucket_top(i) > h->max) return h->max;
+	return hist_bucket_top(i);
+}
+
+void hist_print_json(FILE *fp, const hist_t *h)
+{
+	int i;
+	int first = 1;
+
+	fprintf(fp, "\"hist\":[");
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (!h->buckets[i]) continue;
+		fprintf(fp, "%s[%llu,%llu]", first ? "" : ",",
+			(unsigned long long)hist_bucket_top(i),
+			(unsigned long long)h->buckets[i]);
+		first = 0;
+	}
+	fprintf(fp, "]");
+	return;
+}
@@ -0,0 +1,33 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_bench_hist_h
+#define __zlog_bench_hist_h
+
+/* log linear histogram of ns, 4 buckets for each power of 2,
+ * so a percentile is off by 25% at most
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HIST_BUCKETS 256
+
+typedef struct {
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[HIST_BUCKETS];
+} hist_t;
+
+void hist_add(hist_t *h, uint64_t ns);
+void hist_merge(hist_t *to, const hist_t *from);
+uint64_t hist_percentile(const hist_t *h, double percent);
+/* "hist":[[top ns, count],...] of buckets not empty */
+void hist_print_json(FILE *fp, const hist_t *h);
+
+#endif
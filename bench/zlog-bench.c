@@ -0,0 +1,331 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+/* throughput and per call latency of zlog, one json line for a case.
+ * a case is processes x threads x loops of one call, of a message size,
+ * a format and an output. the latency of each call is taken with rdtsc,
+ * or clock_gettime() where there is no rdtsc, and kept in log linear
+ * histograms, 4 buckets for each power of 2 ns.
+ * with no case given, the whole matrix is run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_RDTSC 1
+#endif
+
+#include "zlog.h"
+#include "version.h"
+#include "hist.h"
+
+typedef struct {
+	long processes;
+	long threads;
+	long loops;
+	long size;
+	const char *format;
+	const char *output;
+} bench_case_t;
+
+static const char *formats[][2] = {
+	{ "msg", "%m%n" },
+	{ "time", "%d(%F %T).%us %-6V [%p:%T:%F:%L] %m%n" },
+	{ "mdc", "%M(user) %M(session) %M(request) %m%n" },
+};
+
+static const char *outputs[][2] = {
+	{ "file", "\"bench.log\"" },
+	{ "rotate", "\"bench.log\", 16MB * 2" },
+	{ "dynamic", "\"bench.%c.%d(%Y%m%d).log\"" },
+	{ "pipe", "| cat > /dev/null" },
+	{ "record", "$bench, \"bench.log\"" },
+	{ "off", "\"bench.log\"" },	/* the rule takes FATAL only, calls are INFO */
+};
+
+static zlog_category_t *zc;
+static bench_case_t bench;
+static char *message;
+static hist_t *hists;		/* one a thread, shared with child processes */
+static double ns_per_tick = 1.0;
+
+/*******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t ticks(void)
+{
+#ifdef BENCH_RDTSC
+	return __rdtsc();
+#else
+	return now_ns();
+#endif
+}
+
+static void calibrate(void)
+{
+#ifdef BENCH_RDTSC
+	uint64_t t0, n0;
+	struct timespec ts = { 0, 100 * 1000 * 1000 };
+
+	t0 = ticks();
+	n0 = now_ns();
+	nanosleep(&ts, NULL);
+	ns_per_tick = (double)(now_ns() - n0) / (double)(ticks() - t0);
+#endif
+	return;
+}
+
+/*******************************************************************************/
+static int record_output(zlog_msg_t *msg)
+{
+	return 0;
+}
+
+static void *work(void *arg)
+{
+	hist_t *h = arg;
+	long j;
+	uint64_t t0, ns;
+
+	if (strcmp(bench.format, "mdc") == 0) {
+		zlog_put_mdc("user", "bench_user");
+		zlog_put_mdc("session", "0123456789abcdef");
+		zlog_put_mdc("request", "GET /index.html");
+	}
+
+	for (j = 0; j < bench.loops; j++) {
+		t0 = ticks();
+		zlog_info(zc, "%s", message);
+		ns = (uint64_t)((ticks() - t0) * ns_per_tick);
+		hist_add(h, ns);
+	}
+	return NULL;
+}
+
+static void run_process(hist_t *h)
+{
+	long i;
+	pthread_t *tids;
+
+	tids = calloc(bench.threads, sizeof(pthread_t));
+	if (!tids) {
+		fprintf(stderr, "calloc fail\n");
+		return;
+	}
+	for (i = 0; i < bench.threads; i++) {
+		pthread_create(tids + i, NULL, work, h + i);
+	}
+	for (i = 0; i < bench.threads; i++) {
+		pthread_join(tids[i], NULL);
+	}
+	free(tids);
+	return;
+}
+
+static const char *lookup(const char *table[][2], size_t n, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (strcmp(table[i][0], name) == 0) return table[i][1];
+	}
+	return NULL;
+}
+
+static int write_conf(const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "fopen[%s] fail, errno[%d]\n", path, errno);
+		return -1;
+	}
+	fprintf(fp, "[global]\nbuffer min = 1KB\nbuffer max = 64KB\n");
+	fprintf(fp, "[formats]\nbench = \"%s\"\n",
+		lookup(formats, sizeof(formats) / sizeof(formats[0]), bench.format));
+	fprintf(fp, "[rules]\nbench.%s\t%s; bench\n",
+		strcmp(bench.output, "off") == 0 ? "FATAL" : "*",
+		lookup(outputs, sizeof(outputs) / sizeof(outputs[0]), bench.output));
+	fclose(fp);
+	return 0;
+}
+
+static int run_case(void)
+{
+	long i;
+	long n = bench.processes * bench.threads;
+	pid_t pid;
+	uint64_t t0, elapsed;
+	hist_t all;
+	double lines;
+
+	if (!lookup(formats, sizeof(formats) / sizeof(formats[0]), bench.format)
+		|| !lookup(outputs, sizeof(outputs) / sizeof(outputs[0]), bench.output)) {
+		fprintf(stderr, "unknown format[%s] or output[%s]\n", bench.format, bench.output);
+		return -1;
+	}
+	if (system("rm -f bench.log bench.*.log bench.log.*")) {}
+	if (write_conf("bench.conf")) return -1;
+
+	message = malloc(bench.size + 1);
+	hists = mmap(NULL, n * sizeof(hist_t), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (!message || hists == MAP_FAILED) {
+		fprintf(stderr, "alloc fail\n");
+		return -1;
+	}
+	memset(message, 'x', bench.size);
+	message[bench.size] = '\0';
+	memset(hists, 0x00, n * sizeof(hist_t));
+
+	if (zlog_init("bench.conf")) {
+		fprintf(stderr, "zlog_init fail\n");
+		return -1;
+	}
+	zlog_set_record("bench", record_output);
+	zc = zlog_get_category("bench");
+
+	t0 = now_ns();
+	if (bench.processes == 1) {
+		run_process(hists);
+	} else {
+		for (i = 0; i < bench.processes; i++) {
+			pid = fork();
+			if (pid < 0) {
+				fprintf(stderr, "fork fail\n");
+			} else if (pid == 0) {
+				run_process(hists + i * bench.threads);
+				zlog_fini();
+				_exit(0);
+			}
+		}
+		for (i = 0; i < bench.processes; i++) wait(NULL);
+	}
+	elapsed = now_ns() - t0;
+	zlog_fini();
+
+	memset(&all, 0x00, sizeof(all));
+	for (i = 0; i < n; i++) hist_merge(&all, hists + i);
+	lines = (double)bench.processes * bench.threads * bench.loops;
+
+	printf("{\"version\":\"%s\",\"processes\":%ld,\"threads\":%ld,\"loops\":%ld,"
+		"\"size\":%ld,\"format\":\"%s\",\"output\":\"%s\","
+		"\"seconds\":%.6f,\"lines_per_sec\":%.0f,"
+		"\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+		ZLOG_VERSION, bench.processes, bench.threads, bench.loops,
+		bench.size, bench.format, bench.output,
+		elapsed / 1e9, lines / (elapsed / 1e9),
+		(unsigned long long)hist_percentile(&all, 50),
+		(unsigned long long)hist_percentile(&all, 99),
+		(unsigned long long)hist_percentile(&all, 99.9),
+		(unsigned long long)all.max);
+	fflush(stdout);
+
+	munmap(hists, n * sizeof(hist_t));
+	free(message);
+	if (system("rm -f bench.conf bench.log bench.*.log bench.log.*")) {}
+	return 0;
+}
+
+/* every output and format, then threads, processes and sizes on file */
+static int run_matrix(long loops)
+{
+	int rc = 0;
+	size_t i, j;
+	static const long threads[] = { 1, 2, 4, 8 };
+	static const long processes[] = { 2, 4 };
+	static const long sizes[] = { 16, 256, 4096 };
+
+	bench.loops = loops;
+	bench.processes = 1;
+	bench.threads = 1;
+	bench.size = 64;
+	for (i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
+		for (j = 0; j < sizeof(formats) / sizeof(formats[0]); j++) {
+			bench.output = outputs[i][0];
+			bench.format = formats[j][0];
+			if (run_case()) rc = -1;
+		}
+	}
+
+	bench.output = "file";
+	bench.format = "time";
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+		bench.threads = threads[i];
+		if (run_case()) rc = -1;
+	}
+	bench.threads = 1;
+	for (i = 0; i < sizeof(processes) / sizeof(processes[0]); i++) {
+		bench.processes = processes[i];
+		if (run_case()) rc = -1;
+	}
+	bench.processes = 1;
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		bench.size = sizes[i];
+		if (run_case()) rc = -1;
+	}
+	return rc;
+}
+
+int main(int argc, char **argv)
+{
+	int op;
+	int matrix = 1;
+	static const char *help =
+		"useage: zlog-bench [-p processes] [-t threads] [-n loops] [-s size]\n"
+		"\t[-f msg|time|mdc] [-o file|rotate|dynamic|pipe|record|off]\n"
+		"\twithout -p, -t, -s, -f or -o, run all cases with -n loops\n"
+		"\tone json line for a case, to stdout\n";
+
+	bench.processes = 1;
+	bench.threads = 1;
+	bench.loops = 100000;
+	bench.size = 64;
+	bench.format = "time";
+	bench.output = "file";
+
+	while ((op = getopt(argc, argv, "p:t:n:s:f:o:h")) > 0) {
+		switch (op) {
+		case 'p': bench.processes = atol(optarg); matrix = 0; break;
+		case 't': bench.threads = atol(optarg); matrix = 0; break;
+		case 'n': bench.loops = atol(optarg); break;
+		case 's': bench.size = atol(optarg); matrix = 0; break;
+		case 'f': bench.format = optarg; matrix = 0; break;
+		case 'o': bench.output = optarg; matrix = 0; break;
+		default:
+			fputs(help, stdout);
+			return op == 'h' ? 0 : -1;
+		}
+	}
+	if (bench.processes < 1 || bench.threads < 1 || bench.loops < 1 || bench.size < 0) {
+		fputs(help, stdout);
+		return -1;
+	}
+
+	calibrate();
+	if (matrix) return run_matrix(bench.loops) ? 1 : 0;
+	return run_case() ? 1 : 0;
+}
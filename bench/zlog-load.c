@@ -0,0 +1,315 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+/* latency under load: threads call zlog at a fixed total rate, each call
+ * has a time it is meant to start at. latency is from that time to the
+ * return, so a call held up by a slow one before it is counted as late,
+ * not left out (coordinated omission). service time, from the real start,
+ * is kept too.
+ *
+ * the sink can be slow:
+ *	record:US	a record function taking US microseconds a line
+ *	fifo:BPS	a fifo read at BPS bytes a second
+ *	file		a plain file
+ * and the way to it sync or async:
+ *	record	sync: zlog_set_record()	async: zlog_set_record_batch()
+ *	fifo	sync: file rule on the fifo	async: | cat > fifo, pipe spool
+ *	file	sync: write()			async: io engine = uring
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+#include "version.h"
+#include "hist.h"
+
+#define FIFO_PATH "load.fifo"
+
+static long threads = 4;
+static long rate = 100000;		/* calls a second, all threads */
+static long seconds = 5;
+static long size = 64;
+static const char *sink = "file";
+static long sink_arg;
+static int async;
+
+static zlog_category_t *zc;
+static char *message;
+static uint64_t start_ns;
+static pid_t reader_pid;
+
+typedef struct {
+	long index;
+	hist_t latency;
+	hist_t service;
+	uint64_t late;		/* calls started after the next was due */
+} load_thread_t;
+
+/*******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* sleep most of the way, spin the last 50us */
+static void wait_until(uint64_t when)
+{
+	uint64_t now = now_ns();
+	struct timespec ts;
+
+	if (when > now + 50000) {
+		when -= 50000;
+		ts.tv_sec = when / 1000000000ULL;
+		ts.tv_nsec = when % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		when += 50000;
+	}
+	while (now_ns() < when) ;
+	return;
+}
+
+static int slow_record(zlog_msg_t *msg)
+{
+	if (sink_arg) usleep(sink_arg);
+	return 0;
+}
+
+static int slow_record_batch(zlog_msg_t *msgs, size_t count)
+{
+	if (sink_arg) usleep(sink_arg * count);
+	return 0;
+}
+
+/* reads the fifo at sink_arg bytes a second, in 10ms slices */
+static void fifo_reader(void)
+{
+	int fd;
+	char *buf;
+	size_t slice = sink_arg / 100 > 0 ? sink_arg / 100 : 1;
+	ssize_t n;
+
+	buf = malloc(slice);
+	fd = open(FIFO_PATH, O_RDONLY);
+	if (fd < 0 || !buf) _exit(1);
+	for (;;) {
+		n = read(fd, buf, slice);
+		if (n <= 0) break;
+		usleep(10000);
+	}
+	_exit(0);
+}
+
+/*******************************************************************************/
+static void *work(void *arg)
+{
+	load_thread_t *t = arg;
+	uint64_t interval = 1000000000ULL * threads / rate;
+	uint64_t end = start_ns + (uint64_t)seconds * 1000000000ULL;
+	uint64_t due;
+	uint64_t begin;
+	uint64_t done;
+
+	/* threads take turns, not all at once */
+	for (due = start_ns + interval * t->index / threads; due < end; due += interval) {
+		wait_until(due);
+		begin = now_ns();
+		zlog_info(zc, "%s", message);
+		done = now_ns();
+
+		hist_add(&(t->latency), done - due);
+		hist_add(&(t->service), done - begin);
+		if (begin > due + interval) t->late++;
+	}
+	return NULL;
+}
+
+static int write_conf(const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "fopen[%s] fail, errno[%d]\n", path, errno);
+		return -1;
+	}
+	fprintf(fp, "[global]\nbuffer min = 1KB\nbuffer max = 64KB\n");
+	if (async && strcmp(sink, "file") == 0) fprintf(fp, "io engine = uring\n");
+	fprintf(fp, "[formats]\nload = \"%%d(%%F %%T).%%us %%-6V [%%p:%%T:%%F:%%L] %%m%%n\"\n");
+	fprintf(fp, "[rules]\n");
+	if (strcmp(sink, "record") == 0) {
+		fprintf(fp, "load.*\t$slow, \"load.path\"; load\n");
+	} else if (strcmp(sink, "fifo") == 0 && async) {
+		fprintf(fp, "load.*\t| cat > %s; load\n", FIFO_PATH);
+	} else if (strcmp(sink, "fifo") == 0) {
+		fprintf(fp, "load.*\t\"%s\"; load\n", FIFO_PATH);
+	} else {
+		fprintf(fp, "load.*\t\"load.log\"; load\n");
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int parse_sink(const char *arg)
+{
+	const char *p = strchr(arg, ':');
+	static char name[16];
+
+	if (p) {
+		snprintf(name, sizeof(name), "%.*s", (int)(p - arg), arg);
+		sink_arg = atol(p + 1);
+	} else {
+		snprintf(name, sizeof(name), "%s", arg);
+	}
+	sink = name;
+	if (strcmp(sink, "record") && strcmp(sink, "fifo") && strcmp(sink, "file")) return -1;
+	if (strcmp(sink, "fifo") == 0 && sink_arg <= 0) sink_arg = 1024 * 1024;
+	return 0;
+}
+
+static void print_hist(const char *name, hist_t *h)
+{
+	printf("\"%s\":{\"count\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,"
+		"\"p999_ns\":%llu,\"p9999_ns\":%llu,\"max_ns\":%llu,",
+		name, (unsigned long long)h->count,
+		(unsigned long long)hist_percentile(h, 50),
+		(unsigned long long)hist_percentile(h, 90),
+		(unsigned long long)hist_percentile(h, 99),
+		(unsigned long long)hist_percentile(h, 99.9),
+		(unsigned long long)hist_percentile(h, 99.99),
+		(unsigned long long)h->max);
+	hist_print_json(stdout, h);
+	printf("}");
+	return;
+}
+
+int main(int argc, char **argv)
+{
+	int op;
+	long i;
+	uint64_t late = 0;
+	hist_t latency;
+	hist_t service;
+	load_thread_t *ts;
+	pthread_t *tids;
+	static const char *help =
+		"useage: zlog-load [-t threads] [-r calls a second] [-d seconds] [-s size]\n"
+		"\t[-k file|record:US|fifo:BPS] [-a]\n"
+		"\t-a, async way to the sink\n"
+		"\tone json line of latency and service time histograms, to stdout\n";
+
+	while ((op = getopt(argc, argv, "t:r:d:s:k:ah")) > 0) {
+		switch (op) {
+		case 't': threads = atol(optarg); break;
+		case 'r': rate = atol(optarg); break;
+		case 'd': seconds = atol(optarg); break;
+		case 's': size = atol(optarg); break;
+		case 'a': async = 1; break;
+		case 'k':
+			if (parse_sink(optarg)) {
+				fputs(help, stdout);
+				return -1;
+			}
+			break;
+		default:
+			fputs(help, stdout);
+			return op == 'h' ? 0 : -1;
+		}
+	}
+	if (threads < 1 || rate < threads || seconds < 1 || size < 0) {
+		fputs(help, stdout);
+		return -1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	unlink("load.log");
+	if (strcmp(sink, "fifo") == 0) {
+		unlink(FIFO_PATH);
+		if (mkfifo(FIFO_PATH, 0600)) {
+			fprintf(stderr, "mkfifo fail, errno[%d]\n", errno);
+			return -1;
+		}
+		reader_pid = fork();
+		if (reader_pid == 0) fifo_reader();
+	}
+	if (write_conf("load.conf")) return -1;
+
+	message = malloc(size + 1);
+	ts = calloc(threads, sizeof(load_thread_t));
+	tids = calloc(threads, sizeof(pthread_t));
+	if (!message || !ts || !tids) {
+		fprintf(stderr, "alloc fail\n");
+		return -1;
+	}
+	memset(message, 'x', size);
+	message[size] = '\0';
+
+	if (zlog_init("load.conf")) {
+		fprintf(stderr, "zlog_init fail\n");
+		return -1;
+	}
+	if (async) {
+		zlog_set_record_batch("slow", slow_record_batch);
+	} else {
+		zlog_set_record("slow", slow_record);
+	}
+	zc = zlog_get_category("load");
+
+	start_ns = now_ns() + 10000000;
+	for (i = 0; i < threads; i++) {
+		ts[i].index = i;
+		pthread_create(tids + i, NULL, work, ts + i);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tids[i], NULL);
+	}
+	zlog_fini();
+
+	memset(&latency, 0x00, sizeof(latency));
+	memset(&service, 0x00, sizeof(service));
+	for (i = 0; i < threads; i++) {
+		hist_merge(&latency, &(ts[i].latency));
+		hist_merge(&service, &(ts[i].service));
+		late += ts[i].late;
+	}
+
+	printf("{\"version\":\"%s\",\"threads\":%ld,\"rate\":%ld,\"seconds\":%ld,\"size\":%ld,"
+		"\"sink\":\"%s\",\"sink_arg\":%ld,\"async\":%d,\"late\":%llu,",
+		ZLOG_VERSION, threads, rate, seconds, size,
+		sink, sink_arg, async, (unsigned long long)late);
+	print_hist("latency", &latency);
+	printf(",");
+	print_hist("service", &service);
+	printf("}\n");
+
+	if (reader_pid > 0) {
+		kill(reader_pid, SIGTERM);
+		waitpid(reader_pid, NULL, 0);
+		unlink(FIFO_PATH);
+	}
+	unlink("load.conf");
+	unlink("load.log");
+	free(message);
+	free(ts);
+	free(tids);
+	return 0;
+}
@@ -143,6 +143,7 @@ static void zlog_buf_truncate(zlog_buf_t * a_buf)
 	char *p;
 	size_t len;
 
+	a_buf->truncates++;
 	if ((a_buf->truncate_str)[0] == '\0') return;
 	p = (a_buf->tail - a_buf->truncate_str_len);
 	if (p < a_buf->start) p = a_buf->start;
@@ -30,6 +30,7 @@ typedef struct zlog_buf_s {
 
 	char truncate_str[MAXLEN_PATH + 1];
 	size_t truncate_str_len;
+	size_t truncates;	/* lines cut at size max, only for stats */
 } zlog_buf_t;
 
 
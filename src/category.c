@@ -20,10 +20,11 @@ void zlog_category_profile(zlog_category_t *a_category, int flag)
 	zlog_rule_t *a_rule;
 
 	zc_assert(a_category,);
-	zc_profile(flag, "--category[%p][%s][%p]--",
+	zc_profile(flag, "--category[%p][%s][%p][level set %d]--",
 			a_category,
 			a_category->name,
-			a_category->fit_rules);
+			a_category->fit_rules,
+			a_category->level_set);
 	if (a_category->fit_rules) {
 		zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
 			zlog_rule_profile(a_rule, flag);
@@ -37,6 +38,7 @@ void zlog_category_del(zlog_category_t * a_category)
 {
 	zc_assert(a_category,);
 	if (a_category->fit_rules) zc_arraylist_del(a_category->fit_rules);
+	zlog_stats_slot_del(a_category->stats_slot);
 	free(a_category);
 	zc_debug("zlog_category_del[%p]", a_category);
 	return;
@@ -54,6 +56,16 @@ static void zlog_cateogry_overlap_bitmap(zlog_category_t * a_category, zlog_rule
 	}
 }
 
+/* lines of level or higher, as a rule of [.] */
+static void zlog_category_level_bitmap(zlog_category_t * a_category, int level)
+{
+	memset(a_category->level_bitmap, 0x00, sizeof(a_category->level_bitmap));
+	a_category->level_bitmap[level / 8] |= ~(0xFF << (8 - level % 8));
+	memset(a_category->level_bitmap + level / 8 + 1, 0xFF,
+			sizeof(a_category->level_bitmap) - level / 8 - 1);
+	return;
+}
+
 static int zlog_category_obtain_rules(zlog_category_t * a_category, zc_arraylist_t * rules)
 {
 	int i;
@@ -104,6 +116,8 @@ static int zlog_category_obtain_rules(zlog_category_t * a_category, zc_arraylist
 		}
 	}
 
+	/* a reload keeps the level set */
+	if (a_category->level_set >= 0) zlog_category_level_bitmap(a_category, a_category->level_set);
 	return 0;
 err:
 	zc_arraylist_del(a_category->fit_rules);
@@ -131,6 +145,12 @@ zlog_category_t *zlog_category_new(const char *name, zc_arraylist_t * rules)
 	}
 	strcpy(a_category->name, name);
 	a_category->name_len = len;
+	a_category->level_set = -1;
+	a_category->stats_slot = zlog_stats_slot_new();
+	if (a_category->stats_slot < 0) {
+		zc_error("zlog_stats_slot_new fail");
+		goto err;
+	}
 	if (zlog_category_obtain_rules(a_category, rules)) {
 		zc_error("zlog_category_fit_rules fail");
 		goto err;
@@ -143,6 +163,25 @@ err:
 	return NULL;
 }
 /*******************************************************************************/
+/* the order of rules kept is checked by the caller, for all categories */
+int zlog_category_keeps_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules)
+{
+	int i;
+	zlog_rule_t *a_rule;
+
+	zc_assert(a_category, 0);
+	zc_assert(new_rules, 0);
+
+	zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
+		if (!zlog_rule_is_shared(a_rule)) return 0;
+	}
+	zc_arraylist_foreach(new_rules, i, a_rule) {
+		if (zlog_rule_is_shared(a_rule)) continue;
+		if (zlog_rule_match_category(a_rule, a_category->name)) return 0;
+	}
+	return 1;
+}
+
 /* update success: fit_rules 1, fit_rules_backup 1 */
 /* update fail: fit_rules 0, fit_rules_backup 1 */
 int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules)
@@ -174,10 +213,8 @@ int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * ne
 void zlog_category_commit_rules(zlog_category_t * a_category)
 {
 	zc_assert(a_category,);
-	if (!a_category->fit_rules_backup) {
-		zc_warn("a_category->fit_rules_backup is NULL, never update before");
-		return;
-	}
+	/* not updated, as its rules are kept */
+	if (!a_category->fit_rules_backup) return;
 
 	zc_arraylist_del(a_category->fit_rules_backup);
 	a_category->fit_rules_backup = NULL;
@@ -192,10 +229,8 @@ void zlog_category_commit_rules(zlog_category_t * a_category)
 void zlog_category_rollback_rules(zlog_category_t * a_category)
 {
 	zc_assert(a_category,);
-	if (!a_category->fit_rules_backup) {
-		zc_warn("a_category->fit_rules_backup in NULL, never update before");
-		return;
-	}
+	/* not updated, as its rules are kept */
+	if (!a_category->fit_rules_backup) return;
 
 	if (a_category->fit_rules) {
 		/* update success, rm new and backup */
@@ -223,11 +258,59 @@ int zlog_category_output(zlog_category_t * a_category, zlog_thread_t * a_thread)
 	int i;
 	int rc = 0;
 	zlog_rule_t *a_rule;
+	zlog_stats_block_t *a_stats = a_thread->stats;
+	zlog_stats_counter_t *a_counter;
+	unsigned long long lines = 0;
+	unsigned long long bytes = 0;
+	unsigned long long errors = 0;
+
+	if (a_stats) {
+		lines = a_stats->lines;
+		bytes = a_stats->bytes;
+		errors = a_stats->errors;
+	}
 
 	/* go through all match rules to output */
-	zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
-		rc = zlog_rule_output(a_rule, a_thread);
+	if (a_category->level_set < 0 && a_thread->level_set < 0) {
+		zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
+			rc = zlog_rule_output(a_rule, a_thread);
+		}
+	} else {
+		/* the level is checked by the bitmap or the thread already */
+		zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
+			rc = zlog_rule_output_matched(a_rule, a_thread);
+		}
 	}
 
+	/* a line of the category is counted once, however many rules write it */
+	if (a_stats && a_stats->lines != lines) {
+		a_counter = zlog_stats_slot(a_stats, a_category->stats_slot);
+		if (a_counter) {
+			zlog_stats_add(a_counter->lines, 1);
+			zlog_stats_add(a_counter->bytes, a_stats->bytes - bytes);
+			zlog_stats_add(a_counter->errors, a_stats->errors - errors);
+		}
+	}
 	return rc;
 }
+
+/*******************************************************************************/
+void zlog_category_set_level(zlog_category_t * a_category, int level)
+{
+	int i;
+	zlog_rule_t *a_rule;
+
+	zc_assert(a_category,);
+
+	a_category->level_set = level;
+	if (level >= 0) {
+		zlog_category_level_bitmap(a_category, level);
+		return;
+	}
+
+	memset(a_category->level_bitmap, 0x00, sizeof(a_category->level_bitmap));
+	zc_arraylist_foreach(a_category->fit_rules, i, a_rule) {
+		zlog_cateogry_overlap_bitmap(a_category, a_rule);
+	}
+	return;
+}
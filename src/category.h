@@ -11,6 +11,7 @@
 
 #include "zc_defs.h"
 #include "thread.h"
+#include "stats.h"
 
 typedef struct zlog_category_s {
 	char name[MAXLEN_PATH + 1];
@@ -19,18 +20,27 @@ typedef struct zlog_category_s {
 	unsigned char level_bitmap_backup[32];
 	zc_arraylist_t *fit_rules;
 	zc_arraylist_t *fit_rules_backup;
+	int stats_slot;	/* of counters in stats blocks */
+	/* by zlog_set_category_level(), -1 none. lines of it or higher go to
+	 * every fit rule, whatever levels the rules have, till reset */
+	int level_set;
 } zlog_category_t;
 
 zlog_category_t *zlog_category_new(const char *name, zc_arraylist_t * rules);
 void zlog_category_del(zlog_category_t * a_category);
 void zlog_category_profile(zlog_category_t *a_category, int flag);
 
+/* 1 if its fit rules are all kept in new_rules, and none new fits it */
+int zlog_category_keeps_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules);
 int zlog_category_update_rules(zlog_category_t * a_category, zc_arraylist_t * new_rules);
 void zlog_category_commit_rules(zlog_category_t * a_category);
 void zlog_category_rollback_rules(zlog_category_t * a_category);
 
 int zlog_category_output(zlog_category_t * a_category, zlog_thread_t * a_thread);
 
+/* level -1 gives the levels back to the rules */
+void zlog_category_set_level(zlog_category_t * a_category, int level);
+
 #define zlog_category_needless_level(a_category, lv) \
         !((a_category->level_bitmap[lv/8] >> (7 - lv % 8)) & 0x01)
 
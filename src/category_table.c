@@ -12,6 +12,7 @@
 
 #include "zc_defs.h"
 #include "category_table.h"
+#include "rule.h"
 
 void zlog_category_table_profile(zc_hashtable_t * categories, int flag)
 {
@@ -54,19 +55,57 @@ zc_hashtable_t *zlog_category_table_new(void)
 	}
 }
 /*******************************************************************************/
-int zlog_category_table_update_rules(zc_hashtable_t * categories, zc_arraylist_t * new_rules)
+/* rules kept by the new conf are in the same order, and the wastebin is the same */
+static int zlog_category_table_same_order(zc_arraylist_t * last_rules, zc_arraylist_t * new_rules)
 {
+	int i;
+	int j = 0;
+	zlog_rule_t *a_rule;
+	zlog_rule_t *b_rule = NULL;
+	zlog_rule_t *last_wastebin = NULL;
+	zlog_rule_t *new_wastebin = NULL;
+
+	zc_arraylist_foreach(last_rules, i, a_rule) {
+		if (zlog_rule_is_wastebin(a_rule)) last_wastebin = a_rule;
+	}
+	zc_arraylist_foreach(new_rules, i, a_rule) {
+		if (zlog_rule_is_wastebin(a_rule)) new_wastebin = a_rule;
+		if (!zlog_rule_is_shared(a_rule)) continue;
+
+		/* the next kept one in last_rules */
+		for (b_rule = NULL; j < zc_arraylist_len(last_rules); j++) {
+			b_rule = zc_arraylist_get(last_rules, j);
+			if (zlog_rule_is_shared(b_rule)) break;
+		}
+		if (b_rule != a_rule) return 0;
+		j++;
+	}
+	return last_wastebin == new_wastebin;
+}
+
+int zlog_category_table_update_rules(zc_hashtable_t * categories,
+		zc_arraylist_t * last_rules, zc_arraylist_t * new_rules)
+{
+	int same_order = 0;
+	size_t kept = 0;
 	zc_hashtable_entry_t *a_entry;
 	zlog_category_t *a_category;
 
 	zc_assert(categories, -1);
+	if (last_rules) same_order = zlog_category_table_same_order(last_rules, new_rules);
+
 	zc_hashtable_foreach(categories, a_entry) {
 		a_category = (zlog_category_t *) a_entry->value;
+		if (same_order && zlog_category_keeps_rules(a_category, new_rules)) {
+			kept++;
+			continue;
+		}
 		if (zlog_category_update_rules(a_category, new_rules)) {
 			zc_error("zlog_category_update_rules fail, try rollback");
 			return -1;
 		}
 	}
+	zc_debug("categories kept rules[%ld]", (long)kept);
 	return 0;
 }
 
@@ -96,10 +135,76 @@ void zlog_category_table_rollback_rules(zc_hashtable_t * categories)
 	return;
 }
 
+/*******************************************************************************/
+static int zlog_category_table_level_of(zc_arraylist_t * levels, const char *name)
+{
+	int i;
+	int level = -1;
+	zlog_category_level_t *a_level;
+
+	zc_arraylist_foreach(levels, i, a_level) {
+		if (zlog_rule_match_category_name(a_level->name, name) == 1) level = a_level->level;
+	}
+	return level;
+}
+
+int zlog_category_table_set_level(zc_hashtable_t * categories, zc_arraylist_t * levels,
+		const char *name, int level)
+{
+	int i;
+	int count = 0;
+	zc_hashtable_entry_t *a_entry;
+	zlog_category_t *a_category;
+	zlog_category_level_t *a_level;
+
+	zc_assert(categories, -1);
+	zc_assert(levels, -1);
+	zc_assert(name, -1);
+
+	if (strlen(name) > sizeof(a_level->name) - 1) {
+		zc_error("name[%s] too long", name);
+		return -1;
+	}
+
+	/* the same name set again replaces, * replaces all */
+	for (i = zc_arraylist_len(levels) - 1; i >= 0; i--) {
+		a_level = zc_arraylist_get(levels, i);
+		if (STRCMP(name, ==, "*") || STRCMP(a_level->name, ==, name)) {
+			zc_arraylist_remove_idx(levels, i);
+		}
+	}
+
+	/* a reset is kept only to go over a level set before */
+	if (level >= 0 || zc_arraylist_len(levels)) {
+		a_level = calloc(1, sizeof(zlog_category_level_t));
+		if (!a_level) {
+			zc_error("calloc fail, errno[%d]", errno);
+			return -1;
+		}
+		strcpy(a_level->name, name);
+		a_level->level = level;
+		if (zc_arraylist_add(levels, a_level)) {
+			zc_error("zc_arraylist_add fail");
+			free(a_level);
+			return -1;
+		}
+	}
+
+	zc_hashtable_foreach(categories, a_entry) {
+		a_category = (zlog_category_t *) a_entry->value;
+		if (zlog_rule_match_category_name(name, a_category->name) != 1) continue;
+		zlog_category_set_level(a_category, level);
+		count++;
+	}
+	return count;
+}
+
 /*******************************************************************************/
 zlog_category_t *zlog_category_table_fetch_category(zc_hashtable_t * categories,
-			const char *category_name, zc_arraylist_t * rules)
+			const char *category_name, zc_arraylist_t * rules,
+			zc_arraylist_t * levels)
 {
+	int level;
 	zlog_category_t *a_category;
 
 	zc_assert(categories, NULL);
@@ -115,6 +220,10 @@ zlog_category_t *zlog_category_table_fetch_category(zc_hashtable_t * categories,
 		return NULL;
 	}
 
+	/* set before it is got, by name or prefix */
+	level = zlog_category_table_level_of(levels, category_name);
+	if (level >= 0) zlog_category_set_level(a_category, level);
+
 	if(zc_hashtable_put(categories, a_category->name, a_category)) {
 		zc_error("zc_hashtable_put fail");
 		goto err;
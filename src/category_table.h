@@ -16,13 +16,26 @@ zc_hashtable_t *zlog_category_table_new(void);
 void zlog_category_table_del(zc_hashtable_t * categories);
 void zlog_category_table_profile(zc_hashtable_t * categories, int flag);
 
-/* if none, create new and return */
+/* a level set by name, for categories got later too, the last one matched wins */
+typedef struct zlog_category_level_s {
+	char name[MAXLEN_CFG_LINE + 1];
+	int level;	/* -1 reset */
+} zlog_category_level_t;
+
+/* if none, create new with the level set of levels, and return */
 zlog_category_t *zlog_category_table_fetch_category(
 			zc_hashtable_t * categories,
-		 	const char *category_name, zc_arraylist_t * rules);
+		 	const char *category_name, zc_arraylist_t * rules,
+			zc_arraylist_t * levels);
 
-int zlog_category_table_update_rules(zc_hashtable_t * categories, zc_arraylist_t * new_rules);
+/* last_rules are of the conf in use, only categories of rules changed are updated */
+int zlog_category_table_update_rules(zc_hashtable_t * categories,
+		zc_arraylist_t * last_rules, zc_arraylist_t * new_rules);
 void zlog_category_table_commit_rules(zc_hashtable_t * categories);
+/* name as the category of a rule: *, aa_ for aa and aa_xx, or exact.
+ * kept in levels, level -1 resets, return the count of categories set, -1 fail */
+int zlog_category_table_set_level(zc_hashtable_t * categories, zc_arraylist_t * levels,
+		const char *name, int level);
 void zlog_category_table_rollback_rules(zc_hashtable_t * categories);
 
 #endif
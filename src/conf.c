@@ -20,8 +20,11 @@
 #include "conf.h"
 #include "rule.h"
 #include "format.h"
+#include "spec.h"
 #include "level_list.h"
 #include "rotater.h"
+#include "syncer.h"
+#include "uring.h"
 #include "zc_defs.h"
 
 /*******************************************************************************/
@@ -30,8 +33,14 @@
 #define ZLOG_CONF_DEFAULT_BUF_SIZE_MIN 1024
 #define ZLOG_CONF_DEFAULT_BUF_SIZE_MAX (2 * 1024 * 1024)
 #define ZLOG_CONF_DEFAULT_FILE_PERMS 0600
-#define ZLOG_CONF_DEFAULT_RELOAD_CONF_PERIOD 0
+#define ZLOG_CONF_DEFAULT_RELOAD_CONF_INTERVAL 0
 #define ZLOG_CONF_DEFAULT_FSYNC_PERIOD 0
+#define ZLOG_CONF_DEFAULT_FSYNC_INTERVAL 0
+#define ZLOG_CONF_DEFAULT_IO_ENGINE ZLOG_IO_ENGINE_SYNC
+#define ZLOG_CONF_URING_SPOOL_SIZE (4 * 1024 * 1024)
+#define ZLOG_CONF_DEFAULT_PIPE_BUFFER (1024 * 1024)
+#define ZLOG_CONF_DEFAULT_PIPE_FULL_WAIT 0
+#define ZLOG_CONF_DEFAULT_THREAD_POOL 16
 #define ZLOG_CONF_BACKUP_ROTATE_LOCK_FILE "/tmp/zlog.lock"
 /*******************************************************************************/
 
@@ -53,8 +62,18 @@ void zlog_conf_profile(zlog_conf_t * a_conf, int flag)
 		zlog_format_profile(a_conf->default_format, flag);
 	}
 	zc_profile(flag, "---file perms[0%o]---", a_conf->file_perms);
-	zc_profile(flag, "---reload conf period[%ld]---", a_conf->reload_conf_period);
+	zc_profile(flag, "---reload conf interval[%ld]---", a_conf->reload_conf_interval);
 	zc_profile(flag, "---fsync period[%ld]---", a_conf->fsync_period);
+	zc_profile(flag, "---fsync interval[%ld]---", a_conf->fsync_interval);
+	if (a_conf->syncer) zlog_syncer_profile(a_conf->syncer, flag);
+	zc_profile(flag, "---io engine[%d]---", a_conf->io_engine);
+	if (a_conf->uring) zlog_uring_profile(a_conf->uring, flag);
+	zc_profile(flag, "---pipe buffer[%ld] full wait[%ld]---",
+		(long)a_conf->pipe_buffer, a_conf->pipe_full_wait);
+	zc_profile(flag, "---stats[%d] period[%ld] file[%s]---",
+		a_conf->stats, a_conf->stats_period, a_conf->stats_file);
+	zc_profile(flag, "---thread needs[0x%x] pool[%ld]---",
+		a_conf->thread_needs, (long)a_conf->thread_pool);
 
 	zc_profile(flag, "---rotate lock file[%s]---", a_conf->rotate_lock_file);
 	if (a_conf->rotater) zlog_rotater_profile(a_conf->rotater, flag);
@@ -81,6 +100,10 @@ void zlog_conf_profile(zlog_conf_t * a_conf, int flag)
 void zlog_conf_del(zlog_conf_t * a_conf)
 {
 	zc_assert(a_conf,);
+	/* io engine flushes and syncer does the last round on rules,
+	 * delete them before rules, in this order */
+	if (a_conf->uring) zlog_uring_del(a_conf->uring);
+	if (a_conf->syncer) zlog_syncer_del(a_conf->syncer);
 	if (a_conf->rotater) zlog_rotater_del(a_conf->rotater);
 	if (a_conf->levels) zlog_level_list_del(a_conf->levels);
 	if (a_conf->default_format) zlog_format_del(a_conf->default_format);
@@ -94,7 +117,7 @@ void zlog_conf_del(zlog_conf_t * a_conf)
 static int zlog_conf_build_without_file(zlog_conf_t * a_conf);
 static int zlog_conf_build_with_file(zlog_conf_t * a_conf);
 
-zlog_conf_t *zlog_conf_new(const char *confpath)
+zlog_conf_t *zlog_conf_new(const char *confpath, zlog_conf_t * last)
 {
 	int nwrite = 0;
 	int has_conf_file = 0;
@@ -133,9 +156,15 @@ zlog_conf_t *zlog_conf_new(const char *confpath)
 	}
 	strcpy(a_conf->default_format_line, ZLOG_CONF_DEFAULT_FORMAT);
 	a_conf->file_perms = ZLOG_CONF_DEFAULT_FILE_PERMS;
-	a_conf->reload_conf_period = ZLOG_CONF_DEFAULT_RELOAD_CONF_PERIOD;
+	a_conf->reload_conf_interval = ZLOG_CONF_DEFAULT_RELOAD_CONF_INTERVAL;
 	a_conf->fsync_period = ZLOG_CONF_DEFAULT_FSYNC_PERIOD;
+	a_conf->fsync_interval = ZLOG_CONF_DEFAULT_FSYNC_INTERVAL;
+	a_conf->io_engine = ZLOG_CONF_DEFAULT_IO_ENGINE;
+	a_conf->pipe_buffer = ZLOG_CONF_DEFAULT_PIPE_BUFFER;
+	a_conf->pipe_full_wait = ZLOG_CONF_DEFAULT_PIPE_FULL_WAIT;
+	a_conf->thread_pool = ZLOG_CONF_DEFAULT_THREAD_POOL;
 	/* set default configuration end */
+	a_conf->last = last;
 
 	a_conf->levels = zlog_level_list_new();
 	if (!a_conf->levels) {
@@ -167,12 +196,91 @@ zlog_conf_t *zlog_conf_new(const char *confpath)
 		}
 	}
 
+	a_conf->last = NULL;
 	zlog_conf_profile(a_conf, ZC_DEBUG);
 	return a_conf;
 err:
 	zlog_conf_del(a_conf);
 	return NULL;
 }
+/*******************************************************************************/
+/* the same one of the last conf instead of a_format, so rules on it may be kept */
+static zlog_format_t *zlog_conf_keep_format(zlog_conf_t * a_conf, zlog_format_t * a_format)
+{
+	int i;
+	zlog_format_t *last_format = NULL;
+	zlog_format_t *b_format;
+
+	if (!a_conf->last) return a_format;
+
+	if (a_conf->last->default_format
+		&& zlog_format_is_same(a_conf->last->default_format, a_format)) {
+		last_format = a_conf->last->default_format;
+	} else {
+		zc_arraylist_foreach(a_conf->last->formats, i, b_format) {
+			if (zlog_format_is_same(b_format, a_format)) {
+				last_format = b_format;
+				break;
+			}
+		}
+	}
+	if (!last_format) return a_format;
+
+	zlog_format_del(a_format);
+	last_format->refs++;
+	return last_format;
+}
+
+/* what zlog_rule_new() takes from [global] and [levels] is the same */
+static int zlog_conf_can_keep_rules(zlog_conf_t * a_conf)
+{
+	zlog_conf_t *last = a_conf->last;
+
+	if (!last) return 0;
+	return a_conf->file_perms == last->file_perms
+		&& a_conf->fsync_period == last->fsync_period
+		&& a_conf->fsync_interval == last->fsync_interval
+		&& a_conf->io_engine == last->io_engine
+		&& a_conf->pipe_buffer == last->pipe_buffer
+		&& a_conf->pipe_full_wait == last->pipe_full_wait
+		&& zlog_level_list_is_same(a_conf->levels, last->levels);
+}
+
+/* the rule of the last conf on the same line, NULL if none fits */
+static zlog_rule_t *zlog_conf_keep_rule(zlog_conf_t * a_conf, char *line)
+{
+	int i;
+	int j;
+	zlog_rule_t *a_rule;
+	zlog_format_t *a_format;
+	zlog_format_t *b_format;
+
+	if (!a_conf->keep_rules) return NULL;
+
+	zc_arraylist_foreach(a_conf->last->rules, i, a_rule) {
+		/* kept for a line before */
+		if (zlog_rule_is_shared(a_rule)) continue;
+		if (STRCMP(a_rule->line, !=, line)) continue;
+
+		/* the format the line names in this conf */
+		a_format = NULL;
+		if (a_rule->format == a_conf->last->default_format) {
+			a_format = a_conf->default_format;
+		} else {
+			zc_arraylist_foreach(a_conf->formats, j, b_format) {
+				if (zlog_format_has_name(b_format, a_rule->format->name)) {
+					a_format = b_format;
+					break;
+				}
+			}
+		}
+
+		a_rule = zlog_rule_share(a_rule, a_format, &(a_conf->time_cache_count));
+		if (a_rule) return a_rule;
+	}
+	return NULL;
+}
+
 /*******************************************************************************/
 static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 {
@@ -183,6 +291,7 @@ static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 		zc_error("zlog_format_new fail");
 		return -1;
 	}
+	a_conf->default_format = zlog_conf_keep_format(a_conf, a_conf->default_format);
 
 	a_conf->rotater = zlog_rotater_new(a_conf->rotate_lock_file);
 	if (!a_conf->rotater) {
@@ -190,13 +299,24 @@ static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 		return -1;
 	}
 
-	default_rule = zlog_rule_new(
+	a_conf->syncer = zlog_syncer_new(a_conf->rules, a_conf->fsync_interval);
+	if (!a_conf->syncer) {
+		zc_error("zlog_syncer_new fail");
+		return -1;
+	}
+
+	a_conf->keep_rules = zlog_conf_can_keep_rules(a_conf);
+	default_rule = zlog_conf_keep_rule(a_conf, ZLOG_CONF_DEFAULT_RULE);
+	if (!default_rule) default_rule = zlog_rule_new(
 			ZLOG_CONF_DEFAULT_RULE,
 			a_conf->levels,
 			a_conf->default_format,
 			a_conf->formats,
 			a_conf->file_perms,
 			a_conf->fsync_period,
+			a_conf->fsync_interval,
+			a_conf->pipe_buffer,
+			a_conf->pipe_full_wait,
 			&(a_conf->time_cache_count));
 	if (!default_rule) {
 		zc_error("zlog_rule_new fail");
@@ -209,6 +329,7 @@ static int zlog_conf_build_without_file(zlog_conf_t * a_conf)
 		zc_error("zc_arraylist_add fail");
 		return -1;
 	}
+	a_conf->thread_needs |= zlog_rule_thread_needs(default_rule);
 
 	return 0;
 }
@@ -241,6 +362,12 @@ static int zlog_conf_build_with_file(zlog_conf_t * a_conf)
 	localtime_r(&(a_stat.st_mtime), &local_time);
 	strftime(a_conf->mtime, sizeof(a_conf->mtime), "%F %T", &local_time);
 
+	/* what a symlink points to, may be swapped */
+	if (stat(a_conf->file, &a_stat) == 0) {
+		zlog_stat_mtime(&a_stat, a_conf->mtime_ts);
+		a_conf->ino = a_stat.st_ino;
+	}
+
 	if ((fp = fopen(a_conf->file, "r")) == NULL) {
 		zc_error("open configure file[%s] fail", a_conf->file);
 		return -1;
@@ -370,18 +497,12 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		}
 
 		if (*section == 4) {
-			if (a_conf->reload_conf_period != 0
-				&& a_conf->fsync_period >= a_conf->reload_conf_period) {
-				/* as all rule will be rebuilt when conf is reload,
-				 * so fsync_period > reload_conf_period will never
-				 * cause rule to fsync it's file.
-				 * fsync_period will be meaningless and down speed,
-				 * so make it zero.
-				 */
-				zc_warn("fsync_period[%ld] >= reload_conf_period[%ld],"
-					"set fsync_period to zero");
-				a_conf->fsync_period = 0;
+			if (a_conf->stats_period && a_conf->stats_file[0] == '\0') {
+				zc_warn("stats period without stats file, no dump");
+				a_conf->stats_period = 0;
 			}
+			/* dump of stats needs stats */
+			if (a_conf->stats_period) a_conf->stats = 1;
 
 			/* now build rotater and default_format
 			 * from the unchanging global setting,
@@ -392,12 +513,37 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 				return -1;
 			}
 
+			a_conf->syncer = zlog_syncer_new(a_conf->rules, a_conf->fsync_interval);
+			if (!a_conf->syncer) {
+				zc_error("zlog_syncer_new fail");
+				return -1;
+			}
+
+			if (a_conf->io_engine == ZLOG_IO_ENGINE_URING) {
+				size_t spool_size = ZLOG_CONF_URING_SPOOL_SIZE;
+
+				/* a message of buffer max always fits */
+				if (spool_size < a_conf->buf_size_max * 2) spool_size = a_conf->buf_size_max * 2;
+				a_conf->uring = zlog_uring_new(spool_size);
+				if (!a_conf->uring) {
+					zc_warn("zlog_uring_new fail, io engine falls back to sync");
+					a_conf->io_engine = ZLOG_IO_ENGINE_SYNC;
+				}
+			}
+
+			/* a message of buffer max always fits */
+			if (a_conf->pipe_buffer < a_conf->buf_size_max * 2) {
+				a_conf->pipe_buffer = a_conf->buf_size_max * 2;
+			}
+
 			a_conf->default_format = zlog_format_new(a_conf->default_format_line,
 							&(a_conf->time_cache_count));
 			if (!a_conf->default_format) {
 				zc_error("zlog_format_new fail");
 				return -1;
 			}
+			a_conf->default_format = zlog_conf_keep_format(a_conf, a_conf->default_format);
+			a_conf->keep_rules = zlog_conf_can_keep_rules(a_conf);
 		}
 		return 0;
 	}
@@ -445,11 +591,49 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		} else if (STRCMP(word_1, ==, "default") && STRCMP(word_2, ==, "format")) {
 			/* so the input now is [format = "xxyy"], fit format's style */
 			strcpy(a_conf->default_format_line, line + nread);
+		} else if (STRCMP(word_1, ==, "reload") &&
+				STRCMP(word_2, ==, "conf") && STRCMP(word_3, ==, "interval")) {
+			a_conf->reload_conf_interval = zc_parse_time_span(value) * 1000;
 		} else if (STRCMP(word_1, ==, "reload") &&
 				STRCMP(word_2, ==, "conf") && STRCMP(word_3, ==, "period")) {
-			a_conf->reload_conf_period = zc_parse_byte_size(value);
+			/* it counted log calls, a write on each of them */
+			if (zc_parse_byte_size(value) && !a_conf->reload_conf_interval) {
+				zc_warn("reload conf period is obsolete, "
+					"watch the file every 1s, see reload conf interval");
+				a_conf->reload_conf_interval = 1000;
+			}
 		} else if (STRCMP(word_1, ==, "fsync") && STRCMP(word_2, ==, "period")) {
 			a_conf->fsync_period = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "fsync") && STRCMP(word_2, ==, "interval")) {
+			a_conf->fsync_interval = zc_parse_time_span(value) * 1000;
+		} else if (STRCMP(word_1, ==, "io") && STRCMP(word_2, ==, "engine")) {
+			if (STRICMP(value, ==, "uring")) {
+				a_conf->io_engine = ZLOG_IO_ENGINE_URING;
+			} else if (STRICMP(value, ==, "sync")) {
+				a_conf->io_engine = ZLOG_IO_ENGINE_SYNC;
+			} else {
+				zc_error("io engine[%s] is not uring or sync", value);
+				if (a_conf->strict_init) return -1;
+			}
+		} else if (STRCMP(word_1, ==, "pipe") && STRCMP(word_2, ==, "buffer")) {
+			a_conf->pipe_buffer = zc_parse_byte_size(value);
+		} else if (STRCMP(word_1, ==, "pipe") &&
+				STRCMP(word_2, ==, "full") && STRCMP(word_3, ==, "wait")) {
+			/* ms, 0 drop at once, -1 wait until room */
+			a_conf->pipe_full_wait = atol(value);
+		} else if (STRCMP(word_1, ==, "stats") && word_2[0] == '\0') {
+			a_conf->stats = STRICMP(value, ==, "true");
+		} else if (STRCMP(word_1, ==, "stats") && STRCMP(word_2, ==, "period")) {
+			a_conf->stats_period = zc_parse_time_span(value) * 1000;
+		} else if (STRCMP(word_1, ==, "stats") && STRCMP(word_2, ==, "file")) {
+			if (strlen(value) > sizeof(a_conf->stats_file) - 1) {
+				zc_error("stats file[%s] too long", value);
+				return -1;
+			}
+			strcpy(a_conf->stats_file, value);
+		} else if (STRCMP(word_1, ==, "thread") && STRCMP(word_2, ==, "pool")) {
+			/* states of threads gone kept for new threads, 0 means none */
+			a_conf->thread_pool = atol(value);
 		} else {
 			zc_error("name[%s] is not any one of global options", name);
 			if (a_conf->strict_init) return -1;
@@ -468,6 +652,7 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 			if (a_conf->strict_init) return -1;
 			else break;
 		}
+		a_format = zlog_conf_keep_format(a_conf, a_format);
 		if (zc_arraylist_add(a_conf->formats, a_format)) {
 			zlog_format_del(a_format);
 			zc_error("zc_arraylist_add fail");
@@ -475,12 +660,16 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 		}
 		break;
 	case 4:
-		a_rule = zlog_rule_new(line,
+		a_rule = zlog_conf_keep_rule(a_conf, line);
+		if (!a_rule) a_rule = zlog_rule_new(line,
 			a_conf->levels,
 			a_conf->default_format,
 			a_conf->formats,
 			a_conf->file_perms,
 			a_conf->fsync_period,
+			a_conf->fsync_interval,
+			a_conf->pipe_buffer,
+			a_conf->pipe_full_wait,
 			&(a_conf->time_cache_count));
 
 		if (!a_rule) {
@@ -493,6 +682,7 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 			zc_error("zc_arraylist_add fail");
 			return -1;
 		}
+		a_conf->thread_needs |= zlog_rule_thread_needs(a_rule);
 		break;
 	default:
 		zc_error("not in any section");
@@ -503,3 +693,74 @@ static int zlog_conf_parse_line(zlog_conf_t * a_conf, char *line, int *section)
 	return 0;
 }
 /*******************************************************************************/
+static void zlog_conf_time_fmts_of(zc_arraylist_t * specs, const char **fmts)
+{
+	int i;
+	int index;
+	zlog_spec_t *a_spec;
+
+	if (!specs) return;
+	zc_arraylist_foreach(specs, i, a_spec) {
+		index = zlog_spec_time_cache_index(a_spec);
+		if (index >= 0) fmts[index] = a_spec->time_fmt;
+	}
+	return;
+}
+
+/* fmts[n] is the time format of time cache n */
+static void zlog_conf_time_fmts(zlog_conf_t * a_conf, const char **fmts)
+{
+	int i;
+	zlog_format_t *a_format;
+	zlog_rule_t *a_rule;
+
+	if (a_conf->default_format) zlog_conf_time_fmts_of(a_conf->default_format->pattern_specs, fmts);
+	zc_arraylist_foreach(a_conf->formats, i, a_format) {
+		zlog_conf_time_fmts_of(a_format->pattern_specs, fmts);
+	}
+	zc_arraylist_foreach(a_conf->rules, i, a_rule) {
+		zlog_conf_time_fmts_of(a_rule->dynamic_specs, fmts);
+		zlog_conf_time_fmts_of(a_rule->archive_specs, fmts);
+	}
+	return;
+}
+
+int zlog_conf_thread_changed(zlog_conf_t * a_conf, zlog_conf_t * last)
+{
+	int i;
+	int rc = 0;
+	const char **fmts;
+	const char **last_fmts;
+
+	zc_assert(a_conf, 1);
+	zc_assert(last, 1);
+
+	if (a_conf->buf_size_min != last->buf_size_min
+		|| a_conf->buf_size_max != last->buf_size_max
+		|| a_conf->thread_needs != last->thread_needs
+		|| a_conf->stats != last->stats
+		|| a_conf->time_cache_count != last->time_cache_count) {
+		return 1;
+	}
+	if (!a_conf->time_cache_count) return 0;
+
+	/* a time cache of a thread holds a string of the format it had */
+	fmts = calloc(a_conf->time_cache_count * 2, sizeof(char *));
+	if (!fmts) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return 1;
+	}
+	last_fmts = fmts + a_conf->time_cache_count;
+	zlog_conf_time_fmts(a_conf, fmts);
+	zlog_conf_time_fmts(last, last_fmts);
+
+	for (i = 0; i < a_conf->time_cache_count; i++) {
+		if (fmts[i] == last_fmts[i]) continue;
+		if (!fmts[i] || !last_fmts[i] || STRCMP(fmts[i], !=, last_fmts[i])) {
+			rc = 1;
+			break;
+		}
+	}
+	free(fmts);
+	return rc;
+}
@@ -9,13 +9,31 @@
 #ifndef __zlog_conf_h
 #define __zlog_conf_h
 
+#include <sys/types.h>
+#include <time.h>
+
 #include "zc_defs.h"
 #include "format.h"
 #include "rotater.h"
+#include "syncer.h"
+#include "uring.h"
+
+/* nanoseconds of linux, others see changes by the second */
+#ifdef __linux__
+#define zlog_stat_mtime(a_stat, ts) ((ts) = (a_stat)->st_mtim)
+#else
+#define zlog_stat_mtime(a_stat, ts) do { \
+	(ts).tv_sec = (a_stat)->st_mtime; \
+	(ts).tv_nsec = 0; \
+} while (0)
+#endif
 
 typedef struct zlog_conf_s {
 	char file[MAXLEN_PATH + 1];
 	char mtime[20 + 1];
+	/* of the file read, a change of them means to reload */
+	struct timespec mtime_ts;
+	ino_t ino;
 
 	int strict_init;
 	size_t buf_size_min;
@@ -29,18 +47,37 @@ typedef struct zlog_conf_s {
 
 	unsigned int file_perms;
 	size_t fsync_period;
-	size_t reload_conf_period;
+	long fsync_interval;
+	zlog_syncer_t *syncer;
+	int io_engine;
+	zlog_uring_t *uring;
+	size_t pipe_buffer;
+	long pipe_full_wait;
+	long reload_conf_interval;	/* ms between checks of the file, 0 means never */
+	int stats;
+	long stats_period;	/* ms between dumps to stats file, 0 means no dump */
+	char stats_file[MAXLEN_PATH + 1];
 
 	zc_arraylist_t *levels;
 	zc_arraylist_t *formats;
 	zc_arraylist_t *rules;
 	int time_cache_count;
+	int thread_needs;	/* ZLOG_THREAD_xxx bufs the rules use */
+	size_t thread_pool;
+
+	/* only while parsing, the conf in use, formats and rules of it
+	 * the same as in the file are kept, with their fds and state */
+	struct zlog_conf_s *last;
+	int keep_rules;
 } zlog_conf_t;
 
 extern zlog_conf_t * zlog_env_conf;
 
-zlog_conf_t *zlog_conf_new(const char *confpath);
+/* last is the conf in use on reload, else NULL */
+zlog_conf_t *zlog_conf_new(const char *confpath, zlog_conf_t * last);
 void zlog_conf_del(zlog_conf_t * a_conf);
 void zlog_conf_profile(zlog_conf_t * a_conf, int flag);
+/* 1 if threads have to rebuild bufs and time caches for a_conf */
+int zlog_conf_thread_changed(zlog_conf_t * a_conf, zlog_conf_t * last);
 
 #endif
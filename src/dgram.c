@@ -0,0 +1,405 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <syslog.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "zc_defs.h"
+#include "level.h"
+#include "dgram.h"
+
+#ifndef __linux__
+/* no sendmmsg, one sendmsg a time */
+struct mmsghdr {
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+#endif
+
+/* spool of each native syslog rule, a line longer than it is an error */
+#define ZLOG_DGRAM_SPOOL (1024 * 1024)
+
+typedef struct zlog_dgram_line_s {
+	struct timeval tv;
+	int level;
+} zlog_dgram_line_t;
+
+void zlog_dgram_profile(zlog_dgram_t * a_dgram, int flag)
+{
+	zc_assert(a_dgram,);
+	zc_profile(flag, "--dgram[%p][%s][%d][%s,%s][%d][%ld,%ld,%ld]--",
+		a_dgram,
+		a_dgram->target,
+		a_dgram->frame,
+		a_dgram->host,
+		a_dgram->ident,
+		a_dgram->fd,
+		(long)a_dgram->sent,
+		(long)a_dgram->sends,
+		(long)a_dgram->dropped);
+	return;
+}
+
+/*******************************************************************************/
+static int zlog_dgram_connect_unix(zlog_dgram_t * a_dgram, const char *path)
+{
+	int fd;
+	struct sockaddr_un addr;
+
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		zc_error("unix socket path[%s] too long", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		zc_error("socket fail, errno[%d]", errno);
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		zc_warn("connect [%s] fail, errno[%d]", path, errno);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int zlog_dgram_connect_udp(zlog_dgram_t * a_dgram, const char *host_port)
+{
+	int rc;
+	int fd = -1;
+	char host[MAXLEN_PATH + 1];
+	char *port;
+	struct addrinfo hints;
+	struct addrinfo *res;
+	struct addrinfo *ai;
+
+	snprintf(host, sizeof(host), "%s", host_port);
+	port = strrchr(host, ':');
+	if (!port) {
+		zc_error("no port in [%s]", host_port);
+		return -1;
+	}
+	*port++ = '\0';
+
+	memset(&hints, 0x00, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	rc = getaddrinfo(host, port, &hints, &res);
+	if (rc) {
+		zc_warn("getaddrinfo [%s] fail, rc[%d]", host_port, rc);
+		return -1;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0) continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0) zc_warn("connect [%s] fail, errno[%d]", host_port, errno);
+	return fd;
+}
+
+static int zlog_dgram_connect(zlog_dgram_t * a_dgram)
+{
+	int fd;
+
+	if (STRNCMP(a_dgram->target, ==, "udp:", 4)) {
+		fd = zlog_dgram_connect_udp(a_dgram, a_dgram->target + 4);
+	} else if (STRNCMP(a_dgram->target, ==, "unix:", 5)) {
+		fd = zlog_dgram_connect_unix(a_dgram, a_dgram->target + 5);
+	} else {
+		fd = zlog_dgram_connect_unix(a_dgram, a_dgram->target);
+	}
+	if (fd < 0) return -1;
+
+	/* a slow syslogd delays the sender, never the writers */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	a_dgram->fd = fd;
+	return 0;
+}
+
+static void zlog_dgram_disconnect(zlog_dgram_t * a_dgram)
+{
+	if (a_dgram->fd >= 0) close(a_dgram->fd);
+	a_dgram->fd = -1;
+	a_dgram->retry_at = time(NULL) + 1;
+	return;
+}
+
+/*******************************************************************************/
+static size_t zlog_dgram_frame(zlog_dgram_t * a_dgram, char *head,
+		zlog_dgram_line_t *a_line, long pid)
+{
+	int len;
+	struct tm tm;
+	long gmtoff;
+
+	if (a_line->tv.tv_sec != a_dgram->time_sec) {
+		localtime_r(&(a_line->tv.tv_sec), &tm);
+		a_dgram->time_sec = a_line->tv.tv_sec;
+		if (a_dgram->frame == ZLOG_DGRAM_RFC5424) {
+			strftime(a_dgram->time_str, sizeof(a_dgram->time_str), "%Y-%m-%dT%H:%M:%S", &tm);
+			gmtoff = tm.tm_gmtoff;
+			snprintf(a_dgram->zone_str, sizeof(a_dgram->zone_str), "%c%02ld:%02ld",
+				gmtoff < 0 ? '-' : '+', labs(gmtoff) / 3600, labs(gmtoff) % 3600 / 60);
+		} else {
+			strftime(a_dgram->time_str, sizeof(a_dgram->time_str), "%b %e %H:%M:%S", &tm);
+		}
+	}
+
+	if (a_dgram->frame == ZLOG_DGRAM_RFC5424) {
+		/* <PRI>1 TIMESTAMP HOST APP PROCID MSGID SD MSG */
+		len = snprintf(head, ZLOG_DGRAM_HEAD_MAX, "%s1 %s.%06ld%s %s %s %ld - - ",
+				a_dgram->pri[a_line->level].str,
+				a_dgram->time_str, (long)a_line->tv.tv_usec, a_dgram->zone_str,
+				a_dgram->host, a_dgram->ident, pid);
+	} else {
+		/* <PRI>Mmm dd hh:mm:ss TAG[PID]: MSG */
+		len = snprintf(head, ZLOG_DGRAM_HEAD_MAX, "%s%s %s[%ld]: ",
+				a_dgram->pri[a_line->level].str,
+				a_dgram->time_str, a_dgram->ident, pid);
+	}
+	return (len < ZLOG_DGRAM_HEAD_MAX) ? len : ZLOG_DGRAM_HEAD_MAX - 1;
+}
+
+/* return how many are gone, sent or dropped */
+static int zlog_dgram_send(zlog_dgram_t * a_dgram, struct mmsghdr *msgs, int count)
+{
+	int rc;
+	struct pollfd pfd;
+
+#ifdef __linux__
+	rc = sendmmsg(a_dgram->fd, msgs, count, MSG_NOSIGNAL);
+#else
+	rc = (sendmsg(a_dgram->fd, &(msgs[0].msg_hdr), 0) < 0) ? -1 : 1;
+#endif
+	if (rc > 0) {
+		a_dgram->sent += rc;
+		a_dgram->sends++;
+		return rc;
+	}
+
+	switch (errno) {
+	case EINTR:
+		return 0;
+	case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+	case EWOULDBLOCK:
+#endif
+		pfd.fd = a_dgram->fd;
+		pfd.events = POLLOUT;
+		if (poll(&pfd, 1, 1000) > 0) return 0;
+		zc_warn("[%s] too slow, drop %d lines", a_dgram->target, count);
+		break;
+	case EMSGSIZE:
+	case ENOBUFS:
+		/* only this one */
+		count = 1;
+		break;
+	default:
+		zc_warn("send to [%s] fail, errno[%d], drop %d lines",
+			a_dgram->target, errno, count);
+		zlog_dgram_disconnect(a_dgram);
+		break;
+	}
+	a_dgram->dropped += count;
+	return count;
+}
+
+static void zlog_dgram_send_all(zlog_dgram_t * a_dgram, struct mmsghdr *msgs, int count)
+{
+	int i;
+
+	for (i = 0; i < count && a_dgram->fd >= 0; ) {
+		i += zlog_dgram_send(a_dgram, msgs + i, count - i);
+	}
+	a_dgram->dropped += count - i;
+	return;
+}
+
+static void zlog_dgram_flush(zlog_dgram_t * a_dgram, char *batch, size_t batch_len)
+{
+	int n = 0;
+	long pid;
+	size_t len;
+	char *msg;
+	zlog_spool_rec_t *a_rec;
+	zlog_dgram_line_t *a_line;
+	char head[ZLOG_DGRAM_BATCH][ZLOG_DGRAM_HEAD_MAX];
+	struct iovec iov[ZLOG_DGRAM_BATCH][2];
+	struct mmsghdr msgs[ZLOG_DGRAM_BATCH];
+
+	pid = (long)getpid();
+	memset(msgs, 0x00, sizeof(msgs));
+
+	zlog_spool_foreach(batch, batch_len, a_rec) {
+		a_line = (zlog_dgram_line_t *)a_rec->data;
+		msg = a_rec->data + sizeof(zlog_dgram_line_t);
+		len = a_rec->len - sizeof(zlog_dgram_line_t);
+		/* syslogd ends the line itself */
+		if (len && msg[len - 1] == '\n') len--;
+
+		iov[n][0].iov_base = head[n];
+		iov[n][0].iov_len = zlog_dgram_frame(a_dgram, head[n], a_line, pid);
+		iov[n][1].iov_base = msg;
+		iov[n][1].iov_len = len;
+		msgs[n].msg_hdr.msg_iov = iov[n];
+		msgs[n].msg_hdr.msg_iovlen = 2;
+		if (++n < ZLOG_DGRAM_BATCH) continue;
+
+		zlog_dgram_send_all(a_dgram, msgs, n);
+		n = 0;
+	}
+
+	if (n) zlog_dgram_send_all(a_dgram, msgs, n);
+	return;
+}
+
+static void zlog_dgram_run(void *arg)
+{
+	char *batch;
+	size_t len;
+	zlog_dgram_t *a_dgram = arg;
+
+	while ((batch = zlog_spool_take(a_dgram->spool, &len))) {
+		if (a_dgram->fd < 0 && time(NULL) >= a_dgram->retry_at) {
+			if (zlog_dgram_connect(a_dgram)) zlog_dgram_disconnect(a_dgram);
+		}
+		zlog_dgram_flush(a_dgram, batch, len);
+		zlog_spool_done(a_dgram->spool);
+	}
+	return;
+}
+
+/*******************************************************************************/
+int zlog_dgram_write(zlog_dgram_t * a_dgram, int level, struct timeval *tv,
+		const char *msg, size_t len)
+{
+	int rc;
+	zlog_dgram_line_t a_line;
+	struct iovec iov[2];
+
+	a_line.tv = *tv;
+	a_line.level = level & 0xff;
+	iov[0].iov_base = &a_line;
+	iov[0].iov_len = sizeof(a_line);
+	iov[1].iov_base = (void *)msg;
+	iov[1].iov_len = len;
+
+	/* before the put, a forked child has no sender yet */
+	if (zlog_worker_start(a_dgram->worker)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+	/* never wait, a full spool means the target is slow or gone */
+	rc = zlog_spool_putv(a_dgram->spool, a_dgram, iov, 2, 0);
+	if (rc == 1) {
+		zlog_worker_kick(a_dgram->worker);
+	} else if (rc < 0 && zlog_spool_rec_size(sizeof(a_line) + len) > a_dgram->spool->size) {
+		zc_error("zlog_spool_putv fail");
+		return -1;
+	}
+	return 0;
+}
+
+/*******************************************************************************/
+void zlog_dgram_del(zlog_dgram_t * a_dgram)
+{
+	zc_assert(a_dgram,);
+
+	/* sender sends the rest before it stops */
+	if (a_dgram->worker) zlog_worker_del(a_dgram->worker);
+	if (a_dgram->spool) zlog_spool_del(a_dgram->spool);
+	if (a_dgram->fd >= 0) close(a_dgram->fd);
+	free(a_dgram);
+	zc_debug("zlog_dgram_del[%p]", a_dgram);
+	return;
+}
+
+zlog_dgram_t *zlog_dgram_new(const char *target, int frame, int facility,
+		zc_arraylist_t * levels)
+{
+	int i;
+	int severity;
+	zlog_level_t *a_level;
+	zlog_dgram_t *a_dgram;
+
+	zc_assert(target, NULL);
+	zc_assert(levels, NULL);
+
+	a_dgram = calloc(1, sizeof(zlog_dgram_t));
+	if (!a_dgram) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_dgram->fd = -1;
+	a_dgram->frame = frame;
+	snprintf(a_dgram->target, sizeof(a_dgram->target), "%s", target);
+
+	/* pri of every level, no level list lookup for a line */
+	for (i = 0; i < 256; i++) {
+		a_level = zc_arraylist_get(levels, i);
+		if (!a_level) a_level = zc_arraylist_get(levels, 254);
+		severity = a_level ? a_level->syslog_level : LOG_DEBUG;
+		a_dgram->pri[i].len = snprintf(a_dgram->pri[i].str, sizeof(a_dgram->pri[i].str),
+					"<%d>", facility | severity);
+	}
+
+	if (gethostname(a_dgram->host, sizeof(a_dgram->host) - 1)) {
+		zc_warn("gethostname fail, errno[%d]", errno);
+		strcpy(a_dgram->host, "-");
+	}
+#ifdef __linux__
+	snprintf(a_dgram->ident, sizeof(a_dgram->ident), "%s", program_invocation_short_name);
+#else
+	strcpy(a_dgram->ident, "zlog");
+#endif
+
+	a_dgram->spool = zlog_spool_new(ZLOG_DGRAM_SPOOL);
+	if (!a_dgram->spool) {
+		zc_error("zlog_spool_new fail");
+		goto err;
+	}
+
+	/* thread is not started until the first line */
+	a_dgram->worker = zlog_worker_new("dgram", 0, 0, zlog_dgram_run, a_dgram);
+	if (!a_dgram->worker) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
+	zlog_dgram_profile(a_dgram, ZC_DEBUG);
+	return a_dgram;
+err:
+	zlog_dgram_del(a_dgram);
+	return NULL;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_dgram_h
+#define __zlog_dgram_h
+
+/* dgram, is the native syslog output, for rules like
+ *	>syslog, LOG_LOCAL0 frame=rfc5424 target=udp:loghost:514
+ * writers copy level, time and message into a spool and return.
+ * a sender thread frames each line as RFC3164 or RFC5424,
+ * and sends a batch with sendmmsg() to /dev/log, a unix socket or udp.
+ * when the target is gone, lines are dropped and counted,
+ * the sender connects again a second later, writers never wait.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "zc_defs.h"
+#include "spool.h"
+#include "worker.h"
+
+#define ZLOG_DGRAM_RFC3164 0
+#define ZLOG_DGRAM_RFC5424 1
+
+#define ZLOG_DGRAM_BATCH 64
+#define ZLOG_DGRAM_HEAD_MAX 384
+
+typedef struct zlog_dgram_pri_s {
+	char str[8];		/* "<191>" */
+	size_t len;
+} zlog_dgram_pri_t;
+
+typedef struct zlog_dgram_s {
+	char target[MAXLEN_PATH + 1];
+	int frame;
+	zlog_dgram_pri_t pri[256];	/* by zlog level */
+	char host[256 + 1];
+	char ident[64 + 1];
+
+	zlog_spool_t *spool;
+	zlog_worker_t *worker;
+
+	/* only used by sender */
+	int fd;
+	time_t retry_at;
+	time_t time_sec;
+	char time_str[64];
+	char zone_str[32];
+
+	size_t sent;
+	size_t sends;		/* sendmmsg calls */
+	size_t dropped;		/* target gone or too slow */
+} zlog_dgram_t;
+
+/* target	/dev/log, unix:path or udp:host:port
+ * facility	LOG_LOCAL0 ...
+ * levels	pri of each level is made here
+ */
+zlog_dgram_t *zlog_dgram_new(const char *target, int frame, int facility,
+		zc_arraylist_t * levels);
+void zlog_dgram_del(zlog_dgram_t * a_dgram);
+void zlog_dgram_profile(zlog_dgram_t * a_dgram, int flag);
+
+/* return 0 queued or dropped, -1 fail */
+int zlog_dgram_write(zlog_dgram_t * a_dgram, int level, struct timeval *tv,
+		const char *msg, size_t len);
+
+#endif
@@ -16,6 +16,9 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "zc_defs.h"
 #include "event.h"
@@ -23,15 +26,15 @@
 void zlog_event_profile(zlog_event_t * a_event, int flag)
 {
 	zc_assert(a_event,);
-	zc_profile(flag, "---event[%p][%s,%s][%s(%ld),%s(%ld),%ld,%d][%p,%s][%ld,%ld][%ld,%ld][%d]---",
+	zc_profile(flag, "---event[%p][%s][%s(%ld),%s(%ld),%ld,%d][%p,%s][%ld,%ld][%ld][%d]---",
 			a_event,
-			a_event->category_name, a_event->host_name,
+			a_event->category_name,
 			a_event->file, a_event->file_len,
 			a_event->func, a_event->func_len,
 			a_event->line, a_event->level,
 			a_event->hex_buf, a_event->str_format,	
 			a_event->time_stamp.tv_sec, a_event->time_stamp.tv_usec,
-			(long)a_event->pid, (long)a_event->tid,
+			(long)a_event->tid,
 			a_event->time_cache_count);
 	return;
 }
@@ -57,38 +60,69 @@ zlog_event_t *zlog_event_new(int time_cache_count)
 		return NULL;
 	}
 
-	a_event->time_caches = calloc(time_cache_count, sizeof(zlog_time_cache_t));
-	if (!a_event->time_caches) {
-		zc_error("calloc fail, errno[%d]", errno);
-		return NULL;
-	}
+	/* time_caches are made at the first %d */
 	a_event->time_cache_count = time_cache_count;
 
-	/*
-	 * at the zlog_init we gethostname,
-	 * u don't always change your hostname, eh?
-	 */
-	if (gethostname(a_event->host_name, sizeof(a_event->host_name) - 1)) {
-		zc_error("gethostname fail, errno[%d]", errno);
-		goto err;
-	}
-
-	a_event->host_name_len = strlen(a_event->host_name);
-
 	/* tid is bound to a_event
 	 * as in whole lifecycle event persists
 	 * even fork to oth pid, tid not change
 	 */
+	zlog_event_set_tid(a_event);
+
+	//zlog_event_profile(a_event, ZC_DEBUG);
+	return a_event;
+}
+
+/* a recycled event moves to another thread */
+void zlog_event_set_tid(zlog_event_t * a_event)
+{
 	a_event->tid = pthread_self();
 
 	a_event->tid_str_len = sprintf(a_event->tid_str, "%lu", (unsigned long)a_event->tid);
 	a_event->tid_hex_str_len = sprintf(a_event->tid_hex_str, "0x%x", (unsigned int)a_event->tid);
+	a_event->ktid_pid = 0;
+	a_event->thread_name_stale = 1;
+	return;
+}
 
-	//zlog_event_profile(a_event, ZC_DEBUG);
-	return a_event;
-err:
-	zlog_event_del(a_event);
-	return NULL;
+/* kernel tid as in top -H and /proc */
+void zlog_event_set_ktid(zlog_event_t * a_event, pid_t pid)
+{
+#ifdef __linux__
+	a_event->ktid_str_len = sprintf(a_event->ktid_str, "%ld", (long)syscall(SYS_gettid));
+#else
+	strcpy(a_event->ktid_str, a_event->tid_str);
+	a_event->ktid_str_len = a_event->tid_str_len;
+#endif
+	a_event->ktid_pid = pid;
+	return;
+}
+
+/* name of pthread_setname_np(), which may change any time,
+ * so it is got again when the thread tells
+ */
+void zlog_event_set_thread_name(zlog_event_t * a_event)
+{
+#ifdef __linux__
+	if (pthread_getname_np(a_event->tid, a_event->thread_name, sizeof(a_event->thread_name))) {
+		a_event->thread_name[0] = '\0';
+	}
+#else
+	a_event->thread_name[0] = '\0';
+#endif
+	a_event->thread_name_len = strlen(a_event->thread_name);
+	a_event->thread_name_stale = 0;
+	return;
+}
+
+int zlog_event_new_time_caches(zlog_event_t * a_event)
+{
+	a_event->time_caches = calloc(a_event->time_cache_count, sizeof(zlog_time_cache_t));
+	if (!a_event->time_caches) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return -1;
+	}
+	return 0;
 }
 
 /*******************************************************************************/
@@ -114,12 +148,6 @@ void zlog_event_set_fmt(zlog_event_t * a_event,
 	a_event->str_format = str_format;
 	va_copy(a_event->str_args, str_args);
 
-	/* pid should fetch eveytime, as no one knows,
-	 * when does user fork his process
-	 * so clean here, and fetch at spec.c
-	 */
-	a_event->pid = (pid_t) 0;
-
 	/* in a event's life cycle, time will be get when spec need,
 	 * and keep unchange though all event's life cycle
 	 * zlog_spec_write_time gettimeofday
@@ -150,12 +178,6 @@ void zlog_event_set_hex(zlog_event_t * a_event,
 	a_event->hex_buf = hex_buf;
 	a_event->hex_buf_len = hex_buf_len;
 
-	/* pid should fetch eveytime, as no one knows,
-	 * when does user fork his process
-	 * so clean here, and fetch at spec.c
-	 */
-	a_event->pid = (pid_t) 0;
-
 	/* in a event's life cycle, time will be get when spec need,
 	 * and keep unchange though all event's life cycle
 	 */
@@ -29,8 +29,6 @@ typedef struct zlog_time_cache_s {
 typedef struct {
 	char *category_name;
 	size_t category_name_len;
-	char host_name[256 + 1];
-	size_t host_name_len;
 
 	const char *file;
 	size_t file_len;
@@ -50,26 +48,34 @@ typedef struct {
 	time_t time_local_sec;
 	struct tm time_local;	
 
-	zlog_time_cache_t *time_caches;
+	zlog_time_cache_t *time_caches;	/* NULL till the first %d */
 	int time_cache_count;
 
-	pid_t pid;
-	pid_t last_pid;
-	char pid_str[30 + 1];
-	size_t pid_str_len;
-
 	pthread_t tid;
 	char tid_str[30 + 1];
 	size_t tid_str_len;
 
 	char tid_hex_str[30 + 1];
 	size_t tid_hex_str_len;
+
+	/* got at the first %k, again in a child after fork */
+	pid_t ktid_pid;
+	char ktid_str[30 + 1];
+	size_t ktid_str_len;
+	/* got at the first %N, again after zlog_thread_name_changed() or a reload */
+	int thread_name_stale;
+	char thread_name[16 + 1];
+	size_t thread_name_len;
 } zlog_event_t;
 
 
 zlog_event_t *zlog_event_new(int time_cache_count);
 void zlog_event_del(zlog_event_t * a_event);
 void zlog_event_profile(zlog_event_t * a_event, int flag);
+int zlog_event_new_time_caches(zlog_event_t * a_event);
+void zlog_event_set_tid(zlog_event_t * a_event);
+void zlog_event_set_ktid(zlog_event_t * a_event, pid_t pid);
+void zlog_event_set_thread_name(zlog_event_t * a_event);
 
 void zlog_event_set_fmt(zlog_event_t * a_event,
 			char *category_name, size_t category_name_len,
@@ -3,6 +3,13 @@
 
 #define _BSD_SOURCE
 
+#if defined(__linux__)
+/* fallocate() and other linux only calls */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #if defined(__linux__) || defined(__OpenBSD__) || defined(_AIX)
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE 700
@@ -17,6 +17,7 @@
 #include "thread.h"
 #include "spec.h"
 #include "format.h"
+#include "probe.h"
 
 void zlog_format_profile(zlog_format_t * a_format, int flag)
 {
@@ -43,6 +44,7 @@ void zlog_format_profile(zlog_format_t * a_format, int flag)
 void zlog_format_del(zlog_format_t * a_format)
 {
 	zc_assert(a_format,);
+	if (--a_format->refs > 0) return;
 	if (a_format->pattern_specs) {
 		zc_arraylist_del(a_format->pattern_specs);
 	}
@@ -69,6 +71,7 @@ zlog_format_t *zlog_format_new(char *line, int * time_cache_count)
 		zc_error("calloc fail, errno[%d]", errno);
 		return NULL;
 	}
+	a_format->refs = 1;
 
 	/* line         default = "%d(%F %X.%l) %-6V (%c:%F:%L) - %m%n"
 	 * name         default
@@ -141,6 +144,28 @@ err:
 	return NULL;
 }
 
+/*******************************************************************************/
+int zlog_format_is_same(zlog_format_t * a_format, zlog_format_t * other)
+{
+	int i;
+	zlog_spec_t *a_spec;
+
+	zc_assert(a_format, 0);
+	zc_assert(other, 0);
+
+	if (STRCMP(a_format->name, !=, other->name)) return 0;
+	if (STRCMP(a_format->pattern, !=, other->pattern)) return 0;
+
+	/* the same pattern has the same specs */
+	zc_arraylist_foreach(a_format->pattern_specs, i, a_spec) {
+		if (zlog_spec_time_cache_index(a_spec) !=
+			zlog_spec_time_cache_index(zc_arraylist_get(other->pattern_specs, i))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
 /*******************************************************************************/
 /* return 0	success, or buf is full
  * return -1	fail
@@ -148,17 +173,26 @@ err:
 int zlog_format_gen_msg(zlog_format_t * a_format, zlog_thread_t * a_thread)
 {
 	int i;
+	int rc = 0;
 	zlog_spec_t *a_spec;
+	unsigned long long start = 0;
 
+	if (a_thread->stats) start = zlog_stats_now();
 	zlog_buf_restart(a_thread->msg_buf);
 
 	zc_arraylist_foreach(a_format->pattern_specs, i, a_spec) {
 		if (zlog_spec_gen_msg(a_spec, a_thread) == 0) {
 			continue;
 		} else {
-			return -1;
+			rc = -1;
+			break;
 		}
 	}
 
-	return 0;
+	ZLOG_PROBE2(format__done, zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf));
+	if (a_thread->stats) {
+		a_thread->stats->formats++;
+		a_thread->stats->format_ns += zlog_stats_now() - start;
+	}
+	return rc;
 }
@@ -18,11 +18,14 @@ struct zlog_format_s {
 	char name[MAXLEN_CFG_LINE + 1];	
 	char pattern[MAXLEN_CFG_LINE + 1];
 	zc_arraylist_t *pattern_specs;
+	int refs;	/* confs holding it, 2 while a reload keeps it */
 };
 
 zlog_format_t *zlog_format_new(char *line, int * time_cache_count);
 void zlog_format_del(zlog_format_t * a_format);
 void zlog_format_profile(zlog_format_t * a_format, int flag);
+/* same name, pattern and time caches, a reload may keep the old one */
+int zlog_format_is_same(zlog_format_t * a_format, zlog_format_t * other);
 
 int zlog_format_gen_msg(zlog_format_t * a_format, zlog_thread_t * a_thread);
 
@@ -143,3 +143,25 @@ int zlog_level_list_atoi(zc_arraylist_t *levels, char *str)
 	return -1;
 }
 
+/*******************************************************************************/
+int zlog_level_list_is_same(zc_arraylist_t *levels, zc_arraylist_t *other)
+{
+	int i;
+	zlog_level_t *a_level;
+	zlog_level_t *b_level;
+
+	zc_assert(levels, 0);
+	zc_assert(other, 0);
+
+	for (i = 0; i < 256; i++) {
+		a_level = zc_arraylist_get(levels, i);
+		b_level = zc_arraylist_get(other, i);
+		if (!a_level && !b_level) continue;
+		if (!a_level || !b_level) return 0;
+		if (STRCMP(a_level->str_uppercase, !=, b_level->str_uppercase)
+			|| a_level->syslog_level != b_level->syslog_level) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -29,5 +29,8 @@ zlog_level_t *zlog_level_list_get(zc_arraylist_t *levels, int l);
 /* if not found, return -1 */
 int zlog_level_list_atoi(zc_arraylist_t *levels, char *str);
 
+/* reload use, 1 if every level is the same */
+int zlog_level_list_is_same(zc_arraylist_t *levels, zc_arraylist_t *other);
+
 
 #endif
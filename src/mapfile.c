@@ -0,0 +1,549 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "zc_defs.h"
+#include "mapfile.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* address space kept mapped, lines beyond it are written by pwrite,
+ * until the window moves forward
+ */
+#define ZLOG_MAPFILE_WINDOW ((off_t)(sizeof(void *) > 4 ? (1L << 30) : (64L << 20)))
+
+/* seconds to wait for a writer in the middle of a copy */
+#define ZLOG_MAPFILE_STUCK 5
+
+/* all mapfiles, so a forked child can reset their locks */
+static pthread_mutex_t zlog_mapfiles_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zlog_mapfile_t *zlog_mapfiles;
+static pthread_once_t zlog_mapfile_once = PTHREAD_ONCE_INIT;
+
+static void zlog_mapfile_prepare(void)
+{
+	pthread_mutex_lock(&zlog_mapfiles_mutex);
+}
+
+static void zlog_mapfile_parent(void)
+{
+	pthread_mutex_unlock(&zlog_mapfiles_mutex);
+}
+
+/* the threads holding the locks are not in the child.
+ * what they hold in the shared page is released by the parent
+ */
+static void zlog_mapfile_child(void)
+{
+	zlog_mapfile_t *a_mapfile;
+
+	pthread_mutex_init(&zlog_mapfiles_mutex, NULL);
+	for (a_mapfile = zlog_mapfiles; a_mapfile; a_mapfile = a_mapfile->next) {
+		pthread_mutex_init(&(a_mapfile->lock_mutex), NULL);
+		pthread_mutex_init(&(a_mapfile->extend_mutex), NULL);
+		a_mapfile->closed = 0;
+	}
+}
+
+static void zlog_mapfile_atfork(void)
+{
+	pthread_atfork(zlog_mapfile_prepare, zlog_mapfile_parent, zlog_mapfile_child);
+}
+
+void zlog_mapfile_profile(zlog_mapfile_t * a_mapfile, int flag)
+{
+	zc_assert(a_mapfile,);
+	zc_profile(flag, "--mapfile[%p][%s][%ld,%ld][%d,%p,%d][%ld,%ld,%ld,%d][%ld]--",
+		a_mapfile,
+		a_mapfile->path,
+		(long)a_mapfile->chunk,
+		a_mapfile->limit,
+		a_mapfile->fd,
+		a_mapfile->base,
+		a_mapfile->gen,
+		(long)a_mapfile->map_start,
+		(long)a_mapfile->shared->file_size,
+		(long)a_mapfile->shared->offset,
+		a_mapfile->shared->gen,
+		(long)a_mapfile->overflows);
+	return;
+}
+
+/*******************************************************************************/
+/* one process at a time opens, remaps or closes,
+ * a holder which is gone in the middle is taken over
+ */
+static void zlog_mapfile_hold(zlog_mapfile_t * a_mapfile)
+{
+	long spins = 0;
+	pid_t pid = getpid();
+	pid_t holder;
+
+	while (!__sync_bool_compare_and_swap(&(a_mapfile->shared->held), 0, pid)) {
+		sched_yield();
+		if (++spins % 1024) continue;
+		holder = __atomic_load_n(&(a_mapfile->shared->held), __ATOMIC_SEQ_CST);
+		if (holder && kill(holder, 0) && errno == ESRCH
+			&& __sync_bool_compare_and_swap(&(a_mapfile->shared->held), holder, pid)) {
+			zc_warn("[%s] is held by process[%ld] which is gone, take over",
+				a_mapfile->path, (long)holder);
+			return;
+		}
+	}
+	return;
+}
+
+/* hold new writers off, and wait for those in the middle of a copy.
+ * one killed there never comes out, go on without it at last
+ */
+static void zlog_mapfile_quiesce(zlog_mapfile_t * a_mapfile)
+{
+	long spins = 0;
+	time_t since = 0;
+
+	zlog_mapfile_hold(a_mapfile);
+	__sync_synchronize();
+	while (__atomic_load_n(&(a_mapfile->shared->inflight), __ATOMIC_SEQ_CST)) {
+		sched_yield();
+		if (++spins % 1024) continue;
+		if (!since) {
+			since = time(NULL);
+		} else if (time(NULL) - since > ZLOG_MAPFILE_STUCK) {
+			zc_error("[%s] has writers in a copy for %ds, go on",
+				a_mapfile->path, ZLOG_MAPFILE_STUCK);
+			break;
+		}
+	}
+	return;
+}
+
+static void zlog_mapfile_release(zlog_mapfile_t * a_mapfile)
+{
+	__sync_synchronize();
+	__atomic_store_n(&(a_mapfile->shared->held), 0, __ATOMIC_SEQ_CST);
+	return;
+}
+
+/* lock_mutex held, drop the view of this process */
+static void zlog_mapfile_unmap(zlog_mapfile_t * a_mapfile)
+{
+	if (a_mapfile->base) {
+		if (munmap(a_mapfile->base, ZLOG_MAPFILE_WINDOW)) {
+			zc_error("munmap [%s] fail, errno[%d]", a_mapfile->path, errno);
+		}
+		a_mapfile->base = NULL;
+	}
+	if (a_mapfile->fd >= 0) {
+		if (close(a_mapfile->fd)) {
+			zc_error("close [%s] fail, errno[%d]", a_mapfile->path, errno);
+		}
+		a_mapfile->fd = -1;
+	}
+	return;
+}
+
+/* lock_mutex held, quiesced, fd of the file of gen.
+ * give back the extended tail, unless someone else wrote beyond it,
+ * writers of other processes extend it again
+ */
+static void zlog_mapfile_trim(zlog_mapfile_t * a_mapfile)
+{
+	struct zlog_stat info;
+	zlog_mapfile_shared_t *a_shared = a_mapfile->shared;
+
+	if (zlog_fstat(a_mapfile->fd, &info)) {
+		zc_error("fstat [%s] fail, errno[%d]", a_mapfile->path, errno);
+	} else if (info.st_size > a_shared->file_size) {
+		zc_warn("[%s] is appended by others, keep size[%ld]",
+			a_mapfile->path, (long)info.st_size);
+	} else if (a_shared->offset < info.st_size) {
+		if (ftruncate(a_mapfile->fd, a_shared->offset)) {
+			zc_error("ftruncate [%s] fail, errno[%d]", a_mapfile->path, errno);
+		} else {
+			a_shared->file_size = a_shared->offset;
+		}
+	}
+	return;
+}
+
+/* lock_mutex held, fd open, no writer in, map the window at the offset */
+static int zlog_mapfile_map(zlog_mapfile_t * a_mapfile)
+{
+	void *base;
+	off_t start;
+
+	start = a_mapfile->shared->offset & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+	base = mmap(NULL, ZLOG_MAPFILE_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED,
+			a_mapfile->fd, start);
+	if (base == MAP_FAILED) {
+		zc_error("mmap [%s] fail, errno[%d]", a_mapfile->path, errno);
+		return -1;
+	}
+
+	a_mapfile->map_start = start;
+	__sync_synchronize();
+	a_mapfile->base = base;
+	return 0;
+}
+
+/* lock_mutex and held, the first process opening the file
+ * after new or rotate sets the offset up
+ */
+static int zlog_mapfile_open(zlog_mapfile_t * a_mapfile)
+{
+	struct zlog_stat info;
+	zlog_mapfile_shared_t *a_shared = a_mapfile->shared;
+
+	zlog_mapfile_unmap(a_mapfile);
+
+	a_mapfile->fd = open(a_mapfile->path,
+		O_RDWR | O_CREAT | a_mapfile->flags, a_mapfile->perms);
+	if (a_mapfile->fd < 0) {
+		zc_error("open file[%s] fail, errno[%d]", a_mapfile->path, errno);
+		return -1;
+	}
+
+	if (zlog_fstat(a_mapfile->fd, &info)) {
+		zc_error("fstat [%s] fail, errno[%d]", a_mapfile->path, errno);
+		goto err;
+	}
+	if (!a_shared->opened) {
+		/* still too big after rotate, the rotater skipped it,
+		 * ask again a second later rather than at every line
+		 */
+		if (a_shared->gen && a_mapfile->limit > 0 && info.st_size > a_mapfile->limit) {
+			a_shared->rotate_after = time(NULL) + 1;
+		}
+		a_shared->file_size = info.st_size;
+		a_shared->offset = info.st_size;
+		a_shared->rotate_pending = 0;
+		a_shared->opened = 1;
+	}
+	a_mapfile->gen = a_shared->gen;
+
+	if (zlog_mapfile_map(a_mapfile)) {
+		zc_error("zlog_mapfile_map fail");
+		goto err;
+	}
+	return 0;
+err:
+	close(a_mapfile->fd);
+	a_mapfile->fd = -1;
+	return -1;
+}
+
+/* writers come here when the file is closed, held or rotated */
+static int zlog_mapfile_wait(zlog_mapfile_t * a_mapfile)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&(a_mapfile->lock_mutex));
+	zlog_mapfile_hold(a_mapfile);
+	if (!a_mapfile->base || a_mapfile->gen != a_mapfile->shared->gen) {
+		rc = zlog_mapfile_open(a_mapfile);
+	}
+	zlog_mapfile_release(a_mapfile);
+	pthread_mutex_unlock(&(a_mapfile->lock_mutex));
+	return rc;
+}
+
+/* move the window to the offset, one thread does it, others go on by pwrite */
+static void zlog_mapfile_remap(zlog_mapfile_t * a_mapfile)
+{
+	if (pthread_mutex_trylock(&(a_mapfile->lock_mutex))) return;
+
+	zlog_mapfile_quiesce(a_mapfile);
+	if (a_mapfile->base && a_mapfile->gen == a_mapfile->shared->gen
+		&& a_mapfile->shared->offset > a_mapfile->map_start + ZLOG_MAPFILE_WINDOW / 2) {
+		if (munmap(a_mapfile->base, ZLOG_MAPFILE_WINDOW)) {
+			zc_error("munmap [%s] fail, errno[%d]", a_mapfile->path, errno);
+		}
+		a_mapfile->base = NULL;
+		if (zlog_mapfile_map(a_mapfile)) {
+			zc_error("zlog_mapfile_map fail, close [%s]", a_mapfile->path);
+			zlog_mapfile_unmap(a_mapfile);
+		}
+	}
+	zlog_mapfile_release(a_mapfile);
+
+	pthread_mutex_unlock(&(a_mapfile->lock_mutex));
+	return;
+}
+
+/* other processes extend the file too, the size never goes back here */
+static void zlog_mapfile_sized(zlog_mapfile_t * a_mapfile, off_t size)
+{
+	off_t old;
+
+	do {
+		old = __atomic_load_n(&(a_mapfile->shared->file_size), __ATOMIC_SEQ_CST);
+		if (old >= size) return;
+	} while (!__sync_bool_compare_and_swap(&(a_mapfile->shared->file_size), old, size));
+	return;
+}
+
+/* extend_mutex held, the file never shrinks here, pwrite may grow it */
+static int zlog_mapfile_grow(zlog_mapfile_t * a_mapfile, off_t end)
+{
+	off_t size;
+	off_t from;
+	struct zlog_stat info;
+
+	size = end + a_mapfile->chunk;
+	from = __atomic_load_n(&(a_mapfile->shared->file_size), __ATOMIC_SEQ_CST);
+
+#ifdef __linux__
+	if (fallocate(a_mapfile->fd, 0, from, size - from) == 0) {
+		zlog_mapfile_sized(a_mapfile, size);
+		return 0;
+	}
+	if (errno != EOPNOTSUPP && errno != ENOSYS) {
+		zc_error("fallocate [%s] fail, errno[%d]", a_mapfile->path, errno);
+		return -1;
+	}
+#endif
+
+	if (zlog_fstat(a_mapfile->fd, &info)) {
+		zc_error("fstat [%s] fail, errno[%d]", a_mapfile->path, errno);
+		return -1;
+	}
+	if (info.st_size < size && ftruncate(a_mapfile->fd, size)) {
+		zc_error("ftruncate [%s] fail, errno[%d]", a_mapfile->path, errno);
+		return -1;
+	}
+	zlog_mapfile_sized(a_mapfile, size);
+	return 0;
+}
+
+static int zlog_mapfile_extend(zlog_mapfile_t * a_mapfile, off_t end)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&(a_mapfile->extend_mutex));
+	if (end > __atomic_load_n(&(a_mapfile->shared->file_size), __ATOMIC_SEQ_CST)) {
+		rc = zlog_mapfile_grow(a_mapfile, end);
+	}
+	pthread_mutex_unlock(&(a_mapfile->extend_mutex));
+	return rc;
+}
+
+static int zlog_mapfile_overflow(zlog_mapfile_t * a_mapfile,
+		const char *data, size_t len, off_t off)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&(a_mapfile->extend_mutex));
+	if (pwrite(a_mapfile->fd, data, len, off) < 0) {
+		zc_error("pwrite [%s] fail, errno[%d]", a_mapfile->path, errno);
+		rc = -1;
+	} else {
+		zlog_mapfile_sized(a_mapfile, off + (off_t)len);
+	}
+	a_mapfile->overflows++;
+	pthread_mutex_unlock(&(a_mapfile->extend_mutex));
+	return rc;
+}
+
+/*******************************************************************************/
+int zlog_mapfile_write(zlog_mapfile_t * a_mapfile, const char *data, size_t len)
+{
+	int rc = 0;
+	int remap = 0;
+	off_t off;
+	off_t end;
+	zlog_mapfile_shared_t *a_shared = a_mapfile->shared;
+
+	for (;;) {
+		__sync_add_and_fetch(&(a_shared->inflight), 1);
+		if (!__atomic_load_n(&(a_shared->held), __ATOMIC_SEQ_CST)
+			&& __atomic_load_n(&(a_mapfile->base), __ATOMIC_SEQ_CST)
+			&& __atomic_load_n(&(a_mapfile->gen), __ATOMIC_SEQ_CST)
+				== __atomic_load_n(&(a_shared->gen), __ATOMIC_SEQ_CST)) break;
+		__sync_sub_and_fetch(&(a_shared->inflight), 1);
+		if (zlog_mapfile_wait(a_mapfile)) return -1;
+	}
+
+	off = __sync_fetch_and_add(&(a_shared->offset), (off_t)len);
+	end = off + (off_t)len;
+
+	if (end > a_mapfile->map_start + ZLOG_MAPFILE_WINDOW) {
+		rc = zlog_mapfile_overflow(a_mapfile, data, len, off);
+		remap = 1;
+	} else {
+		if (end > __atomic_load_n(&(a_shared->file_size), __ATOMIC_SEQ_CST)) {
+			rc = zlog_mapfile_extend(a_mapfile, end);
+		}
+		if (!rc) memcpy(a_mapfile->base + (off - a_mapfile->map_start), data, len);
+	}
+	__sync_sub_and_fetch(&(a_shared->inflight), 1);
+
+	if (rc) return -1;
+	if (remap) zlog_mapfile_remap(a_mapfile);
+
+	if (a_mapfile->limit > 0 && end > a_mapfile->limit
+		&& !__atomic_load_n(&(a_shared->rotate_pending), __ATOMIC_SEQ_CST)
+		&& time(NULL) >= a_shared->rotate_after
+		&& __sync_bool_compare_and_swap(&(a_shared->rotate_pending), 0, 1)) {
+		return 1;
+	}
+	return 0;
+}
+
+void zlog_mapfile_suspend(zlog_mapfile_t * a_mapfile)
+{
+	zlog_mapfile_shared_t *a_shared = a_mapfile->shared;
+
+	pthread_mutex_lock(&(a_mapfile->lock_mutex));
+	zlog_mapfile_quiesce(a_mapfile);
+	if (a_shared->opened) {
+		/* another process may have set up a new file since */
+		if (a_mapfile->fd < 0 || a_mapfile->gen != a_shared->gen) {
+			zlog_mapfile_unmap(a_mapfile);
+			a_mapfile->fd = open(a_mapfile->path, O_RDWR);
+			if (a_mapfile->fd < 0) {
+				zc_error("open file[%s] fail, errno[%d]", a_mapfile->path, errno);
+			}
+			a_mapfile->gen = a_shared->gen;
+		}
+		if (a_mapfile->fd >= 0) zlog_mapfile_trim(a_mapfile);
+		a_shared->opened = 0;
+		a_mapfile->closed = 1;
+	}
+	zlog_mapfile_unmap(a_mapfile);
+	return;
+}
+
+/* writers of all processes open the file again */
+void zlog_mapfile_resume(zlog_mapfile_t * a_mapfile)
+{
+	if (a_mapfile->closed) {
+		__sync_add_and_fetch(&(a_mapfile->shared->gen), 1);
+		a_mapfile->closed = 0;
+	}
+	zlog_mapfile_release(a_mapfile);
+	pthread_mutex_unlock(&(a_mapfile->lock_mutex));
+	return;
+}
+
+/*******************************************************************************/
+void zlog_mapfile_del(zlog_mapfile_t * a_mapfile)
+{
+	zc_assert(a_mapfile,);
+
+	pthread_mutex_lock(&zlog_mapfiles_mutex);
+	if (a_mapfile->prev) a_mapfile->prev->next = a_mapfile->next;
+	else if (zlog_mapfiles == a_mapfile) zlog_mapfiles = a_mapfile->next;
+	if (a_mapfile->next) a_mapfile->next->prev = a_mapfile->prev;
+	pthread_mutex_unlock(&zlog_mapfiles_mutex);
+
+	pthread_mutex_lock(&(a_mapfile->lock_mutex));
+	zlog_mapfile_quiesce(a_mapfile);
+	if (a_mapfile->fd >= 0 && a_mapfile->gen == a_mapfile->shared->gen
+		&& a_mapfile->shared->opened) {
+		zlog_mapfile_trim(a_mapfile);
+	}
+	zlog_mapfile_release(a_mapfile);
+	zlog_mapfile_unmap(a_mapfile);
+	pthread_mutex_unlock(&(a_mapfile->lock_mutex));
+
+	if (munmap(a_mapfile->shared, sizeof(zlog_mapfile_shared_t))) {
+		zc_error("munmap fail, errno[%d]", errno);
+	}
+	pthread_mutex_destroy(&(a_mapfile->extend_mutex));
+	pthread_mutex_destroy(&(a_mapfile->lock_mutex));
+	free(a_mapfile);
+	zc_debug("zlog_mapfile_del[%p]", a_mapfile);
+	return;
+}
+
+/* the file is opened at the first write, by then an old conf
+ * which maps the same file is gone, see zlog_reload()
+ */
+zlog_mapfile_t *zlog_mapfile_new(const char *path, int flags, unsigned int perms,
+		size_t chunk, long limit)
+{
+	int fd;
+	zlog_mapfile_t *a_mapfile;
+
+	zc_assert(path, NULL);
+
+	pthread_once(&zlog_mapfile_once, zlog_mapfile_atfork);
+
+	/* make sure it can be opened, as other file rules do */
+	fd = open(path, O_RDWR | O_CREAT | flags, perms);
+	if (fd < 0) {
+		zc_error("open file[%s] fail, errno[%d]", path, errno);
+		return NULL;
+	}
+	close(fd);
+
+	a_mapfile = calloc(1, sizeof(zlog_mapfile_t));
+	if (!a_mapfile) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	/* kept by fork, zeroed */
+	a_mapfile->shared = mmap(NULL, sizeof(zlog_mapfile_shared_t), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (a_mapfile->shared == MAP_FAILED) {
+		zc_error("mmap fail, errno[%d]", errno);
+		free(a_mapfile);
+		return NULL;
+	}
+
+	snprintf(a_mapfile->path, sizeof(a_mapfile->path), "%s", path);
+	a_mapfile->flags = flags;
+	a_mapfile->perms = perms;
+	a_mapfile->chunk = chunk;
+	if (a_mapfile->chunk > (size_t)ZLOG_MAPFILE_WINDOW / 4) {
+		a_mapfile->chunk = ZLOG_MAPFILE_WINDOW / 4;
+	}
+	a_mapfile->limit = limit;
+	a_mapfile->fd = -1;
+
+	if (pthread_mutex_init(&(a_mapfile->lock_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		munmap(a_mapfile->shared, sizeof(zlog_mapfile_shared_t));
+		free(a_mapfile);
+		return NULL;
+	}
+	if (pthread_mutex_init(&(a_mapfile->extend_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		pthread_mutex_destroy(&(a_mapfile->lock_mutex));
+		munmap(a_mapfile->shared, sizeof(zlog_mapfile_shared_t));
+		free(a_mapfile);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&zlog_mapfiles_mutex);
+	a_mapfile->next = zlog_mapfiles;
+	if (zlog_mapfiles) zlog_mapfiles->prev = a_mapfile;
+	zlog_mapfiles = a_mapfile;
+	pthread_mutex_unlock(&zlog_mapfiles_mutex);
+
+	zlog_mapfile_profile(a_mapfile, ZC_DEBUG);
+	return a_mapfile;
+}
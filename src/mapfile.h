@@ -0,0 +1,78 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_mapfile_h
+#define __zlog_mapfile_h
+
+/* mapfile, is a log file appended through a shared memory mapping.
+ * a writer reserves its range by an atomic add on the offset and copies
+ * the line into the mapping, no syscall and no lock, the kernel writes
+ * the pages back. the file is extended a chunk at a time ahead of the
+ * offset, and truncated to the real length on close.
+ * the offset and the rest a writer looks at are in an anonymous shared
+ * page, so a forked child goes on appending to the same file, in step
+ * with its parent. a process reloading the conf gets a page of its own.
+ */
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "zc_defs.h"
+
+typedef struct zlog_mapfile_shared_s {
+	off_t file_size;	/* extended to */
+	off_t offset;		/* end of reserved, atomic */
+	int inflight;		/* writers between reserve and copy done */
+	pid_t held;		/* process which opens, remaps or closes */
+	int gen;		/* bumped after closed for rotate */
+	int opened;		/* offset and file_size are of the file of gen */
+	int rotate_pending;
+	time_t rotate_after;	/* a skipped rotation is asked again then */
+} zlog_mapfile_shared_t;
+
+typedef struct zlog_mapfile_s {
+	char path[MAXLEN_PATH + 1];
+	int flags;
+	unsigned int perms;
+	size_t chunk;		/* file is extended by chunk */
+	long limit;		/* ask for rotate when passed, 0 never */
+
+	zlog_mapfile_shared_t *shared;
+
+	pthread_mutex_t lock_mutex;	/* open, remap and close */
+	pthread_mutex_t extend_mutex;
+	int fd;
+	char *base;		/* NULL when closed */
+	off_t map_start;	/* file offset of base */
+	int gen;		/* fd and base are of the file of gen */
+	int closed;		/* suspend closed the file, gen goes on */
+
+	size_t overflows;	/* lines beyond the window, by pwrite */
+
+	struct zlog_mapfile_s *prev;	/* all mapfiles, see zlog_mapfile_child */
+	struct zlog_mapfile_s *next;
+} zlog_mapfile_t;
+
+zlog_mapfile_t *zlog_mapfile_new(const char *path, int flags, unsigned int perms,
+		size_t chunk, long limit);
+void zlog_mapfile_del(zlog_mapfile_t * a_mapfile);
+void zlog_mapfile_profile(zlog_mapfile_t * a_mapfile, int flag);
+
+/* return 1 the offset passed limit, caller should rotate
+ * return 0 success, -1 fail
+ */
+int zlog_mapfile_write(zlog_mapfile_t * a_mapfile, const char *data, size_t len);
+
+/* wait for writers, truncate and close the file, writers wait until resume.
+ * the next write opens the file again, maybe a new one after rotate
+ */
+void zlog_mapfile_suspend(zlog_mapfile_t * a_mapfile);
+void zlog_mapfile_resume(zlog_mapfile_t * a_mapfile);
+
+#endif
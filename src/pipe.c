@@ -0,0 +1,299 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "zc_defs.h"
+#include "pipe.h"
+
+/* iovecs of one writev */
+#define ZLOG_PIPE_IOV 1024
+
+void zlog_pipe_profile(zlog_pipe_t * a_pipe, int flag)
+{
+	zc_assert(a_pipe,);
+	zc_profile(flag, "--pipe[%p][%s][%ld][%d,%ld][%ld,%ld,%ld]--",
+		a_pipe,
+		a_pipe->command,
+		a_pipe->wait_ms,
+		a_pipe->fd,
+		(long)a_pipe->child,
+		(long)a_pipe->written,
+		(long)a_pipe->restarts,
+		(long)a_pipe->lost);
+	if (a_pipe->spool) zlog_spool_profile(a_pipe->spool, flag);
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_pipe_reap(zlog_pipe_t * a_pipe)
+{
+	if (a_pipe->zombie && waitpid(a_pipe->zombie, NULL, WNOHANG) != 0) {
+		a_pipe->zombie = 0;
+	}
+	return;
+}
+
+/* sh -c command, reading lines from its stdin */
+static int zlog_pipe_spawn(zlog_pipe_t * a_pipe)
+{
+	int fds[2];
+	pid_t pid;
+
+	zlog_pipe_reap(a_pipe);
+
+	/* a fork of another thread in between must not keep the write end,
+	 * or the child never sees EOF
+	 */
+#ifdef __linux__
+	if (pipe2(fds, O_CLOEXEC)) {
+		zc_error("pipe2 fail, errno[%d]", errno);
+		return -1;
+	}
+#else
+	if (pipe(fds)) {
+		zc_error("pipe fail, errno[%d]", errno);
+		return -1;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+	pid = fork();
+	if (pid < 0) {
+		zc_error("fork fail, errno[%d]", errno);
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	if (pid == 0) {
+		/* the drainer blocks all signals, the child should not */
+		sigprocmask(SIG_SETMASK, &(a_pipe->sigmask), NULL);
+		if (fds[0] != STDIN_FILENO) {
+			/* the copy is not close-on-exec */
+			dup2(fds[0], STDIN_FILENO);
+			close(fds[0]);
+		} else {
+			fcntl(fds[0], F_SETFD, 0);
+		}
+		close(fds[1]);
+		execl("/bin/sh", "sh", "-c", a_pipe->command, (char *)NULL);
+		_exit(127);
+	}
+
+	close(fds[0]);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	a_pipe->fd = fds[1];
+	a_pipe->child = pid;
+	return 0;
+}
+
+static void zlog_pipe_close(zlog_pipe_t * a_pipe)
+{
+	if (a_pipe->fd >= 0) close(a_pipe->fd);
+	a_pipe->fd = -1;
+	a_pipe->zombie = a_pipe->child;
+	a_pipe->child = 0;
+	zlog_pipe_reap(a_pipe);
+	return;
+}
+
+/* a child exits at once again and again, start it once a second at most */
+static int zlog_pipe_restart(zlog_pipe_t * a_pipe)
+{
+	time_t now;
+
+	now = time(NULL);
+	if (now < a_pipe->restart_at) return -1;
+	a_pipe->restart_at = now + 1;
+
+	if (zlog_pipe_spawn(a_pipe)) {
+		zc_error("zlog_pipe_spawn [%s] fail", a_pipe->command);
+		return -1;
+	}
+	a_pipe->restarts++;
+	zc_warn("child of [%s] restarted, pid[%ld]", a_pipe->command, (long)a_pipe->child);
+	return 0;
+}
+
+/*******************************************************************************/
+static void zlog_pipe_writev(zlog_pipe_t * a_pipe, struct iovec *iov, int count)
+{
+	int i = 0;
+	int cut = 0;
+	ssize_t rc;
+	struct pollfd pfd;
+
+	while (i < count) {
+		if (a_pipe->fd < 0 && zlog_pipe_restart(a_pipe)) break;
+
+		rc = writev(a_pipe->fd, iov + i, count - i);
+		if (rc >= 0) {
+			a_pipe->written += rc;
+			for (; i < count && (size_t)rc >= iov[i].iov_len; i++) {
+				rc -= iov[i].iov_len;
+				cut = 0;
+			}
+			if (rc > 0) {
+				iov[i].iov_base = (char *)iov[i].iov_base + rc;
+				iov[i].iov_len -= rc;
+				cut = 1;
+			}
+			continue;
+		}
+
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			pfd.fd = a_pipe->fd;
+			pfd.events = POLLOUT;
+			if (poll(&pfd, 1, 1000) == 0
+				&& __atomic_load_n(&(a_pipe->worker->stop), __ATOMIC_SEQ_CST)) {
+				/* stuck child, do not hold zlog_fini() forever */
+				zc_warn("child of [%s] reads nothing, give up", a_pipe->command);
+				break;
+			}
+			continue;
+		}
+
+		/* EPIPE, the child is gone */
+		zc_warn("write to [%s] fail, errno[%d]", a_pipe->command, errno);
+		zlog_pipe_close(a_pipe);
+		if (cut) {
+			/* the rest of a cut line makes no sense to a new child */
+			a_pipe->lost++;
+			cut = 0;
+			i++;
+		}
+	}
+
+	a_pipe->lost += count - i;
+	return;
+}
+
+static void zlog_pipe_run(void *arg)
+{
+	int n;
+	char *batch;
+	size_t len;
+	zlog_spool_rec_t *a_rec;
+	struct iovec iov[ZLOG_PIPE_IOV];
+	zlog_pipe_t *a_pipe = arg;
+
+	while ((batch = zlog_spool_take(a_pipe->spool, &len))) {
+		n = 0;
+		zlog_spool_foreach(batch, len, a_rec) {
+			iov[n].iov_base = a_rec->data;
+			iov[n].iov_len = a_rec->len;
+			if (++n == ZLOG_PIPE_IOV) {
+				zlog_pipe_writev(a_pipe, iov, n);
+				n = 0;
+			}
+		}
+		if (n) zlog_pipe_writev(a_pipe, iov, n);
+		zlog_spool_done(a_pipe->spool);
+	}
+	return;
+}
+
+/*******************************************************************************/
+int zlog_pipe_write(zlog_pipe_t * a_pipe, const char *buf, size_t len)
+{
+	int rc;
+
+	/* before the put, a forked child has no writer thread yet */
+	if (zlog_worker_start(a_pipe->worker)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+	rc = zlog_spool_put(a_pipe->spool, a_pipe, buf, len, a_pipe->wait_ms);
+	if (rc == 1) {
+		zlog_worker_kick(a_pipe->worker);
+	} else if (rc < 0 && zlog_spool_rec_size(len) > a_pipe->spool->size) {
+		zc_error("zlog_spool_put fail");
+		return -1;
+	}
+	return 0;
+}
+
+/*******************************************************************************/
+void zlog_pipe_del(zlog_pipe_t * a_pipe)
+{
+	zc_assert(a_pipe,);
+
+	/* drainer writes the rest before it stops */
+	if (a_pipe->worker) zlog_worker_del(a_pipe->worker);
+	if (a_pipe->spool) zlog_spool_del(a_pipe->spool);
+
+	/* as pclose(), wait for the child to finish its input */
+	if (a_pipe->fd >= 0) close(a_pipe->fd);
+	if (a_pipe->child) waitpid(a_pipe->child, NULL, 0);
+	zlog_pipe_reap(a_pipe);
+
+	free(a_pipe);
+	zc_debug("zlog_pipe_del[%p]", a_pipe);
+	return;
+}
+
+zlog_pipe_t *zlog_pipe_new(const char *command, size_t spool_size, long wait_ms)
+{
+	zlog_pipe_t *a_pipe;
+
+	zc_assert(command, NULL);
+
+	a_pipe = calloc(1, sizeof(zlog_pipe_t));
+	if (!a_pipe) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_pipe->fd = -1;
+	a_pipe->wait_ms = wait_ms;
+	if (strlen(command) > sizeof(a_pipe->command) - 1) {
+		zc_error("command[%s] too long", command);
+		goto err;
+	}
+	strcpy(a_pipe->command, command);
+	pthread_sigmask(SIG_SETMASK, NULL, &(a_pipe->sigmask));
+
+	if (zlog_pipe_spawn(a_pipe)) {
+		zc_error("zlog_pipe_spawn [%s] fail", command);
+		goto err;
+	}
+
+	a_pipe->spool = zlog_spool_new(spool_size);
+	if (!a_pipe->spool) {
+		zc_error("zlog_spool_new fail");
+		goto err;
+	}
+
+	/* thread is not started until the first line */
+	a_pipe->worker = zlog_worker_new("pipe", 0, 0, zlog_pipe_run, a_pipe);
+	if (!a_pipe->worker) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
+	zlog_pipe_profile(a_pipe, ZC_DEBUG);
+	return a_pipe;
+err:
+	zlog_pipe_del(a_pipe);
+	return NULL;
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_pipe_h
+#define __zlog_pipe_h
+
+/* pipe, is the output of rules like
+ *	my_cat.*	| /usr/bin/cronolog /www/logs/example_%Y%m%d.log
+ * writers copy lines into a bounded spool and never touch the pipe,
+ * a drainer thread writes them to the child, O_NONBLOCK, many at once.
+ * when the spool is full, a writer waits up to [global] pipe full wait,
+ * then drops the line. a child that exits is started again.
+ */
+
+#include <sys/types.h>
+#include <signal.h>
+#include <time.h>
+
+#include "zc_defs.h"
+#include "spool.h"
+#include "worker.h"
+
+typedef struct zlog_pipe_s {
+	char command[MAXLEN_CFG_LINE + 1];
+	sigset_t sigmask;	/* of the thread the rule is made in, for the child */
+	long wait_ms;		/* < 0 wait until room, 0 drop at once */
+
+	zlog_spool_t *spool;
+	zlog_worker_t *worker;
+
+	/* only used by drainer after new */
+	int fd;
+	pid_t child;
+	pid_t zombie;		/* exited child not reaped yet */
+	time_t restart_at;
+
+	size_t written;
+	size_t restarts;
+	size_t lost;		/* lines cut or thrown away by drainer */
+} zlog_pipe_t;
+
+zlog_pipe_t *zlog_pipe_new(const char *command, size_t spool_size, long wait_ms);
+void zlog_pipe_del(zlog_pipe_t * a_pipe);
+void zlog_pipe_profile(zlog_pipe_t * a_pipe, int flag);
+
+/* return 0 queued or dropped, -1 fail */
+int zlog_pipe_write(zlog_pipe_t * a_pipe, const char *buf, size_t len);
+
+#endif
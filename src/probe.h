@@ -0,0 +1,48 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_probe_h
+#define __zlog_probe_h
+
+/* static probes for perf and bpftrace, built in by make USDT=1,
+ * which needs sys/sdt.h of systemtap. a probe is a nop until attached,
+ * without USDT=1 it is nothing.
+ *
+ *	entry(file, line, level)		vzlog() and others, before level check
+ *	level__pass(file, line, level)		level of category is on
+ *	format__done(buf, len)			after zlog_format_gen_msg()
+ *	rule__start(rule) / rule__done(rule, rc)	output of a rule
+ *	write__start(rule, fd, len) / write__done(rule, fd, rc)	write() of a rule
+ *	rotate__start(path) / rotate__done(path, rc)
+ *	reload__start() / reload__done(rc)
+ *
+ * rule is "selector output" of the rule, like "my_cat.* "aa.log"", e.g.
+ *	bpftrace -e 'usdt:./libzlog.so:zlog:write__start { @s[tid] = nsecs; }
+ *		usdt:./libzlog.so:zlog:write__done /@s[tid]/ {
+ *		@[str(arg0)] = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+ */
+
+#ifdef ZLOG_USDT
+
+#include <sys/sdt.h>
+
+#define ZLOG_PROBE(name) DTRACE_PROBE(zlog, name)
+#define ZLOG_PROBE1(name, a1) DTRACE_PROBE1(zlog, name, a1)
+#define ZLOG_PROBE2(name, a1, a2) DTRACE_PROBE2(zlog, name, a1, a2)
+#define ZLOG_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(zlog, name, a1, a2, a3)
+
+#else
+
+#define ZLOG_PROBE(name)
+#define ZLOG_PROBE1(name, a1)
+#define ZLOG_PROBE2(name, a1, a2)
+#define ZLOG_PROBE3(name, a1, a2, a3)
+
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "process.h"
+#include "zc_defs.h"
+
+zlog_process_t zlog_env_process;
+
+static pthread_once_t zlog_process_once = PTHREAD_ONCE_INIT;
+
+static void zlog_process_set_pid(void)
+{
+	zlog_env_process.pid = getpid();
+	zlog_env_process.pid_str_len = sprintf(zlog_env_process.pid_str,
+					"%u", zlog_env_process.pid);
+	return;
+}
+
+static void zlog_process_atfork(void)
+{
+	pthread_atfork(NULL, NULL, zlog_process_set_pid);
+}
+
+void zlog_process_profile(int flag)
+{
+	zc_profile(flag, "---process[%s][%s]---",
+		zlog_env_process.pid_str, zlog_env_process.host_name);
+	return;
+}
+
+/* u don't always change your hostname, eh? a reload gets it again */
+int zlog_process_update(void)
+{
+	char host_name[sizeof(zlog_env_process.host_name)];
+
+	pthread_once(&zlog_process_once, zlog_process_atfork);
+
+	zlog_process_set_pid();
+	memset(host_name, 0x00, sizeof(host_name));
+	if (gethostname(host_name, sizeof(host_name) - 1)) {
+		zc_error("gethostname fail, errno[%d]", errno);
+		return -1;
+	}
+	strcpy(zlog_env_process.host_name, host_name);
+	zlog_env_process.host_name_len = strlen(host_name);
+	return 0;
+}
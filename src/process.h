@@ -0,0 +1,34 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_process_h
+#define __zlog_process_h
+
+/* what all threads of the process log the same, %H and %p.
+ * made at init, hostname again at reload, pid again in a child after fork.
+ * written under the wrlock of zlog_env_lock or in a child with one thread,
+ * read by specs under the rdlock.
+ */
+
+#include <sys/types.h>	/* for pid_t */
+
+typedef struct zlog_process_s {
+	pid_t pid;
+	char pid_str[30 + 1];
+	size_t pid_str_len;
+
+	char host_name[256 + 1];
+	size_t host_name_len;
+} zlog_process_t;
+
+extern zlog_process_t zlog_env_process;
+
+int zlog_process_update(void);
+void zlog_process_profile(int flag);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <time.h>
+
+#include "zlog.h"
+
+/* GCRA, the bucket is one time, so a CAS is all the lock it needs:
+ * a line may come burst - 1 intervals earlier than the rate says
+ */
+int zlog_ratelimit(zlog_ratelimit_t *rl, double per_sec, long burst, unsigned long *suppressed)
+{
+	long long now;
+	long long tat;
+	long long new_tat;
+	long long interval;
+	long long tau;
+	struct timespec ts;
+
+	*suppressed = 0;
+	if (per_sec <= 0) {
+		__sync_fetch_and_add(&(rl->suppressed), 1);
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	interval = (long long)(1000000000.0 / per_sec);
+	if (interval < 1) interval = 1;
+	tau = (burst > 1 ? burst - 1 : 0) * interval;
+
+	tat = __atomic_load_n(&(rl->tat), __ATOMIC_SEQ_CST);
+	do {
+		if (tat > now + tau) {
+			__sync_fetch_and_add(&(rl->suppressed), 1);
+			return 0;
+		}
+		new_tat = (tat > now ? tat : now) + interval;
+	} while (!__atomic_compare_exchange_n(&(rl->tat), &tat, new_tat, 0,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+	*suppressed = __atomic_exchange_n(&(rl->suppressed), 0, __ATOMIC_SEQ_CST);
+	return 1;
+}
+
+int zlog_sample(zlog_ratelimit_t *rl, unsigned long n)
+{
+	if (n <= 1) return 1;
+	return __sync_fetch_and_add(&(rl->count), 1) % n == 0;
+}
@@ -6,19 +6,33 @@
  * Licensed under the LGPL v2.1, see the file COPYING in base directory.
  */
 #include "errno.h"
+#include <sys/uio.h>
 #include "zc_defs.h"
 #include "record.h"
 
+/* msgs of one call to output_batch */
+#define ZLOG_RECORD_BATCH 256
+
+typedef struct zlog_record_line_s {
+	size_t len;
+	size_t path_len;
+} zlog_record_line_t;
+
 void zlog_record_profile(zlog_record_t *a_record, int flag)
 {
 	zc_assert(a_record,);
-	zc_profile(flag, "--record:[%p][%s:%p]--", a_record, a_record->name,  a_record->output);
+	zc_profile(flag, "--record:[%p][%s:%p:%p][%ld,%ld]--", a_record, a_record->name,
+		a_record->output, a_record->output_batch,
+		(long)a_record->batches, (long)a_record->fails);
 	return;
 }
 
 void zlog_record_del(zlog_record_t *a_record)
 {
 	zc_assert(a_record,);
+	/* dispatcher calls output_batch for the rest before it stops */
+	if (a_record->dispatcher) zlog_worker_del(a_record->dispatcher);
+	if (a_record->spool) zlog_spool_del(a_record->spool);
 	free(a_record);
 	zc_debug("zlog_record_del[%p]", a_record);
 	return;
@@ -51,3 +65,123 @@ err:
 	zlog_record_del(a_record);
 	return NULL;
 }
+
+/*******************************************************************************/
+static void zlog_record_call(zlog_record_t *a_record, zlog_msg_t *msgs, size_t count)
+{
+	a_record->batches++;
+	if (a_record->output_batch(msgs, count)) {
+		a_record->fails++;
+		zc_error("record batch [%s] fail, %ld msgs", a_record->name, (long)count);
+	}
+	return;
+}
+
+static void zlog_record_dispatch(void *arg)
+{
+	char *batch;
+	size_t len;
+	size_t n;
+	zlog_spool_rec_t *a_rec;
+	zlog_record_line_t *a_line;
+	zlog_msg_t msgs[ZLOG_RECORD_BATCH];
+	zlog_record_t *a_record = arg;
+
+	while ((batch = zlog_spool_take(a_record->spool, &len))) {
+		n = 0;
+		zlog_spool_foreach(batch, len, a_rec) {
+			a_line = (zlog_record_line_t *)a_rec->data;
+			msgs[n].buf = a_rec->data + sizeof(zlog_record_line_t);
+			msgs[n].len = a_line->len;
+			msgs[n].path = msgs[n].buf + a_line->len + 1;
+			if (++n == ZLOG_RECORD_BATCH) {
+				zlog_record_call(a_record, msgs, n);
+				n = 0;
+			}
+		}
+		if (n) zlog_record_call(a_record, msgs, n);
+		/* the batch buffer is reused from now on */
+		zlog_spool_done(a_record->spool);
+	}
+	return;
+}
+
+zlog_record_t *zlog_record_new_batch(const char *name, zlog_record_batch_fn output_batch,
+		size_t spool_size)
+{
+	zlog_record_t *a_record;
+
+	zc_assert(name, NULL);
+	zc_assert(output_batch, NULL);
+
+	a_record = calloc(1, sizeof(zlog_record_t));
+	if (!a_record) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	if (strlen(name) > sizeof(a_record->name) - 1) {
+		zc_error("name[%s] is too long", name);
+		goto err;
+	}
+
+	strcpy(a_record->name, name);
+	a_record->output_batch = output_batch;
+
+	a_record->spool = zlog_spool_new(spool_size);
+	if (!a_record->spool) {
+		zc_error("zlog_spool_new fail");
+		goto err;
+	}
+
+	/* thread is not started until the first msg */
+	a_record->dispatcher = zlog_worker_new(name, 0, 0, zlog_record_dispatch, a_record);
+	if (!a_record->dispatcher) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
+	zlog_record_profile(a_record, ZC_DEBUG);
+	return a_record;
+err:
+	zlog_record_del(a_record);
+	return NULL;
+}
+
+/*******************************************************************************/
+int zlog_record_output(zlog_record_t *a_record, zlog_msg_t *msg)
+{
+	int rc;
+	zlog_record_line_t a_line;
+	struct iovec iov[5];
+
+	if (!a_record->output_batch) return a_record->output(msg);
+
+	a_line.len = msg->len;
+	a_line.path_len = strlen(msg->path);
+	iov[0].iov_base = &a_line;
+	iov[0].iov_len = sizeof(a_line);
+	iov[1].iov_base = msg->buf;
+	iov[1].iov_len = msg->len;
+	iov[2].iov_base = "";
+	iov[2].iov_len = 1;
+	iov[3].iov_base = msg->path;
+	iov[3].iov_len = a_line.path_len;
+	iov[4].iov_base = "";
+	iov[4].iov_len = 1;
+
+	/* before the put, a forked child has no dispatcher yet */
+	if (zlog_worker_start(a_record->dispatcher)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+	/* wait for room, output of a record never loses a msg */
+	rc = zlog_spool_putv(a_record->spool, a_record, iov, 5, -1);
+	if (rc < 0) {
+		zc_error("zlog_spool_putv fail");
+		return -1;
+	} else if (rc == 1) {
+		zlog_worker_kick(a_record->dispatcher);
+	}
+	return 0;
+}
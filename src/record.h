@@ -10,6 +10,8 @@
 #define __zlog_record_h
 
 #include "zc_defs.h"
+#include "spool.h"
+#include "worker.h"
 
 /* record is user-defined output function and it's name from configure file */
 typedef struct zlog_msg_s {
@@ -20,13 +22,31 @@ typedef struct zlog_msg_s {
 
 typedef int (*zlog_record_fn)(zlog_msg_t * msg);
 
+/* a batch record is called by a dispatcher thread with msgs in order,
+ * msgs and what they point to are valid until it returns
+ */
+typedef int (*zlog_record_batch_fn)(zlog_msg_t * msgs, size_t count);
+
+#define ZLOG_RECORD_SPOOL_SIZE (1024 * 1024)
+
 typedef struct zlog_record_s {
 	char name[MAXLEN_PATH + 1];
 	zlog_record_fn output;
+
+	zlog_record_batch_fn output_batch;
+	zlog_spool_t *spool;
+	zlog_worker_t *dispatcher;
+	size_t batches;
+	size_t fails;
 } zlog_record_t;
 
 zlog_record_t *zlog_record_new(const char *name, zlog_record_fn output);
+zlog_record_t *zlog_record_new_batch(const char *name, zlog_record_batch_fn output_batch,
+		size_t spool_size);
 void zlog_record_del(zlog_record_t *a_record);
 void zlog_record_profile(zlog_record_t *a_record, int flag);
 
+/* call output, or queue msg for output_batch */
+int zlog_record_output(zlog_record_t *a_record, zlog_msg_t *msg);
+
 #endif
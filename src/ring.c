@@ -0,0 +1,425 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "zc_defs.h"
+#include "ring.h"
+
+#ifndef NSIG
+#define NSIG 65
+#endif
+
+/* yields for a line being copied in when dumping */
+#define ZLOG_RING_WAIT 1000
+
+/* a signal handler only counts, a worker of each ring does the dump */
+static pthread_mutex_t zlog_ring_signal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t zlog_ring_signals[NSIG];
+static int zlog_ring_signal_refs[NSIG];
+static struct sigaction zlog_ring_signal_old[NSIG];
+
+void zlog_ring_profile(zlog_ring_t * a_ring, int flag)
+{
+	zc_assert(a_ring,);
+	zc_profile(flag, "--ring[%p][%s][%ld:%ld,%ld][%s,%d][%ld,%ld]--",
+		a_ring,
+		a_ring->file,
+		(long)a_ring->shared->size,
+		(long)a_ring->shared->head,
+		(long)a_ring->too_long,
+		a_ring->path,
+		a_ring->signo,
+		(long)a_ring->shared->dumped,
+		(long)a_ring->dumps);
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_ring_signal_handler(int signo)
+{
+	zlog_ring_signals[signo]++;
+	return;
+}
+
+static int zlog_ring_signal_ref(int signo)
+{
+	int rc = 0;
+	struct sigaction sa;
+
+	pthread_mutex_lock(&zlog_ring_signal_mutex);
+	if (zlog_ring_signal_refs[signo] == 0) {
+		memset(&sa, 0x00, sizeof(sa));
+		sa.sa_handler = zlog_ring_signal_handler;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		rc = sigaction(signo, &sa, &zlog_ring_signal_old[signo]);
+		if (rc) zc_error("sigaction [%d] fail, errno[%d]", signo, errno);
+	}
+	if (rc == 0) zlog_ring_signal_refs[signo]++;
+	pthread_mutex_unlock(&zlog_ring_signal_mutex);
+	return rc;
+}
+
+/* rings of the old and new conf share the handler in zlog_reload() */
+static void zlog_ring_signal_unref(int signo)
+{
+	pthread_mutex_lock(&zlog_ring_signal_mutex);
+	if (--zlog_ring_signal_refs[signo] == 0) {
+		sigaction(signo, &zlog_ring_signal_old[signo], NULL);
+	}
+	pthread_mutex_unlock(&zlog_ring_signal_mutex);
+	return;
+}
+
+static void zlog_ring_check(void *arg)
+{
+	int count;
+	zlog_ring_t *a_ring = arg;
+
+	count = zlog_ring_signals[a_ring->signo];
+	if (count != a_ring->signal_seen) {
+		a_ring->signal_seen = count;
+		if (zlog_ring_dump(a_ring, "signal")) {
+			zc_error("zlog_ring_dump fail");
+		}
+	}
+	return;
+}
+
+/*******************************************************************************/
+void zlog_ring_write(zlog_ring_t * a_ring, const char *buf, size_t len)
+{
+	uint64_t pos;
+	uint64_t total;
+	uint64_t size = a_ring->shared->size;
+	size_t off;
+	size_t first;
+	zlog_ring_rec_t *a_rec;
+
+	total = zlog_ring_rec_size(len);
+	if (total > size) {
+		__sync_fetch_and_add(&(a_ring->too_long), 1);
+		return;
+	}
+
+	/* lines are written after their room is taken */
+	pos = __atomic_fetch_add(&(a_ring->shared->head), total, __ATOMIC_ACQUIRE);
+	a_rec = (zlog_ring_rec_t *)(a_ring->lines + pos % size);
+	a_rec->len = len;
+	a_rec->reserved = 0;
+
+	off = (pos + sizeof(zlog_ring_rec_t)) % size;
+	first = size - off;
+	if (first > len) first = len;
+	memcpy(a_ring->lines + off, buf, first);
+	if (len > first) memcpy(a_ring->lines, buf + first, len - first);
+
+	__atomic_store_n(&(a_rec->stamp), pos + 1, __ATOMIC_RELEASE);
+	return;
+}
+
+/*******************************************************************************/
+int zlog_ring_check_head(zlog_ring_head_t * a_head, size_t avail)
+{
+	if (avail < sizeof(zlog_ring_head_t)) return -1;
+	if (memcmp(a_head->magic, ZLOG_RING_MAGIC, sizeof(a_head->magic))) return -1;
+	if (a_head->version != ZLOG_RING_VERSION) return -1;
+	if (a_head->head_size != sizeof(zlog_ring_head_t)) return -1;
+	if (a_head->size == 0 || a_head->size % 16) return -1;
+	if (a_head->size > avail - sizeof(zlog_ring_head_t)) return -1;
+	return 0;
+}
+
+/* a line is copied out, then the head is checked again,
+ * if writers went round and overwrote it, the walk goes on
+ * from the oldest pos still in the ring
+ */
+uint64_t zlog_ring_walk(zlog_ring_head_t * a_head, uint64_t from, int wait,
+		char **buf, size_t *buf_size, zlog_ring_fn fn, void *arg)
+{
+	int i;
+	int sync = 1;		/* pos is known to be a line */
+	char *lines = (char *)a_head + a_head->head_size;
+	char *p;
+	uint64_t size = a_head->size;
+	uint64_t to;
+	uint64_t head;
+	uint64_t pos;
+	uint64_t stamp;
+	size_t len;
+	size_t off;
+	size_t first;
+	zlog_ring_rec_t *a_rec;
+
+	to = __atomic_load_n(&(a_head->head), __ATOMIC_ACQUIRE);
+	pos = (from + 15) & ~(uint64_t)15;
+	while (pos < to) {
+		head = __atomic_load_n(&(a_head->head), __ATOMIC_ACQUIRE);
+		if (head - pos > size) {
+			pos = head - size;
+			sync = 0;
+			continue;
+		}
+
+		a_rec = (zlog_ring_rec_t *)(lines + pos % size);
+		stamp = __atomic_load_n(&(a_rec->stamp), __ATOMIC_ACQUIRE);
+		for (i = 0; sync && stamp != pos + 1 && i < wait; i++) {
+			sched_yield();
+			stamp = __atomic_load_n(&(a_rec->stamp), __ATOMIC_ACQUIRE);
+		}
+		if (stamp != pos + 1) {
+			/* a writer died before commit, look for the next line */
+			pos += 16;
+			sync = 0;
+			continue;
+		}
+
+		len = a_rec->len;
+		if (pos + zlog_ring_rec_size(len) > to) {
+			pos += 16;
+			sync = 0;
+			continue;
+		}
+		if (len > *buf_size) {
+			p = realloc(*buf, len);
+			if (!p) {
+				zc_error("realloc fail, errno[%d]", errno);
+				return pos;
+			}
+			*buf = p;
+			*buf_size = len;
+		}
+
+		off = (pos + sizeof(zlog_ring_rec_t)) % size;
+		first = size - off;
+		if (first > len) first = len;
+		memcpy(*buf, lines + off, first);
+		if (len > first) memcpy(*buf + first, lines, len - first);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&(a_head->head), __ATOMIC_ACQUIRE);
+		if (head - pos > size) continue;
+
+		if (fn(arg, *buf, len)) return pos;
+		pos += zlog_ring_rec_size(len);
+		sync = 1;
+	}
+	return pos;
+}
+
+static int zlog_ring_fwrite(void *arg, const char *line, size_t len)
+{
+	return fwrite(line, 1, len, (FILE *)arg) != len;
+}
+
+int zlog_ring_dump(zlog_ring_t * a_ring, const char *reason)
+{
+	int rc = 0;
+	FILE *fp;
+	uint64_t end;
+	time_t now;
+	struct tm tm;
+	char time_str[64];
+
+	pthread_mutex_lock(&(a_ring->dump_mutex));
+
+	if (__atomic_load_n(&(a_ring->shared->head), __ATOMIC_ACQUIRE)
+		== __atomic_load_n(&(a_ring->shared->dumped), __ATOMIC_ACQUIRE)) {
+		goto exit;
+	}
+
+	fp = fopen(a_ring->path, "a");
+	if (!fp) {
+		zc_error("fopen[%s] fail, errno[%d]", a_ring->path, errno);
+		rc = -1;
+		goto exit;
+	}
+
+	now = time(NULL);
+	localtime_r(&now, &tm);
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm);
+	fprintf(fp, "==== zlog ring dump, pid[%ld] reason[%s] %s ====\n",
+		(long)getpid(), reason, time_str);
+
+	end = zlog_ring_walk(a_ring->shared, a_ring->shared->dumped, ZLOG_RING_WAIT,
+		&(a_ring->line_buf), &(a_ring->line_size), zlog_ring_fwrite, fp);
+	__atomic_store_n(&(a_ring->shared->dumped), end, __ATOMIC_RELEASE);
+	a_ring->dumps++;
+
+	if (fclose(fp)) {
+		zc_error("fclose[%s] fail, errno[%d]", a_ring->path, errno);
+		rc = -1;
+	}
+exit:
+	pthread_mutex_unlock(&(a_ring->dump_mutex));
+	return rc;
+}
+
+/*******************************************************************************/
+static void zlog_ring_init_head(zlog_ring_head_t * a_head, size_t size)
+{
+	memset(a_head, 0x00, sizeof(zlog_ring_head_t));
+	a_head->version = ZLOG_RING_VERSION;
+	a_head->head_size = sizeof(zlog_ring_head_t);
+	a_head->size = size;
+	memcpy(a_head->magic, ZLOG_RING_MAGIC, sizeof(a_head->magic));
+	return;
+}
+
+/* a ring file of the same size is used on, lines of last run are kept */
+static int zlog_ring_map(zlog_ring_t * a_ring, size_t size)
+{
+	int fd;
+	void *base;
+	struct stat stb;
+
+	fd = open(a_ring->file, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		zc_error("open[%s] fail, errno[%d]", a_ring->file, errno);
+		return -1;
+	}
+	if (fstat(fd, &stb)) {
+		zc_error("fstat[%s] fail, errno[%d]", a_ring->file, errno);
+		goto err;
+	}
+
+	a_ring->map_size = sizeof(zlog_ring_head_t) + size;
+	if ((size_t)stb.st_size != a_ring->map_size
+		&& (ftruncate(fd, 0) || ftruncate(fd, a_ring->map_size))) {
+		zc_error("ftruncate[%s] fail, errno[%d]", a_ring->file, errno);
+		goto err;
+	}
+
+	base = mmap(NULL, a_ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		zc_error("mmap[%s] fail, errno[%d]", a_ring->file, errno);
+		goto err;
+	}
+	close(fd);
+
+	a_ring->shared = base;
+	if (zlog_ring_check_head(a_ring->shared, a_ring->map_size)
+		|| a_ring->shared->size != size) {
+		zlog_ring_init_head(a_ring->shared, size);
+	}
+	return 0;
+err:
+	close(fd);
+	return -1;
+}
+
+void zlog_ring_del(zlog_ring_t * a_ring)
+{
+	zc_assert(a_ring,);
+	if (a_ring->worker) zlog_worker_del(a_ring->worker);
+	if (a_ring->signo) zlog_ring_signal_unref(a_ring->signo);
+	if (a_ring->shared) {
+		if (a_ring->map_size) {
+			munmap(a_ring->shared, a_ring->map_size);
+		} else {
+			free(a_ring->shared);
+		}
+	}
+	if (a_ring->line_buf) free(a_ring->line_buf);
+	pthread_mutex_destroy(&(a_ring->dump_mutex));
+	free(a_ring);
+	zc_debug("zlog_ring_del[%p]", a_ring);
+	return;
+}
+
+zlog_ring_t *zlog_ring_new(size_t size, const char *path, int signo, const char *file)
+{
+	zlog_ring_t *a_ring;
+
+	zc_assert(path, NULL);
+
+	size &= ~(size_t)15;
+	if (size < 1024) {
+		zc_error("size of ring[%ld] is less than 1KB", (long)size);
+		return NULL;
+	}
+	if (signo < 0 || signo >= NSIG) {
+		zc_error("signal[%d] is wrong", signo);
+		return NULL;
+	}
+
+	a_ring = calloc(1, sizeof(zlog_ring_t));
+	if (!a_ring) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	pthread_mutex_init(&(a_ring->dump_mutex), NULL);
+
+	if (strlen(path) > sizeof(a_ring->path) - 1) {
+		zc_error("path[%s] is too long", path);
+		goto err;
+	}
+	strcpy(a_ring->path, path);
+
+	if (file && file[0] != '\0') {
+		if (strlen(file) > sizeof(a_ring->file) - 1) {
+			zc_error("file[%s] is too long", file);
+			goto err;
+		}
+		strcpy(a_ring->file, file);
+		if (zlog_ring_map(a_ring, size)) {
+			zc_error("zlog_ring_map fail");
+			goto err;
+		}
+	} else {
+		/* pages are not touched until lines come */
+		a_ring->shared = calloc(1, sizeof(zlog_ring_head_t) + size);
+		if (!a_ring->shared) {
+			zc_error("calloc fail, errno[%d]", errno);
+			goto err;
+		}
+		zlog_ring_init_head(a_ring->shared, size);
+	}
+	a_ring->shared->pid = getpid();
+	a_ring->lines = (char *)a_ring->shared + a_ring->shared->head_size;
+
+	if (signo) {
+		if (zlog_ring_signal_ref(signo)) {
+			zc_error("zlog_ring_signal_ref fail");
+			goto err;
+		}
+		a_ring->signo = signo;
+		a_ring->signal_seen = zlog_ring_signals[signo];
+
+		a_ring->worker = zlog_worker_new("ring", 200, 1, zlog_ring_check, a_ring);
+		if (!a_ring->worker) {
+			zc_error("zlog_worker_new fail");
+			goto err;
+		}
+		if (zlog_worker_start(a_ring->worker)) {
+			zc_error("zlog_worker_start fail");
+			goto err;
+		}
+	}
+
+	zlog_ring_profile(a_ring, ZC_DEBUG);
+	return a_ring;
+err:
+	zlog_ring_del(a_ring);
+	return NULL;
+}
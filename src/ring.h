@@ -0,0 +1,98 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_ring_h
+#define __zlog_ring_h
+
+/* ring, is the flight recorder, for rules like
+ *	*.DEBUG		$ring(64MB), "/tmp/my.ring.dump" dump_signal=SIGUSR2
+ * writers reserve room with one atomic add and copy the line in,
+ * the oldest lines are overwritten, nothing goes to disk.
+ * a line of dump_level or higher, zlog_dump_ring() or the signal
+ * appends lines not dumped yet to the dump file.
+ *
+ * with file=/dev/shm/my.ring, the ring is a shared mapping of the file,
+ * lines in it outlive a crash of the process, zlog-recover gets them out.
+ * a ring in memory is found by zlog-recover in a core file.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "worker.h"
+
+#define ZLOG_RING_MAGIC "zlogring"
+#define ZLOG_RING_VERSION 1
+
+/* at the start of the ring memory, or of the ring file */
+typedef struct zlog_ring_head_s {
+	char magic[8];
+	uint32_t version;
+	uint32_t head_size;	/* lines start here */
+	uint64_t size;		/* of lines, times of 16 */
+	uint64_t head;		/* bytes ever reserved, atomic */
+	uint64_t dumped;	/* lines before it are in the dump file */
+	int64_t pid;		/* last process using it */
+	char reserved[16];
+} zlog_ring_head_t;
+
+/* before each line, 16 bytes aligned.
+ * the line is committed when stamp is its pos + 1, stored last with release
+ */
+typedef struct zlog_ring_rec_s {
+	uint64_t stamp;
+	uint32_t len;
+	uint32_t reserved;
+} zlog_ring_rec_t;
+
+#define zlog_ring_rec_size(len) \
+	(sizeof(zlog_ring_rec_t) + (((uint64_t)(len) + 15) & ~(uint64_t)15))
+
+/* return non 0 to stop walking */
+typedef int (*zlog_ring_fn) (void *arg, const char *line, size_t len);
+
+typedef struct zlog_ring_s {
+	zlog_ring_head_t *shared;
+	char *lines;
+	char file[MAXLEN_PATH + 1];	/* empty means in memory */
+	size_t map_size;
+	size_t too_long;	/* lines longer than the ring, dropped */
+
+	char path[MAXLEN_PATH + 1];	/* dump file */
+	pthread_mutex_t dump_mutex;
+	char *line_buf;
+	size_t line_size;
+	size_t dumps;
+
+	int signo;		/* 0 means none */
+	int signal_seen;
+	zlog_worker_t *worker;	/* dumps on signal, as a handler can not */
+} zlog_ring_t;
+
+/* file	NULL or "" for a ring in memory */
+zlog_ring_t *zlog_ring_new(size_t size, const char *path, int signo, const char *file);
+void zlog_ring_del(zlog_ring_t * a_ring);
+void zlog_ring_profile(zlog_ring_t * a_ring, int flag);
+
+void zlog_ring_write(zlog_ring_t * a_ring, const char *buf, size_t len);
+/* return 0 dumped or nothing to dump, -1 fail */
+int zlog_ring_dump(zlog_ring_t * a_ring, const char *reason);
+
+/* for zlog-recover too */
+int zlog_ring_check_head(zlog_ring_head_t * a_head, size_t avail);
+/* call fn with each committed line from pos [from] to the head,
+ * wait is how many times to yield for a line being copied in.
+ * return the pos walked to
+ */
+uint64_t zlog_ring_walk(zlog_ring_head_t * a_head, uint64_t from, int wait,
+		char **buf, size_t *buf_size, zlog_ring_fn fn, void *arg);
+
+#endif
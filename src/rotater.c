@@ -6,11 +6,14 @@
  * Licensed under the LGPL v2.1, see the file COPYING in base directory.
  */
 
+#include "fmacros.h"
+
 #include <string.h>
 #include <glob.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -20,15 +23,35 @@
 
 #include "zc_defs.h"
 #include "rotater.h"
+#include "probe.h"
 
 #define ROLLING  1     /* aa.02->aa.03, aa.01->aa.02, aa->aa.01 */
 #define SEQUENCE 2     /* aa->aa.03 */
 
+#define ZLOG_ROTATER_JANITOR_PERIOD (60 * 1000)
+
 typedef struct {
 	int index;
 	char path[MAXLEN_PATH + 1];
 } zlog_file_t;
 
+typedef struct {
+	char base_path[MAXLEN_PATH + 1];
+	char glob_path[MAXLEN_PATH + 1];
+	long max_bytes;
+	long max_age;
+} zlog_archive_t;
+
+typedef struct {
+	char path[MAXLEN_PATH + 1];
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_nsec;
+} zlog_archive_file_t;
+
+static void zlog_rotater_janitor(void *arg);
+
 void zlog_rotater_profile(zlog_rotater_t * a_rotater, int flag)
 {
 	zc_assert(a_rotater,);
@@ -48,6 +71,17 @@ void zlog_rotater_profile(zlog_rotater_t * a_rotater, int flag)
 		a_rotater->mv_type,
 		a_rotater->max_count
 		);
+	zc_profile(flag, "--janitor reclaimed[%ld files,%ld bytes]--",
+		(long)a_rotater->reclaimed_files,
+		(long)a_rotater->reclaimed_bytes);
+	if (a_rotater->archives) {
+		int i;
+		zlog_archive_t *a_archive;
+		zc_arraylist_foreach(a_rotater->archives, i, a_archive) {
+			zc_profile(flag, "[%s,%ld,%ld]~>", a_archive->glob_path,
+				a_archive->max_bytes, a_archive->max_age);
+		}
+	}
 	if (a_rotater->files) {
 		int i;
 		zlog_file_t *a_file;
@@ -63,6 +97,10 @@ void zlog_rotater_del(zlog_rotater_t *a_rotater)
 {
 	zc_assert(a_rotater,);
 
+	/* janitor works under the lock, stop it first */
+	if (a_rotater->janitor) zlog_worker_del(a_rotater->janitor);
+	if (a_rotater->archives) zc_arraylist_del(a_rotater->archives);
+
 	if (a_rotater->lock_fd) {
 		if (close(a_rotater->lock_fd)) {
 			zc_error("close fail, errno[%d]", errno);
@@ -112,6 +150,20 @@ zlog_rotater_t *zlog_rotater_new(char *lock_file)
 	a_rotater->lock_fd = fd;
 	a_rotater->lock_file = lock_file;
 
+	a_rotater->archives = zc_arraylist_new(free);
+	if (!a_rotater->archives) {
+		zc_error("zc_arraylist_new fail");
+		goto err;
+	}
+
+	/* thread is not started until an archive with limits comes */
+	a_rotater->janitor = zlog_worker_new("janitor", ZLOG_ROTATER_JANITOR_PERIOD, 1,
+				zlog_rotater_janitor, a_rotater);
+	if (!a_rotater->janitor) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
 	//zlog_rotater_profile(a_rotater, ZC_DEBUG);
 	return a_rotater;
 err:
@@ -409,6 +461,233 @@ static int zlog_rotater_parse_archive_path(zlog_rotater_t * a_rotater)
 	return 0;
 }
 
+/*******************************************************************************/
+/* under the lock, called when rotate, as glob_path is known only then */
+static int zlog_rotater_index_archive(zlog_rotater_t *a_rotater,
+		long archive_max_bytes, long archive_max_age)
+{
+	int i;
+	zlog_archive_t *a_archive;
+
+	zc_arraylist_foreach(a_rotater->archives, i, a_archive) {
+		if (STRCMP(a_archive->glob_path, ==, a_rotater->glob_path)) {
+			a_archive->max_bytes = archive_max_bytes;
+			a_archive->max_age = archive_max_age;
+			goto kick;
+		}
+	}
+
+	a_archive = calloc(1, sizeof(zlog_archive_t));
+	if (!a_archive) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return -1;
+	}
+	snprintf(a_archive->base_path, sizeof(a_archive->base_path), "%s", a_rotater->base_path);
+	strcpy(a_archive->glob_path, a_rotater->glob_path);
+	a_archive->max_bytes = archive_max_bytes;
+	a_archive->max_age = archive_max_age;
+
+	if (zc_arraylist_add(a_rotater->archives, a_archive)) {
+		zc_error("zc_arraylist_add fail");
+		free(a_archive);
+		return -1;
+	}
+
+kick:
+	if (zlog_worker_start(a_rotater->janitor)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+	zlog_worker_kick(a_rotater->janitor);
+	return 0;
+}
+
+static int zlog_archive_file_cmp(zlog_archive_file_t * a_file_1, zlog_archive_file_t * a_file_2)
+{
+	if (a_file_1->mtime != a_file_2->mtime) return (a_file_1->mtime > a_file_2->mtime);
+	return (a_file_1->mtime_nsec > a_file_2->mtime_nsec);
+}
+
+/* no lock here, return 1 if there is no archive file left, so the index can forget it */
+static int zlog_rotater_scan_archive(zlog_archive_t *a_archive, zc_arraylist_t *files, long *total)
+{
+	int rc;
+	glob_t glob_buf;
+	size_t pathc;
+	char **pathv;
+	struct zlog_stat info;
+	zlog_archive_file_t *a_file;
+
+	rc = glob(a_archive->glob_path, GLOB_ERR | GLOB_MARK | GLOB_NOSORT, NULL, &glob_buf);
+	if (rc == GLOB_NOMATCH) {
+		return 1;
+	} else if (rc) {
+		zc_error("glob err, rc=[%d], errno[%d]", rc, errno);
+		return 0;
+	}
+
+	pathv = glob_buf.gl_pathv;
+	pathc = glob_buf.gl_pathc;
+	for (; pathc-- > 0; pathv++) {
+		if (STRCMP(a_archive->base_path, ==, *pathv)) continue;
+		if ((*pathv)[strlen(*pathv) - 1] == '/') continue;
+		if (zlog_stat(*pathv, &info)) continue;
+
+		a_file = calloc(1, sizeof(zlog_archive_file_t));
+		if (!a_file) {
+			zc_error("calloc fail, errno[%d]", errno);
+			break;
+		}
+		snprintf(a_file->path, sizeof(a_file->path), "%s", *pathv);
+		a_file->ino = info.st_ino;
+		a_file->size = info.st_size;
+		a_file->mtime = info.st_mtime;
+#ifdef __linux__
+		/* many files are rotated in one second */
+		a_file->mtime_nsec = info.st_mtim.tv_nsec;
+#endif
+
+		/* oldest first */
+		if (zc_arraylist_sortadd(files, (zc_arraylist_cmp_fn)zlog_archive_file_cmp, a_file)) {
+			zc_error("zc_arraylist_sortadd fail");
+			free(a_file);
+			break;
+		}
+		*total += a_file->size;
+	}
+	globfree(&glob_buf);
+	return 0;
+}
+
+/* under the lock, the file may be renamed by a rotation after scan,
+ * so only unlink it when it is still the same one.
+ * once one is not, total is stale, newer ones are left to the next round
+ */
+static void zlog_rotater_reclaim(zlog_rotater_t *a_rotater,
+		zlog_archive_t *a_archive, zc_arraylist_t *files, long total, time_t now)
+{
+	int i;
+	struct zlog_stat info;
+	zlog_archive_file_t *a_file;
+
+	zc_arraylist_foreach(files, i, a_file) {
+		if (!(a_archive->max_age > 0 && now - a_file->mtime > a_archive->max_age)
+			&& !(a_archive->max_bytes > 0 && total > a_archive->max_bytes)) {
+			/* the rest are newer and fit in the limit */
+			break;
+		}
+
+		if (zlog_stat(a_file->path, &info)
+			|| info.st_ino != a_file->ino
+			|| info.st_size != a_file->size) {
+			zc_debug("[%s] changed since scan, scan again next round", a_file->path);
+			break;
+		}
+
+		if (unlink(a_file->path)) {
+			zc_error("unlink[%s] fail, errno[%d]", a_file->path, errno);
+			break;
+		}
+		total -= a_file->size;
+		a_rotater->reclaimed_files++;
+		a_rotater->reclaimed_bytes += a_file->size;
+		zc_debug("janitor reclaim [%s], [%ld] bytes, total reclaimed [%ld] bytes",
+			a_file->path, (long)a_file->size, (long)a_rotater->reclaimed_bytes);
+	}
+	return;
+}
+
+static int zlog_rotater_trylock(zlog_rotater_t *a_rotater);
+static int zlog_rotater_unlock(zlog_rotater_t *a_rotater);
+
+/* the janitor is in the background, take the same lock as rotation,
+ * so it never races with a rotating thread or other process.
+ * glob and stat are done out of the lock, only unlink is under it,
+ * so writers, which only trylock, seldom skip a rotation and never wait.
+ */
+static void zlog_rotater_janitor(void *arg)
+{
+	int i;
+	int j;
+	int empty;
+	long total;
+	time_t now;
+	zlog_archive_t *a_archive;
+	zlog_archive_t *b_archive;
+	zlog_rotater_t *a_rotater = arg;
+	zc_arraylist_t *archives = NULL;
+	zc_arraylist_t *files = NULL;
+
+	archives = zc_arraylist_new(free);
+	if (!archives) {
+		zc_error("zc_arraylist_new fail");
+		return;
+	}
+
+	/* the index is changed by rotating threads, take a copy */
+	if (zlog_rotater_trylock(a_rotater)) {
+		zc_debug("janitor can not get the lock, try next round");
+		goto exit;
+	}
+	zc_arraylist_foreach(a_rotater->archives, i, a_archive) {
+		b_archive = malloc(sizeof(zlog_archive_t));
+		if (!b_archive) {
+			zc_error("malloc fail, errno[%d]", errno);
+			break;
+		}
+		memcpy(b_archive, a_archive, sizeof(zlog_archive_t));
+		if (zc_arraylist_add(archives, b_archive)) {
+			zc_error("zc_arraylist_add fail");
+			free(b_archive);
+			break;
+		}
+	}
+	if (zlog_rotater_unlock(a_rotater)) {
+		zc_error("zlog_rotater_unlock fail");
+	}
+
+	now = time(NULL);
+	zc_arraylist_foreach(archives, i, a_archive) {
+		files = zc_arraylist_new(free);
+		if (!files) {
+			zc_error("zc_arraylist_new fail");
+			goto exit;
+		}
+
+		total = 0;
+		empty = zlog_rotater_scan_archive(a_archive, files, &total);
+
+		if (zlog_rotater_trylock(a_rotater)) {
+			zc_debug("janitor can not get the lock, try next round");
+			goto exit;
+		}
+
+		zlog_rotater_reclaim(a_rotater, a_archive, files, total, now);
+
+		/* dynamic archive path of the past, eg. yesterday */
+		if (empty) {
+			for (j = zc_arraylist_len(a_rotater->archives) - 1; j > -1; j--) {
+				b_archive = zc_arraylist_get(a_rotater->archives, j);
+				if (STRCMP(b_archive->glob_path, ==, a_archive->glob_path)) {
+					zc_arraylist_remove_idx(a_rotater->archives, j);
+				}
+			}
+		}
+
+		if (zlog_rotater_unlock(a_rotater)) {
+			zc_error("zlog_rotater_unlock fail");
+		}
+
+		zc_arraylist_del(files);
+		files = NULL;
+	}
+
+exit:
+	if (files) zc_arraylist_del(files);
+	zc_arraylist_del(archives);
+	return;
+}
+
 static void zlog_rotater_clean(zlog_rotater_t *a_rotater)
 {
 	a_rotater->base_path = NULL;
@@ -425,7 +704,8 @@ static void zlog_rotater_clean(zlog_rotater_t *a_rotater)
 }
 
 static int zlog_rotater_lsmv(zlog_rotater_t *a_rotater, 
-		char *base_path, char *archive_path, int archive_max_count)
+		char *base_path, char *archive_path, int archive_max_count,
+		long archive_max_bytes, long archive_max_age)
 {
 	int rc = 0;
 
@@ -438,6 +718,13 @@ static int zlog_rotater_lsmv(zlog_rotater_t *a_rotater,
 		goto err;
 	}
 
+	if (archive_max_bytes > 0 || archive_max_age > 0) {
+		if (zlog_rotater_index_archive(a_rotater, archive_max_bytes, archive_max_age)) {
+			/* files are still rotated, only not reclaimed */
+			zc_error("zlog_rotater_index_archive fail");
+		}
+	}
+
 	rc = zlog_rotater_add_archive_files(a_rotater);
 	if (rc) {
 		zc_error("zlog_rotater_add_archive_files fail");
@@ -528,7 +815,8 @@ static int zlog_rotater_unlock(zlog_rotater_t *a_rotater)
 
 int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 		char *base_path, size_t msg_len,
-		char *archive_path, long archive_max_size, int archive_max_count)
+		char *archive_path, long archive_max_size, int archive_max_count,
+		long archive_max_bytes, long archive_max_age)
 {
 	int rc = 0;
 	struct zlog_stat info;
@@ -555,11 +843,14 @@ int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 	}
 
 	/* begin list and move files */
-	rc = zlog_rotater_lsmv(a_rotater, base_path, archive_path, archive_max_count);
+	ZLOG_PROBE1(rotate__start, base_path);
+	rc = zlog_rotater_lsmv(a_rotater, base_path, archive_path, archive_max_count,
+			archive_max_bytes, archive_max_age);
 	if (rc) {
 		zc_error("zlog_rotater_lsmv [%s] fail, return", base_path);
 		rc = -1;
 	} /* else if (rc == 0) */
+	ZLOG_PROBE2(rotate__done, base_path, rc);
 
 	//zc_debug("zlog_rotater_file_ls_mv success");
 
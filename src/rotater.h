@@ -10,6 +10,7 @@
 #define __zlog_rotater_h
 
 #include "zc_defs.h"
+#include "worker.h"
 
 typedef struct zlog_rotater_s {
 	pthread_mutex_t lock_mutex;
@@ -26,6 +27,13 @@ typedef struct zlog_rotater_s {
 	int mv_type;				/* ROLLING or SEQUENCE */
 	int max_count;
 	zc_arraylist_t *files;
+
+	/* archive index, each archive glob seen in rotation with a
+	 * bytes or age limit, the janitor keeps them in limits */
+	zc_arraylist_t *archives;
+	zlog_worker_t *janitor;
+	size_t reclaimed_files;
+	size_t reclaimed_bytes;
 } zlog_rotater_t;
 
 zlog_rotater_t *zlog_rotater_new(char *lock_file);
@@ -38,7 +46,8 @@ void zlog_rotater_del(zlog_rotater_t *a_rotater);
  */
 int zlog_rotater_rotate(zlog_rotater_t *a_rotater,
 		char *base_path, size_t msg_len,
-		char *archive_path, long archive_max_size, int archive_max_count);
+		char *archive_path, long archive_max_size, int archive_max_count,
+		long archive_max_bytes, long archive_max_age);
 
 void zlog_rotater_profile(zlog_rotater_t *a_rotater, int flag);
 
@@ -15,9 +15,11 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <signal.h>
 
 #include "rule.h"
 #include "format.h"
@@ -27,6 +29,14 @@
 #include "rotater.h"
 #include "spec.h"
 #include "conf.h"
+#include "syncer.h"
+#include "uring.h"
+#include "mapfile.h"
+#include "dgram.h"
+#include "pipe.h"
+#include "tcp.h"
+#include "ring.h"
+#include "probe.h"
 
 #include "zc_defs.h"
 
@@ -37,7 +47,7 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 	zlog_spec_t *a_spec;
 
 	zc_assert(a_rule,);
-	zc_profile(flag, "---rule:[%p][%s%c%d]-[%d,%d][%s,%p,%d:%ld*%d~%s][%d][%d][%s:%s:%p];[%p]---",
+	zc_profile(flag, "---rule:[%p][%s%c%d]-[%d,%d][%s,%p,%d:%ld*%d~%s,%ld,%ld][%ld,%ld][%p,%p,%p][%d][%s:%s:%p];[%p]---",
 		a_rule,
 
 		a_rule->category,
@@ -54,14 +64,21 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 		a_rule->archive_max_size,
 		a_rule->archive_max_count,
 		a_rule->archive_path,
+		a_rule->archive_max_bytes,
+		a_rule->archive_max_age,
 
-		a_rule->pipe_fd,
+		(long)a_rule->preallocate,
+		(long)a_rule->mmap_chunk,
+
+		a_rule->pipe,
+		a_rule->tcp,
+		a_rule->ring,
 
 		a_rule->syslog_facility,
 
 		a_rule->record_name,
 		a_rule->record_path,
-		a_rule->record_func,
+		a_rule->record,
 		a_rule->format);
 
 	if (a_rule->dynamic_specs) {
@@ -73,19 +90,181 @@ void zlog_rule_profile(zlog_rule_t * a_rule, int flag)
 }
 
 /*******************************************************************************/
+/* keep about one chunk allocated ahead of the append offset,
+ * as FALLOC_FL_KEEP_SIZE does not change the file size, readers see nothing.
+ * only one writer allocates at a time, others go on without waiting
+ */
+static void zlog_rule_preallocate(zlog_rule_t * a_rule, int fd, off_t offset)
+{
+	off_t start;
+	off_t end;
+	struct zlog_stat info;
 
-static int zlog_rule_output_static_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+	/* still more than half a chunk ahead */
+	if (offset + (off_t)(a_rule->preallocate / 2) < a_rule->prealloc_end) return;
+
+	if (pthread_mutex_trylock(&(a_rule->prealloc_mutex))) return;
+
+	if (zlog_fstat(fd, &info)) {
+		zc_error("fstat fail, errno[%d]", errno);
+		goto exit;
+	}
+
+	if (info.st_ino != a_rule->prealloc_ino) {
+		/* reopened or rotated, a new file */
+		a_rule->prealloc_ino = info.st_ino;
+		a_rule->prealloc_end = info.st_size;
+	}
+	a_rule->prealloc_offset = info.st_size;
+
+	start = (a_rule->prealloc_end > info.st_size) ? a_rule->prealloc_end : info.st_size;
+	end = info.st_size + a_rule->preallocate;
+
+	/* never allocate beyond the rotate size, so the archive needs no trim */
+	if (a_rule->archive_max_size > 0 && end > a_rule->archive_max_size) {
+		end = a_rule->archive_max_size;
+	}
+	if (end <= start) goto exit;
+
+	if (zlog_fallocate(fd, start, end - start)) {
+		if (errno == EOPNOTSUPP || errno == ENOSYS) {
+			zc_warn("fallocate not supported on [%s], preallocate off", a_rule->file_path);
+			a_rule->preallocate = 0;
+		} else {
+			zc_error("fallocate [%s] fail, errno[%d]", a_rule->file_path, errno);
+		}
+		goto exit;
+	}
+	a_rule->prealloc_end = end;
+
+exit:
+	pthread_mutex_unlock(&(a_rule->prealloc_mutex));
+	return;
+}
+
+/* on close, give back what is allocated beyond the end of file,
+ * truncate to the same size does it, punch hole does not on ext4
+ */
+static void zlog_rule_preallocate_trim(zlog_rule_t * a_rule, int fd)
 {
-	struct stat stb;
-	int do_file_reload = 0;
-	int redo_inode_stat = 0;
+	struct zlog_stat info;
 
-	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
-		zc_error("zlog_format_gen_msg fail");
+	if (zlog_fstat(fd, &info)) {
+		zc_error("fstat fail, errno[%d]", errno);
+		return;
+	}
+	if (info.st_ino != a_rule->prealloc_ino || a_rule->prealloc_end <= info.st_size) return;
+
+	if (ftruncate(fd, info.st_size)) {
+		zc_error("ftruncate [%s] fail, errno[%d]", a_rule->file_path, errno);
+	}
+	a_rule->prealloc_end = info.st_size;
+	return;
+}
+
+/* count lines for the syncer, a writer never syncs in its own thread.
+ * path is for dynamic file path, the syncer syncs the last one
+ */
+static void zlog_rule_sync_later(zlog_rule_t * a_rule, char *path)
+{
+	size_t count;
+
+	if (!a_rule->fsync_period && !a_rule->fsync_interval) return;
+
+	count = __sync_add_and_fetch(&(a_rule->fsync_count), 1);
+	if (count != 1 && count != a_rule->fsync_period) return;
+
+	if (path) {
+		pthread_mutex_lock(&(a_rule->sync_mutex));
+		if (STRCMP(a_rule->sync_path, !=, path)) {
+			snprintf(a_rule->sync_path, sizeof(a_rule->sync_path), "%s", path);
+		}
+		pthread_mutex_unlock(&(a_rule->sync_mutex));
+	}
+
+	if (count == 1) {
+		/* 1st dirty line since last round, thread may be gone after fork */
+		if (zlog_syncer_start(zlog_env_conf->syncer)) {
+			zc_error("zlog_syncer_start fail");
+		}
+	}
+	if (count == a_rule->fsync_period) {
+		zlog_syncer_kick(zlog_env_conf->syncer);
+	}
+	return;
+}
+
+/* called by syncer under its round lock, sync_fd is never used by writers.
+ * the file is opened again by path, so a rotated or moved file is synced
+ * once more by the old fd before it is closed
+ * return 0 writeback started, 1 nothing to sync, -1 fail
+ */
+int zlog_rule_sync_start(zlog_rule_t * a_rule)
+{
+	int fd;
+	char path[MAXLEN_PATH + 1];
+	struct zlog_stat info;
+
+	if (a_rule->file_path[0] == '\0' || (a_rule->file_open_flags & O_SYNC)) return 1;
+
+	if (a_rule->dynamic_specs) {
+		pthread_mutex_lock(&(a_rule->sync_mutex));
+		strcpy(path, a_rule->sync_path);
+		pthread_mutex_unlock(&(a_rule->sync_mutex));
+		if (path[0] == '\0') return 1;
+	} else {
+		strcpy(path, a_rule->file_path);
+	}
+
+	if (zlog_stat(path, &info)) {
+		/* moved away, sync what we have */
+		if (a_rule->sync_fd <= 0) return 1;
+	} else if (a_rule->sync_fd <= 0
+		|| info.st_ino != a_rule->sync_ino || info.st_dev != a_rule->sync_dev) {
+		if (a_rule->sync_fd > 0) {
+			if (zlog_fsync(a_rule->sync_fd)) {
+				zc_error("fsync[%d] fail, errno[%d]", a_rule->sync_fd, errno);
+			}
+			close(a_rule->sync_fd);
+			a_rule->sync_fd = 0;
+		}
+
+		fd = open(path, O_WRONLY | O_APPEND);
+		if (fd < 0) {
+			zc_error("open file[%s] fail, errno[%d]", path, errno);
+			return -1;
+		}
+		a_rule->sync_fd = fd;
+		a_rule->sync_dev = info.st_dev;
+		a_rule->sync_ino = info.st_ino;
+	}
+
+#ifdef __linux__
+	/* start writeback, not wait */
+	if (sync_file_range(a_rule->sync_fd, 0, 0, SYNC_FILE_RANGE_WRITE)) {
+		zc_error("sync_file_range[%d] fail, errno[%d]", a_rule->sync_fd, errno);
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+int zlog_rule_sync_wait(zlog_rule_t * a_rule)
+{
+	if (zlog_fsync(a_rule->sync_fd)) {
+		zc_error("fsync[%d] fail, errno[%d]", a_rule->sync_fd, errno);
 		return -1;
 	}
+	return 0;
+}
+
+/* check if the output file was changed by an external tool by comparing the inode to our saved off one */
+static int zlog_rule_reopen_static_file(zlog_rule_t * a_rule)
+{
+	struct stat stb;
+	int do_file_reload = 0;
+	int redo_inode_stat = 0;
 
-	/* check if the output file was changed by an external tool by comparing the inode to our saved off one */
 	if (stat(a_rule->file_path, &stb)) {
 		if (errno != ENOENT) {
 			zc_error("stat fail on [%s], errno[%d]", a_rule->file_path, errno);
@@ -119,21 +298,85 @@ static int zlog_rule_output_static_file_single(zlog_rule_t * a_rule, zlog_thread
 		a_rule->static_ino = stb.st_ino;
 	}
 
-	if (write(a_rule->static_fd,
+	return 0;
+}
+
+/* io engine calls these in its own thread, it owns static_fd then.
+ * the file is checked once a round, not for every line
+ */
+int zlog_rule_async_fd(zlog_rule_t * a_rule, size_t round)
+{
+	if (a_rule->async_round != round) {
+		a_rule->async_round = round;
+		if (zlog_rule_reopen_static_file(a_rule)) {
+			zc_error("zlog_rule_reopen_static_file fail");
+		}
+	}
+	return a_rule->static_fd;
+}
+
+void zlog_rule_async_written(zlog_rule_t * a_rule, int fd, size_t len)
+{
+	if (a_rule->preallocate) {
+		zlog_rule_preallocate(a_rule, fd,
+			__sync_add_and_fetch(&(a_rule->prealloc_offset), (off_t)len));
+	}
+	return;
+}
+
+/* write() of a line, with probes around */
+static ssize_t zlog_rule_write(zlog_rule_t * a_rule, int fd, const char *buf, size_t len)
+{
+	ssize_t rc;
+
+	ZLOG_PROBE3(write__start, a_rule->name, fd, len);
+	rc = write(fd, buf, len);
+	ZLOG_PROBE3(write__done, a_rule->name, fd, rc);
+	return rc;
+}
+
+static int zlog_rule_output_static_file_single(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+		zc_error("zlog_format_gen_msg fail");
+		return -1;
+	}
+
+	if (zlog_env_conf->uring) {
+		if (zlog_uring_fits(zlog_env_conf->uring, zlog_buf_len(a_thread->msg_buf))) {
+			if (zlog_uring_write(zlog_env_conf->uring, a_rule,
+					zlog_buf_str(a_thread->msg_buf),
+					zlog_buf_len(a_thread->msg_buf))) {
+				zc_error("zlog_uring_write fail");
+				return -1;
+			}
+			zlog_rule_sync_later(a_rule, NULL);
+			return 0;
+		}
+		/* too long for spool, write here after what is before */
+		zlog_uring_drain(zlog_env_conf->uring);
+	}
+
+	if (zlog_rule_reopen_static_file(a_rule)) {
+		zc_error("zlog_rule_reopen_static_file fail");
+		return -1;
+	}
+
+	if (zlog_rule_write(a_rule, a_rule->static_fd,
 			zlog_buf_str(a_thread->msg_buf),
 			zlog_buf_len(a_thread->msg_buf)) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		return -1;
 	}
 
-	/* not so thread safe here, as multiple thread may ++fsync_count at the same time */
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(a_rule->static_fd)) {
-			zc_error("fsync[%d] fail, errno[%d]", a_rule->static_fd, errno);
-		}
+	if (a_rule->preallocate) {
+		zlog_rule_preallocate(a_rule, a_rule->static_fd,
+			__sync_add_and_fetch(&(a_rule->prealloc_offset),
+				(off_t)zlog_buf_len(a_thread->msg_buf)));
 	}
 
+	zlog_rule_sync_later(a_rule, NULL);
+
 	return 0;
 }
 
@@ -176,15 +419,15 @@ static int zlog_rule_output_static_file_rotate(zlog_rule_t * a_rule, zlog_thread
 	}
 
 	len = zlog_buf_len(a_thread->msg_buf);
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
+	if (zlog_rule_write(a_rule, fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		close(fd);
 		return -1;
 	}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
+	if (a_rule->preallocate) {
+		zlog_rule_preallocate(a_rule, fd,
+			__sync_add_and_fetch(&(a_rule->prealloc_offset), (off_t)len));
 	}
 
 	if (close(fd) < 0) {
@@ -192,12 +435,7 @@ static int zlog_rule_output_static_file_rotate(zlog_rule_t * a_rule, zlog_thread
 		return -1;
 	}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(a_rule->static_fd)) {
-			zc_error("fsync[%d] fail, errno[%d]", a_rule->static_fd, errno);
-		}
-	}
+	zlog_rule_sync_later(a_rule, NULL);
 
 	if (len > a_rule->archive_max_size) {
 		zc_debug("one msg's len[%ld] > archive_max_size[%ld], no rotate",
@@ -216,7 +454,8 @@ static int zlog_rule_output_static_file_rotate(zlog_rule_t * a_rule, zlog_thread
 	if (zlog_rotater_rotate(zlog_env_conf->rotater, 
 		a_rule->file_path, len,
 		zlog_rule_gen_archive_path(a_rule, a_thread),
-		a_rule->archive_max_size, a_rule->archive_max_count)
+		a_rule->archive_max_size, a_rule->archive_max_count,
+		a_rule->archive_max_bytes, a_rule->archive_max_age)
 		) {
 		zc_error("zlog_rotater_rotate fail");
 		return -1;
@@ -225,6 +464,46 @@ static int zlog_rule_output_static_file_rotate(zlog_rule_t * a_rule, zlog_thread
 	return 0;
 }
 
+/* no open, no stat and no write for a line,
+ * so a file moved away by others is not noticed until reload
+ */
+static int zlog_rule_output_static_file_mmap(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	int rc;
+	size_t len;
+
+	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+		zc_error("zlog_format_gen_msg fail");
+		return -1;
+	}
+
+	len = zlog_buf_len(a_thread->msg_buf);
+	rc = zlog_mapfile_write(a_rule->mapfile, zlog_buf_str(a_thread->msg_buf), len);
+	if (rc < 0) {
+		zc_error("zlog_mapfile_write fail");
+		return -1;
+	}
+
+	zlog_rule_sync_later(a_rule, NULL);
+
+	if (rc == 0) return 0;
+
+	/* truncate and close, so the rotater sees the real size */
+	zlog_mapfile_suspend(a_rule->mapfile);
+	rc = zlog_rotater_rotate(zlog_env_conf->rotater,
+		a_rule->file_path, len,
+		zlog_rule_gen_archive_path(a_rule, a_thread),
+		a_rule->archive_max_size, a_rule->archive_max_count,
+		a_rule->archive_max_bytes, a_rule->archive_max_age);
+	zlog_mapfile_resume(a_rule->mapfile);
+	if (rc) {
+		zc_error("zlog_rotater_rotate fail");
+		return -1;
+	}
+
+	return 0;
+}
+
 /* return path	success
  * return NULL	fail
  */
@@ -263,22 +542,18 @@ static int zlog_rule_output_dynamic_file_single(zlog_rule_t * a_rule, zlog_threa
 		return -1;
 	}
 
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
+	if (zlog_rule_write(a_rule, fd, zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		close(fd);
 		return -1;
 	}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
-	}
-
 	if (close(fd) < 0) {
 		zc_error("close fail, maybe cause by write, errno[%d]", errno);
 		return -1;
 	}
 
+	zlog_rule_sync_later(a_rule, zlog_buf_str(a_thread->path_buf));
 	return 0;
 }
 
@@ -304,22 +579,19 @@ static int zlog_rule_output_dynamic_file_rotate(zlog_rule_t * a_rule, zlog_threa
 	}
 
 	len = zlog_buf_len(a_thread->msg_buf);
-	if (write(fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
+	if (zlog_rule_write(a_rule, fd, zlog_buf_str(a_thread->msg_buf), len) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		close(fd);
 		return -1;
 	}
 
-	if (a_rule->fsync_period && ++a_rule->fsync_count >= a_rule->fsync_period) {
-		a_rule->fsync_count = 0;
-		if (fsync(fd)) zc_error("fsync[%d] fail, errno[%d]", fd, errno);
-	}
-
 	if (close(fd) < 0) {
 		zc_error("write fail, maybe cause by write, errno[%d]", errno);
 		return -1;
 	}
 
+	zlog_rule_sync_later(a_rule, path);
+
 	if (len > a_rule->archive_max_size) {
 		zc_debug("one msg's len[%ld] > archive_max_size[%ld], no rotate",
 			 (long)len, (long) a_rule->archive_max_size);
@@ -337,7 +609,8 @@ static int zlog_rule_output_dynamic_file_rotate(zlog_rule_t * a_rule, zlog_threa
 	if (zlog_rotater_rotate(zlog_env_conf->rotater, 
 		path, len,
 		zlog_rule_gen_archive_path(a_rule, a_thread),
-		a_rule->archive_max_size, a_rule->archive_max_count)
+		a_rule->archive_max_size, a_rule->archive_max_count,
+		a_rule->archive_max_bytes, a_rule->archive_max_age)
 		) {
 		zc_error("zlog_rotater_rotate fail");
 		return -1;
@@ -353,13 +626,50 @@ static int zlog_rule_output_pipe(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
 		return -1;
 	}
 
-	if (write(a_rule->pipe_fd,
+	if (zlog_pipe_write(a_rule->pipe,
 			zlog_buf_str(a_thread->msg_buf),
-			zlog_buf_len(a_thread->msg_buf)) < 0) {
-		zc_error("write fail, errno[%d]", errno);
+			zlog_buf_len(a_thread->msg_buf))) {
+		zc_error("zlog_pipe_write fail");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int zlog_rule_output_tcp(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+		zc_error("zlog_format_gen_msg fail");
+		return -1;
+	}
+
+	if (zlog_tcp_write(a_rule->tcp,
+			zlog_buf_str(a_thread->msg_buf),
+			zlog_buf_len(a_thread->msg_buf))) {
+		zc_error("zlog_tcp_write fail");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int zlog_rule_output_ring(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+		zc_error("zlog_format_gen_msg fail");
 		return -1;
 	}
 
+	zlog_ring_write(a_rule->ring,
+			zlog_buf_str(a_thread->msg_buf),
+			zlog_buf_len(a_thread->msg_buf));
+
+	/* the line itself is in the dump */
+	if (a_thread->event->level >= a_rule->ring_level
+		&& zlog_ring_dump(a_rule->ring, "level")) {
+		zc_error("zlog_ring_dump fail");
+		return -1;
+	}
 	return 0;
 }
 
@@ -384,11 +694,32 @@ static int zlog_rule_output_syslog(zlog_rule_t * a_rule, zlog_thread_t * a_threa
 	return 0;
 }
 
+static int zlog_rule_output_syslog_dgram(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	if (zlog_format_gen_msg(a_rule->format, a_thread)) {
+		zc_error("zlog_format_gen_msg fail");
+		return -1;
+	}
+
+	if (!a_thread->event->time_stamp.tv_sec) {
+		gettimeofday(&(a_thread->event->time_stamp), NULL);
+	}
+
+	if (zlog_dgram_write(a_rule->dgram, a_thread->event->level,
+			&(a_thread->event->time_stamp),
+			zlog_buf_str(a_thread->msg_buf),
+			zlog_buf_len(a_thread->msg_buf))) {
+		zc_error("zlog_dgram_write fail");
+		return -1;
+	}
+	return 0;
+}
+
 static int zlog_rule_output_static_record(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
 {
 	zlog_msg_t msg;
 
-	if (!a_rule->record_func) {
+	if (!a_rule->record) {
 		zc_error("user defined record funcion for [%s] not set, no output",
 			a_rule->record_name);
 		return -1;
@@ -404,7 +735,7 @@ static int zlog_rule_output_static_record(zlog_rule_t * a_rule, zlog_thread_t *
 	msg.len = zlog_buf_len(a_thread->msg_buf);
 	msg.path = a_rule->record_path;
 
-	if (a_rule->record_func(&msg)) {
+	if (zlog_record_output(a_rule->record, &msg)) {
 		zc_error("a_rule->record fail");
 		return -1;
 	}
@@ -415,7 +746,7 @@ static int zlog_rule_output_dynamic_record(zlog_rule_t * a_rule, zlog_thread_t *
 {
 	zlog_msg_t msg;
 
-	if (!a_rule->record_func) {
+	if (!a_rule->record) {
 		zc_error("user defined record funcion for [%s] not set, no output",
 			a_rule->record_name);
 		return -1;
@@ -433,7 +764,7 @@ static int zlog_rule_output_dynamic_record(zlog_rule_t * a_rule, zlog_thread_t *
 	msg.len = zlog_buf_len(a_thread->msg_buf);
 	msg.path = zlog_buf_str(a_thread->path_buf);
 
-	if (a_rule->record_func(&msg)) {
+	if (zlog_record_output(a_rule->record, &msg)) {
 		zc_error("a_rule->record fail");
 		return -1;
 	}
@@ -449,7 +780,7 @@ static int zlog_rule_output_stdout(zlog_rule_t * a_rule,
 		return -1;
 	}
 
-	if (write(STDOUT_FILENO,
+	if (zlog_rule_write(a_rule, STDOUT_FILENO,
 		zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		return -1;
@@ -467,7 +798,7 @@ static int zlog_rule_output_stderr(zlog_rule_t * a_rule,
 		return -1;
 	}
 
-	if (write(STDERR_FILENO,
+	if (zlog_rule_write(a_rule, STDERR_FILENO,
 		zlog_buf_str(a_thread->msg_buf), zlog_buf_len(a_thread->msg_buf)) < 0) {
 		zc_error("write fail, errno[%d]", errno);
 		return -1;
@@ -507,6 +838,120 @@ static int syslog_facility_atoi(char *facility)
 	return -187;
 }
 
+/* options	[archive_max_bytes=1GB archive_max_age=7d preallocate=64MB mmap=64MB]
+ *		[frame=rfc5424 target=udp:loghost:514] for syslog
+ *		[frame=len spool=4MB overflow=/var/spool/a.tcp overflow_max=1GB] for tcp
+ *		[dump_level=ERROR dump_signal=SIGUSR2 file=/dev/shm/a.ring] for $ring
+ *		[dedup=10s] for files, syslog, tcp and $ring
+ * name=value pairs after the file limit, split by space or ','
+ * anything in "" is path, not option
+ */
+static int zlog_rule_parse_signal(char *value)
+{
+	char *p = value;
+
+	if (STRNCMP(p, ==, "SIG", 3)) p += 3;
+	if (STRCMP(p, ==, "USR1")) return SIGUSR1;
+	if (STRCMP(p, ==, "USR2")) return SIGUSR2;
+	if (STRCMP(p, ==, "HUP")) return SIGHUP;
+	if (STRCMP(p, ==, "QUIT")) return SIGQUIT;
+	return atoi(p);
+}
+
+static int zlog_rule_parse_options(zlog_rule_t * a_rule, char *options)
+{
+	int nscan;
+	int in_quotation = 0;
+	char *p;
+	char name[MAXLEN_CFG_LINE + 1];
+	char value[MAXLEN_CFG_LINE + 1];
+
+	for (p = options; *p != '\0'; p++) {
+		if (*p == '"') {
+			in_quotation ^= 1;
+			continue;
+		}
+		if (in_quotation || !isalpha(*p)) continue;
+		if (p != options && !isspace(*(p-1)) && *(p-1) != ',') continue;
+
+		memset(name, 0x00, sizeof(name));
+		memset(value, 0x00, sizeof(value));
+		nscan = sscanf(p, "%[a-z_]=%[^ \t,\"]", name, value);
+		if (nscan != 2) continue;
+
+		if (STRCMP(name, ==, "archive_max_bytes")) {
+			a_rule->archive_max_bytes = zc_parse_byte_size(value);
+		} else if (STRCMP(name, ==, "archive_max_age")) {
+			a_rule->archive_max_age = zc_parse_time_span(value);
+		} else if (STRCMP(name, ==, "preallocate")) {
+			a_rule->preallocate = zc_parse_byte_size(value);
+		} else if (STRCMP(name, ==, "mmap")) {
+			a_rule->mmap_chunk = zc_parse_byte_size(value);
+		} else if (STRCMP(name, ==, "frame")) {
+			if (STRICMP(value, ==, "rfc3164")) {
+				a_rule->syslog_frame = ZLOG_DGRAM_RFC3164;
+			} else if (STRICMP(value, ==, "rfc5424")) {
+				a_rule->syslog_frame = ZLOG_DGRAM_RFC5424;
+			} else if (STRICMP(value, ==, "line")) {
+				a_rule->tcp_frame = ZLOG_TCP_LINE;
+				goto next;
+			} else if (STRICMP(value, ==, "len")) {
+				a_rule->tcp_frame = ZLOG_TCP_LEN;
+				goto next;
+			} else {
+				zc_error("frame[%s] must be rfc3164, rfc5424, line or len", value);
+				return -1;
+			}
+			if (a_rule->syslog_target[0] == '\0') {
+				strcpy(a_rule->syslog_target, "/dev/log");
+			}
+		} else if (STRCMP(name, ==, "target")) {
+			if (strlen(value) > sizeof(a_rule->syslog_target) - 1) {
+				zc_error("target[%s] too long", value);
+				return -1;
+			}
+			strcpy(a_rule->syslog_target, value);
+		} else if (STRCMP(name, ==, "spool")) {
+			a_rule->tcp_spool = zc_parse_byte_size(value);
+		} else if (STRCMP(name, ==, "overflow")) {
+			if (strlen(value) > sizeof(a_rule->tcp_overflow) - 1) {
+				zc_error("overflow[%s] too long", value);
+				return -1;
+			}
+			strcpy(a_rule->tcp_overflow, value);
+		} else if (STRCMP(name, ==, "overflow_max")) {
+			a_rule->tcp_overflow_max = zc_parse_byte_size(value);
+		} else if (STRCMP(name, ==, "dump_level")) {
+			strcpy(a_rule->ring_dump_level, value);
+		} else if (STRCMP(name, ==, "file")) {
+			if (strlen(value) > sizeof(a_rule->ring_file) - 1) {
+				zc_error("file[%s] too long", value);
+				return -1;
+			}
+			strcpy(a_rule->ring_file, value);
+		} else if (STRCMP(name, ==, "dedup")) {
+			a_rule->dedup_window = zc_parse_time_span(value);
+			if (a_rule->dedup_window <= 0) {
+				zc_error("dedup[%s] is wrong", value);
+				return -1;
+			}
+		} else if (STRCMP(name, ==, "dump_signal")) {
+			a_rule->ring_signal = zlog_rule_parse_signal(value);
+			if (a_rule->ring_signal <= 0) {
+				zc_error("dump_signal[%s] is wrong", value);
+				return -1;
+			}
+		} else {
+			zc_error("unknown rule option[%s]", name);
+			return -1;
+		}
+	next:
+		p += strlen(name) + 1 + strlen(value) - 1;
+	}
+
+	return 0;
+}
+
 static int zlog_rule_parse_path(char *path_start, /* start with a " */
 		char *path_str, size_t path_size, zc_arraylist_t **path_specs,
 		int *time_cache_count)
@@ -574,6 +1019,9 @@ zlog_rule_t *zlog_rule_new(char *line,
 		zc_arraylist_t * formats,
 		unsigned int file_perms,
 		size_t fsync_period,
+		long fsync_interval,
+		size_t pipe_buffer,
+		long pipe_full_wait,
 		int * time_cache_count)
 {
 	int rc = 0;
@@ -606,8 +1054,38 @@ zlog_rule_t *zlog_rule_new(char *line,
 		return NULL;
 	}
 
+	if (pthread_mutex_init(&(a_rule->prealloc_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		free(a_rule);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&(a_rule->sync_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		pthread_mutex_destroy(&(a_rule->prealloc_mutex));
+		free(a_rule);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&(a_rule->dedup_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		pthread_mutex_destroy(&(a_rule->sync_mutex));
+		pthread_mutex_destroy(&(a_rule->prealloc_mutex));
+		free(a_rule);
+		return NULL;
+	}
+
+	a_rule->refs = 1;
+	snprintf(a_rule->line, sizeof(a_rule->line), "%s", line);
+	a_rule->stats_slot = zlog_stats_slot_new();
+	if (a_rule->stats_slot < 0) {
+		zc_error("zlog_stats_slot_new fail");
+		goto err;
+	}
+
 	a_rule->file_perms = file_perms;
 	a_rule->fsync_period = fsync_period;
+	a_rule->fsync_interval = fsync_interval;
 
 	/* line         [f.INFO "%H/log/aa.log", 20MB * 12; MyTemplate]
 	 * selector     [f.INFO]
@@ -744,6 +1222,16 @@ zlog_rule_t *zlog_rule_new(char *line,
 		goto err;
 	}
 
+	strcpy(a_rule->name, selector);
+	len = strlen(a_rule->name);
+	if (len + 1 + strlen(file_path) < sizeof(a_rule->name)) {
+		a_rule->name[len] = ' ';
+		strcpy(a_rule->name + len + 1, file_path);
+	}
+	for (len = strlen(a_rule->name); len > 0 && isspace(a_rule->name[len - 1]); len--) {
+		a_rule->name[len - 1] = '\0';
+	}
+
 	file_limit = strchr(output, ',');
 	if (file_limit) {
 		file_limit++; /* skip the , */
@@ -763,6 +1251,7 @@ zlog_rule_t *zlog_rule_new(char *line,
 
 		/* no need to fsync, as file is opened by O_SYNC, write immediately */
 		a_rule->fsync_period = 0;
+		a_rule->fsync_interval = 0;
 
 		p = file_path + 1;
 		a_rule->file_open_flags = O_SYNC;
@@ -803,10 +1292,24 @@ zlog_rule_t *zlog_rule_new(char *line,
 					goto err;
 				}
 			}
+
+			if (zlog_rule_parse_options(a_rule, file_limit)) {
+				zc_error("zlog_rule_parse_options fail");
+				goto err;
+			}
 		}
 
 		/* try to figure out if the log file path is dynamic or static */
 		if (a_rule->dynamic_specs) {
+			if (a_rule->preallocate) {
+				/* fd is opened and closed each time, nothing to keep */
+				zc_warn("preallocate only works for static file path, ignore");
+				a_rule->preallocate = 0;
+			}
+			if (a_rule->mmap_chunk) {
+				zc_warn("mmap only works for static file path, ignore");
+				a_rule->mmap_chunk = 0;
+			}
 			if (a_rule->archive_max_size <= 0) {
 				a_rule->output = zlog_rule_output_dynamic_file_single;
 			} else {
@@ -815,6 +1318,27 @@ zlog_rule_t *zlog_rule_new(char *line,
 		} else {
 			struct stat stb;
 
+			if (a_rule->mmap_chunk && (a_rule->file_open_flags & O_SYNC)) {
+				zc_warn("mmap does not work with -, ignore");
+				a_rule->mmap_chunk = 0;
+			}
+			if (a_rule->mmap_chunk) {
+				if (a_rule->preallocate) {
+					/* the mapped file is extended ahead anyway */
+					zc_warn("preallocate is useless with mmap, ignore");
+					a_rule->preallocate = 0;
+				}
+				a_rule->mapfile = zlog_mapfile_new(a_rule->file_path,
+					a_rule->file_open_flags, a_rule->file_perms,
+					a_rule->mmap_chunk, a_rule->archive_max_size);
+				if (!a_rule->mapfile) {
+					zc_error("zlog_mapfile_new fail");
+					goto err;
+				}
+				a_rule->output = zlog_rule_output_static_file_mmap;
+				break;
+			}
+
 			if (a_rule->archive_max_size <= 0) {
 				a_rule->output = zlog_rule_output_static_file_single;
 			} else {
@@ -840,25 +1364,62 @@ zlog_rule_t *zlog_rule_new(char *line,
 		}
 		break;
 	case '|' :
-		a_rule->pipe_fp = popen(output + 1, "w");
-		if (!a_rule->pipe_fp) {
-			zc_error("popen fail, errno[%d]", errno);
+		a_rule->pipe = zlog_pipe_new(output + 1, pipe_buffer, pipe_full_wait);
+		if (!a_rule->pipe) {
+			zc_error("zlog_pipe_new fail");
+			goto err;
+		}
+		a_rule->output = zlog_rule_output_pipe;
+		break;
+	case 't' :
+		if (STRNCMP(file_path, !=, "tcp://", 6)) {
+			zc_error("[%s] is not tcp://host:port", file_path);
 			goto err;
 		}
-		a_rule->pipe_fd = fileno(a_rule->pipe_fp);
-		if (a_rule->pipe_fd < 0 ) {
-			zc_error("fileno fail, errno[%d]", errno);
+		if (file_limit && zlog_rule_parse_options(a_rule, file_limit)) {
+			zc_error("zlog_rule_parse_options fail");
 			goto err;
 		}
-		a_rule->output = zlog_rule_output_pipe;
+
+		/* the rest is blank before ; */
+		p = file_path + 6;
+		p[strcspn(p, " \t")] = '\0';
+		a_rule->tcp = zlog_tcp_new(p, a_rule->tcp_frame,
+			a_rule->tcp_spool ? a_rule->tcp_spool : pipe_buffer,
+			a_rule->tcp_overflow, a_rule->tcp_overflow_max);
+		if (!a_rule->tcp) {
+			zc_error("zlog_tcp_new fail");
+			goto err;
+		}
+		a_rule->output = zlog_rule_output_tcp;
 		break;
 	case '>' :
 		if (STRNCMP(file_path + 1, ==, "syslog", 6)) {
-			a_rule->syslog_facility = syslog_facility_atoi(file_limit);
+			char facility[MAXLEN_CFG_LINE + 1];
+
+			/* facility, then options */
+			memset(facility, 0x00, sizeof(facility));
+			if (file_limit) sscanf(file_limit, "%[^ \t,]", facility);
+			a_rule->syslog_facility = syslog_facility_atoi(facility);
 			if (a_rule->syslog_facility == -187) {
 				zc_error("-187 get");
 				goto err;
 			}
+			if (zlog_rule_parse_options(a_rule, file_limit)) {
+				zc_error("zlog_rule_parse_options fail");
+				goto err;
+			}
+
+			if (a_rule->syslog_target[0] != '\0') {
+				a_rule->dgram = zlog_dgram_new(a_rule->syslog_target,
+					a_rule->syslog_frame, a_rule->syslog_facility, levels);
+				if (!a_rule->dgram) {
+					zc_error("zlog_dgram_new fail");
+					goto err;
+				}
+				a_rule->output = zlog_rule_output_syslog_dgram;
+				break;
+			}
 			a_rule->output = zlog_rule_output_syslog;
 			openlog(NULL, LOG_NDELAY | LOG_NOWAIT | LOG_PID, LOG_USER);
 		} else if (STRNCMP(file_path + 1, ==, "stdout", 6)) {
@@ -872,6 +1433,62 @@ zlog_rule_t *zlog_rule_new(char *line,
 		}
 		break;
 	case '$' :
+		if (STRNCMP(file_path + 1, ==, "ring(", 5)) {
+			char ring_size[MAXLEN_CFG_LINE + 1];
+			char ring_path[MAXLEN_PATH + 1];
+
+			/* $ring(64MB), "dump path" options */
+			memset(ring_size, 0x00, sizeof(ring_size));
+			if (sscanf(file_path + 6, "%[^)]", ring_size) != 1) {
+				zc_error("no size in [%s]", file_path);
+				goto err;
+			}
+
+			memset(ring_path, 0x00, sizeof(ring_path));
+			strcpy(ring_path, "zlog.ring.dump");
+			strcpy(a_rule->ring_dump_level, "ERROR");
+			if (file_limit) {
+				p = strchr(file_limit, '"');
+				if (p) {
+					p++;
+					q = strchr(p, '"');
+					if (!q) {
+						zc_error("matching \" not found in conf line[%s]", p);
+						goto err;
+					}
+					len = q - p;
+					if (len > sizeof(ring_path) - 1) {
+						zc_error("ring path too long %ld > %ld", len, sizeof(ring_path) - 1);
+						goto err;
+					}
+					memset(ring_path, 0x00, sizeof(ring_path));
+					memcpy(ring_path, p, len);
+				}
+				if (zlog_rule_parse_options(a_rule, file_limit)) {
+					zc_error("zlog_rule_parse_options fail");
+					goto err;
+				}
+			}
+			if (zc_str_replace_env(ring_path, sizeof(ring_path))) {
+				zc_error("zc_str_replace_env fail");
+				goto err;
+			}
+
+			a_rule->ring_level = zlog_level_list_atoi(levels, a_rule->ring_dump_level);
+			if (a_rule->ring_level < 0) {
+				zc_error("dump_level[%s] is not a level", a_rule->ring_dump_level);
+				goto err;
+			}
+			a_rule->ring = zlog_ring_new(zc_parse_byte_size(ring_size), ring_path,
+				a_rule->ring_signal, a_rule->ring_file);
+			if (!a_rule->ring) {
+				zc_error("zlog_ring_new fail");
+				goto err;
+			}
+			a_rule->output = zlog_rule_output_ring;
+			break;
+		}
+
 		sscanf(file_path + 1, "%s", a_rule->record_name);
 			
 		if (file_limit) {  /* record path exists */
@@ -947,53 +1564,364 @@ err:
 void zlog_rule_del(zlog_rule_t * a_rule)
 {
 	zc_assert(a_rule,);
+	if (--a_rule->refs > 0) return;
 	if (a_rule->dynamic_specs) {
 		zc_arraylist_del(a_rule->dynamic_specs);
 		a_rule->dynamic_specs = NULL;
 	}
 	if (a_rule->static_fd) {
+		if (a_rule->preallocate) zlog_rule_preallocate_trim(a_rule, a_rule->static_fd);
 		if (close(a_rule->static_fd)) {
 			zc_error("close fail, maybe cause by write, errno[%d]", errno);
 		}
 	}
-	if (a_rule->pipe_fp) {
-		if (pclose(a_rule->pipe_fp) == -1) {
-			zc_error("pclose fail, errno[%d]", errno);
-		}
+	if (a_rule->mapfile) {
+		zlog_mapfile_del(a_rule->mapfile);
+		a_rule->mapfile = NULL;
+	}
+	if (a_rule->dgram) {
+		zlog_dgram_del(a_rule->dgram);
+		a_rule->dgram = NULL;
+	}
+	if (a_rule->pipe) {
+		zlog_pipe_del(a_rule->pipe);
+		a_rule->pipe = NULL;
+	}
+	if (a_rule->tcp) {
+		zlog_tcp_del(a_rule->tcp);
+		a_rule->tcp = NULL;
+	}
+	if (a_rule->ring) {
+		zlog_ring_del(a_rule->ring);
+		a_rule->ring = NULL;
 	}
 	if (a_rule->archive_specs) {
 		zc_arraylist_del(a_rule->archive_specs);
 		a_rule->archive_specs = NULL;
 	}
+	if (a_rule->sync_fd > 0) {
+		if (close(a_rule->sync_fd)) {
+			zc_error("close fail, errno[%d]", errno);
+		}
+	}
+	if (a_rule->dedup_count) {
+		zc_warn("rule[%s] lost report of %lu repeated lines",
+			a_rule->file_path, a_rule->dedup_count);
+	}
+	zlog_stats_slot_del(a_rule->stats_slot);
+	if (a_rule->dedup_body) free(a_rule->dedup_body);
+	pthread_mutex_destroy(&(a_rule->dedup_mutex));
+	pthread_mutex_destroy(&(a_rule->sync_mutex));
+	pthread_mutex_destroy(&(a_rule->prealloc_mutex));
 	free(a_rule);
 	zc_debug("zlog_rule_del[%p]", a_rule);
 	return;
 }
 
 /*******************************************************************************/
+static int zlog_rule_fits_time_caches(zc_arraylist_t * specs, int * time_cache_count)
+{
+	int i;
+	int index;
+	zlog_spec_t *a_spec;
+
+	if (!specs) return 1;
+	zc_arraylist_foreach(specs, i, a_spec) {
+		index = zlog_spec_time_cache_index(a_spec);
+		if (index < 0) continue;
+		if (index != *time_cache_count) return 0;
+		(*time_cache_count)++;
+	}
+	return 1;
+}
+
+zlog_rule_t *zlog_rule_share(zlog_rule_t * a_rule, zlog_format_t * a_format,
+		int * time_cache_count)
+{
+	int count;
+
+	zc_assert(a_rule, NULL);
+	zc_assert(time_cache_count, NULL);
+
+	/* nothing of it changes, so a failed reload leaves it as it was */
+	if (a_rule->format != a_format) return NULL;
+	/* a file moved away is opened again by the next line, but a mapping
+	 * is only made again by a reload, as logrotate expects */
+	if (a_rule->mapfile) return NULL;
+	count = *time_cache_count;
+	if (!zlog_rule_fits_time_caches(a_rule->dynamic_specs, &count)
+		|| !zlog_rule_fits_time_caches(a_rule->archive_specs, &count)) {
+		return NULL;
+	}
+
+	*time_cache_count = count;
+	a_rule->refs++;
+	zc_debug("zlog_rule_share[%p][%s]", a_rule, a_rule->line);
+	return a_rule;
+}
+
+/*******************************************************************************/
+/* FNV-1a, the hash only tells repeats from new lines */
+static uint64_t zlog_rule_hash(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	const unsigned char *end = p + len;
+
+	for (; p < end; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/* the line says its level, category and time, user message is replaced */
+static int zlog_rule_output_repeated(zlog_rule_t * a_rule, zlog_thread_t * a_thread,
+		unsigned long count, int level, char *category, size_t category_len)
+{
+	int rc;
+	char msg[64];
+	zlog_event_t *a_event = a_thread->event;
+	int saved_level = a_event->level;
+	char *saved_category = a_event->category_name;
+	size_t saved_category_len = a_event->category_name_len;
+	const char *saved_format = a_event->str_format;
+	zlog_event_cmd saved_cmd = a_event->generate_cmd;
+
+	/* no conversion in msg, so str_args is never read */
+	snprintf(msg, sizeof(msg), "last message repeated %lu times", count);
+	a_event->level = level;
+	a_event->category_name = category;
+	a_event->category_name_len = category_len;
+	a_event->str_format = msg;
+	a_event->generate_cmd = ZLOG_FMT;
+
+	rc = a_rule->output(a_rule, a_thread);
+
+	a_event->level = saved_level;
+	a_event->category_name = saved_category;
+	a_event->category_name_len = saved_category_len;
+	a_event->str_format = saved_format;
+	a_event->generate_cmd = saved_cmd;
+	return rc;
+}
+
+/* a line same as the last one within dedup window is only counted,
+ * the count is reported before the next different line, or the next
+ * same line after the window, or by the dedup worker when the window ends
+ */
+/* under dedup_mutex, a hash may collide, so the last line is compared */
+static int zlog_rule_dedup_same(zlog_rule_t * a_rule, zlog_event_t * a_event,
+		uint64_t hash, const char *body, size_t len)
+{
+	if (hash != a_rule->dedup_hash || len != a_rule->dedup_len) return 0;
+	if (len > a_rule->dedup_body_size) return 0;
+	if (a_event->level != a_rule->dedup_level) return 0;
+	if (a_event->category_name_len != a_rule->dedup_category_len) return 0;
+	if (memcmp(a_event->category_name, a_rule->dedup_category, a_rule->dedup_category_len)) return 0;
+	return (len == 0 || memcmp(body, a_rule->dedup_body, len) == 0);
+}
+
+/* under dedup_mutex, keep the body of the last line */
+static void zlog_rule_dedup_keep(zlog_rule_t * a_rule, const char *body, size_t len)
+{
+	char *p;
+
+	if (len > a_rule->dedup_body_size) {
+		p = realloc(a_rule->dedup_body, len);
+		if (!p) {
+			zc_error("realloc fail, errno[%d]", errno);
+			/* never the same, so never folded */
+			a_rule->dedup_len = a_rule->dedup_body_size + 1;
+			return;
+		}
+		a_rule->dedup_body = p;
+		a_rule->dedup_body_size = len;
+	}
+	if (len) memcpy(a_rule->dedup_body, body, len);
+	return;
+}
+
+static int zlog_rule_output_dedup(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	zlog_event_t *a_event = a_thread->event;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const char *body;
+	size_t len;
+	struct timespec now;
+	unsigned long count;
+	int level;
+	char *category;
+	size_t category_len;
+
+	if (a_event->generate_cmd == ZLOG_FMT) {
+		zlog_buf_restart(a_thread->pre_msg_buf);
+		if (a_event->str_format) {
+			zlog_buf_vprintf(a_thread->pre_msg_buf, a_event->str_format, a_event->str_args);
+		}
+		body = zlog_buf_str(a_thread->pre_msg_buf);
+		len = zlog_buf_len(a_thread->pre_msg_buf);
+	} else {
+		body = a_event->hex_buf;
+		len = a_event->hex_buf_len;
+	}
+	hash = zlog_rule_hash(hash, body, len);
+	hash = zlog_rule_hash(hash, &(a_event->level), sizeof(a_event->level));
+	hash = zlog_rule_hash(hash, a_event->category_name, a_event->category_name_len);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&(a_rule->dedup_mutex));
+	if (zlog_rule_dedup_same(a_rule, a_event, hash, body, len)
+		&& now.tv_sec - a_rule->dedup_start < a_rule->dedup_window) {
+		a_rule->dedup_count++;
+		pthread_mutex_unlock(&(a_rule->dedup_mutex));
+		return 0;
+	}
+	count = a_rule->dedup_count;
+	level = a_rule->dedup_level;
+	category = a_rule->dedup_category;
+	category_len = a_rule->dedup_category_len;
+	a_rule->dedup_count = 0;
+	a_rule->dedup_hash = hash;
+	a_rule->dedup_len = len;
+	a_rule->dedup_start = now.tv_sec;
+	a_rule->dedup_level = a_event->level;
+	a_rule->dedup_category = a_event->category_name;
+	a_rule->dedup_category_len = a_event->category_name_len;
+	zlog_rule_dedup_keep(a_rule, body, len);
+	pthread_mutex_unlock(&(a_rule->dedup_mutex));
+
+	if (count && zlog_rule_output_repeated(a_rule, a_thread, count, level, category, category_len)) {
+		zc_error("zlog_rule_output_repeated fail");
+	}
+	return a_rule->output(a_rule, a_thread);
+}
+
+/* expired only, or all */
+static void zlog_rule_flush_dedup(zlog_rule_t * a_rule, zlog_thread_t * a_thread, int expired)
+{
+	unsigned long count;
+	struct timespec now;
+
+	if (!a_rule->dedup_window) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&(a_rule->dedup_mutex));
+	count = a_rule->dedup_count;
+	if (!count || (expired && now.tv_sec - a_rule->dedup_start < a_rule->dedup_window)) {
+		pthread_mutex_unlock(&(a_rule->dedup_mutex));
+		return;
+	}
+	/* the next same line is a new one */
+	a_rule->dedup_count = 0;
+	a_rule->dedup_hash = 0;
+	pthread_mutex_unlock(&(a_rule->dedup_mutex));
+
+	/* the event is of an earlier line, take time again */
+	a_thread->event->time_stamp.tv_sec = 0;
+	if (zlog_rule_output_repeated(a_rule, a_thread, count,
+		a_rule->dedup_level, a_rule->dedup_category, a_rule->dedup_category_len)) {
+		zc_error("zlog_rule_output_repeated fail");
+	}
+	return;
+}
+
+void zlog_rule_flush_repeated(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	zlog_rule_flush_dedup(a_rule, a_thread, 0);
+	return;
+}
+
+void zlog_rule_flush_expired(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	zlog_rule_flush_dedup(a_rule, a_thread, 1);
+	return;
+}
+
+/* a line is counted when it is formatted, so not for a repeat folded.
+ * output time is all the time in output, but formatting
+ */
+static int zlog_rule_output_stats(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	int rc;
+	zlog_stats_block_t *a_stats = a_thread->stats;
+	zlog_stats_counter_t *a_counter;
+	unsigned long long start;
+	unsigned long long elapsed;
+	size_t truncates;
+	size_t bytes;
+
+	a_stats->formats = 0;
+	a_stats->format_ns = 0;
+	truncates = a_thread->msg_buf->truncates;
+	start = zlog_stats_now();
+
+	if (a_rule->dedup_window) {
+		rc = zlog_rule_output_dedup(a_rule, a_thread);
+	} else {
+		rc = a_rule->output(a_rule, a_thread);
+	}
+
+	elapsed = zlog_stats_now() - start;
+	if (!a_stats->formats) return rc;
+
+	bytes = zlog_buf_len(a_thread->msg_buf);
+	zlog_stats_add(a_stats->lines, 1);
+	zlog_stats_add(a_stats->levels[a_thread->event->level & 0xff], 1);
+	zlog_stats_add(a_stats->truncates, a_thread->msg_buf->truncates - truncates);
+	zlog_stats_hist_add(&(a_stats->format), a_stats->format_ns);
+	zlog_stats_hist_add(&(a_stats->output),
+		elapsed > a_stats->format_ns ? elapsed - a_stats->format_ns : 0);
+	a_counter = zlog_stats_slot(a_stats, a_rule->stats_slot);
+	if (a_counter) zlog_stats_add(a_counter->lines, 1);
+	if (rc) {
+		zlog_stats_add(a_stats->errors, 1);
+		if (a_counter) zlog_stats_add(a_counter->errors, 1);
+	} else {
+		zlog_stats_add(a_stats->bytes, bytes);
+		if (a_counter) zlog_stats_add(a_counter->bytes, bytes);
+	}
+	return rc;
+}
+
+int zlog_rule_output_matched(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
+{
+	int rc;
+
+	ZLOG_PROBE1(rule__start, a_rule->name);
+	if (a_thread->stats) {
+		rc = zlog_rule_output_stats(a_rule, a_thread);
+	} else if (a_rule->dedup_window) {
+		rc = zlog_rule_output_dedup(a_rule, a_thread);
+	} else {
+		rc = a_rule->output(a_rule, a_thread);
+	}
+	ZLOG_PROBE2(rule__done, a_rule->name, rc);
+	return rc;
+}
+
 int zlog_rule_output(zlog_rule_t * a_rule, zlog_thread_t * a_thread)
 {
 	switch (a_rule->compare_char) {
 	case '*' :
-		return a_rule->output(a_rule, a_thread);
+		return zlog_rule_output_matched(a_rule, a_thread);
 		break;
 	case '.' :
 		if (a_thread->event->level >= a_rule->level) {
-			return a_rule->output(a_rule, a_thread);
+			return zlog_rule_output_matched(a_rule, a_thread);
 		} else {
 			return 0;
 		}
 		break;
 	case '=' :
 		if (a_thread->event->level == a_rule->level) {
-			return a_rule->output(a_rule, a_thread);
+			return zlog_rule_output_matched(a_rule, a_thread);
 		} else {
 			return 0;
 		}
 		break;
 	case '!' :
 		if (a_thread->event->level != a_rule->level) {
-			return a_rule->output(a_rule, a_thread);
+			return zlog_rule_output_matched(a_rule, a_thread);
 		} else {
 			return 0;
 		}
@@ -1016,28 +1944,60 @@ int zlog_rule_is_wastebin(zlog_rule_t * a_rule)
 }
 
 /*******************************************************************************/
-int zlog_rule_match_category(zlog_rule_t * a_rule, char *category)
+int zlog_rule_thread_needs(zlog_rule_t * a_rule)
 {
-	zc_assert(a_rule, -1);
+	int i;
+	int needs = 0;
+	zlog_spec_t *a_spec;
+
+	zc_assert(a_rule, 0);
+
+	if (a_rule->format) {
+		zc_arraylist_foreach(a_rule->format->pattern_specs, i, a_spec) {
+			if (zlog_spec_is_reformat(a_spec)) needs |= ZLOG_THREAD_PRE_MSG;
+		}
+	}
+	/* %m is hashed in pre_msg_buf */
+	if (a_rule->dedup_window) needs |= ZLOG_THREAD_PRE_MSG;
+
+	if (a_rule->dynamic_specs) {
+		needs |= ZLOG_THREAD_PATH;
+		zc_arraylist_foreach(a_rule->dynamic_specs, i, a_spec) {
+			if (zlog_spec_is_reformat(a_spec)) needs |= ZLOG_THREAD_PRE_PATH;
+		}
+	}
+	if (a_rule->archive_specs) {
+		needs |= ZLOG_THREAD_ARCHIVE;
+		zc_arraylist_foreach(a_rule->archive_specs, i, a_spec) {
+			if (zlog_spec_is_reformat(a_spec)) needs |= ZLOG_THREAD_PRE_PATH;
+		}
+	}
+	return needs;
+}
+
+/*******************************************************************************/
+int zlog_rule_match_category_name(const char *rule_category, const char *category)
+{
+	zc_assert(rule_category, -1);
 	zc_assert(category, -1);
 
-	if (STRCMP(a_rule->category, ==, "*")) {
+	if (STRCMP(rule_category, ==, "*")) {
 		/* '*' match anything, so go on */
 		return 1;
-	} else if (STRCMP(a_rule->category, ==, category)) {
+	} else if (STRCMP(rule_category, ==, category)) {
 		/* accurate compare */
 		return 1;
 	} else {
 		/* aa_ match aa_xx & aa, but not match aa1_xx */
 		size_t len;
-		len = strlen(a_rule->category);
+		len = strlen(rule_category);
 
-		if (a_rule->category[len - 1] == '_') {
+		if (len > 0 && rule_category[len - 1] == '_') {
 			if (strlen(category) == len - 1) {
 				len--;
 			}
 
-			if (STRNCMP(a_rule->category, ==, category, len)) {
+			if (STRNCMP(rule_category, ==, category, len)) {
 				return 1;
 			}
 		}
@@ -1046,6 +2006,13 @@ int zlog_rule_match_category(zlog_rule_t * a_rule, char *category)
 	return 0;
 }
 
+int zlog_rule_match_category(zlog_rule_t * a_rule, char *category)
+{
+	zc_assert(a_rule, -1);
+
+	return zlog_rule_match_category_name(a_rule->category, category);
+}
+
 /*******************************************************************************/
 
 int zlog_rule_set_record(zlog_rule_t * a_rule, zc_hashtable_t *records)
@@ -1059,7 +2026,7 @@ int zlog_rule_set_record(zlog_rule_t * a_rule, zc_hashtable_t *records)
 
 	a_record = zc_hashtable_get(records, a_rule->record_name);
 	if (a_record) {
-		a_rule->record_func = a_record->output;
+		a_rule->record = a_record;
 	}
 	return 0;
 }
@@ -15,6 +15,8 @@
 #define __zlog_rule_h
 
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "zc_defs.h"
@@ -22,12 +24,21 @@
 #include "thread.h"
 #include "rotater.h"
 #include "record.h"
+#include "mapfile.h"
+#include "dgram.h"
+#include "pipe.h"
+#include "tcp.h"
+#include "ring.h"
+#include "stats.h"
 
 typedef struct zlog_rule_s zlog_rule_t;
 
 typedef int (*zlog_rule_output_fn) (zlog_rule_t * a_rule, zlog_thread_t * a_thread);
 
 struct zlog_rule_s {
+	char line[MAXLEN_CFG_LINE + 1];	/* as in conf, a reload keeps the rule of the same */
+	int refs;	/* confs holding it, 2 while a reload keeps it */
+
 	char category[MAXLEN_CFG_LINE + 1];
 	char compare_char;
 	/* 
@@ -47,27 +58,75 @@ struct zlog_rule_s {
 	int static_fd;
 	dev_t static_dev;
 	ino_t static_ino;
+	size_t async_round;	/* io engine checked the file in this round */
 
 	long archive_max_size;
 	int archive_max_count;
+	long archive_max_bytes;
+	long archive_max_age;
 	char archive_path[MAXLEN_PATH + 1];
 	zc_arraylist_t *archive_specs;
 
-	FILE *pipe_fp;
-	int pipe_fd;
-
-	size_t fsync_period;
-	size_t fsync_count;
+	size_t preallocate;	/* allocate ahead chunk, 0 means off */
+	off_t prealloc_offset;
+	off_t prealloc_end;
+	ino_t prealloc_ino;
+	pthread_mutex_t prealloc_mutex;
+
+	size_t mmap_chunk;	/* write through a mapping, 0 means off */
+	zlog_mapfile_t *mapfile;
+
+	zlog_pipe_t *pipe;
+
+	int tcp_frame;
+	size_t tcp_spool;	/* 0 means [global] pipe buffer */
+	char tcp_overflow[MAXLEN_PATH + 1];
+	long tcp_overflow_max;
+	zlog_tcp_t *tcp;
+
+	size_t fsync_period;	/* kick syncer every n lines */
+	long fsync_interval;	/* syncer wakes up every n ms */
+	size_t fsync_count;	/* lines since last sync, atomic */
+	int sync_fd;		/* only used by syncer */
+	dev_t sync_dev;
+	ino_t sync_ino;
+	char sync_path[MAXLEN_PATH + 1];
+	pthread_mutex_t sync_mutex;
+	int sync_pending;
 
 	zc_arraylist_t *levels;
 	int syslog_facility;
+	int syslog_frame;
+	char syslog_target[MAXLEN_PATH + 1];	/* empty means libc syslog() */
+	zlog_dgram_t *dgram;
 
 	zlog_format_t *format;
 	zlog_rule_output_fn output;
 
 	char record_name[MAXLEN_PATH + 1];
 	char record_path[MAXLEN_PATH + 1];
-	zlog_record_fn record_func;
+	zlog_record_t *record;
+
+	char ring_dump_level[MAXLEN_CFG_LINE + 1];
+	int ring_level;		/* a line of it or higher dumps the ring */
+	int ring_signal;
+	char ring_file[MAXLEN_PATH + 1];	/* empty means in memory */
+	zlog_ring_t *ring;
+
+	long dedup_window;	/* fold repeats of a line in n seconds, 0 means off */
+	pthread_mutex_t dedup_mutex;
+	uint64_t dedup_hash;	/* of the last line, with its level and category */
+	char *dedup_body;	/* of the last line, compared when the hash is the same */
+	size_t dedup_body_size;
+	size_t dedup_len;
+	time_t dedup_start;
+	int dedup_level;
+	char *dedup_category;
+	size_t dedup_category_len;
+	unsigned long dedup_count;	/* repeats folded, not reported yet */
+
+	char name[MAXLEN_CFG_LINE + 1];	/* selector and output, for stats */
+	int stats_slot;	/* of counters in stats blocks */
 };
 
 zlog_rule_t *zlog_rule_new(char * line,
@@ -76,13 +135,40 @@ zlog_rule_t *zlog_rule_new(char * line,
 		zc_arraylist_t * formats,
 		unsigned int file_perms,
 		size_t fsync_period,
+		long fsync_interval,
+		size_t pipe_buffer,
+		long pipe_full_wait,
 		int * time_cache_count);
 
 void zlog_rule_del(zlog_rule_t * a_rule);
 void zlog_rule_profile(zlog_rule_t * a_rule, int flag);
+/* hold the rule for a new conf, with its fds and state, if it fits as is:
+ * the same format and the next time caches. NULL if not */
+zlog_rule_t *zlog_rule_share(zlog_rule_t * a_rule, zlog_format_t * a_format,
+		int * time_cache_count);
+/* held by the conf in use and the new one, during a reload */
+#define zlog_rule_is_shared(a_rule) ((a_rule)->refs > 1)
 int zlog_rule_match_category(zlog_rule_t * a_rule, char *category);
+/* * matches all, aa_ matches aa and aa_xx, others only the same name */
+int zlog_rule_match_category_name(const char *rule_category, const char *category);
 int zlog_rule_is_wastebin(zlog_rule_t * a_rule);
 int zlog_rule_set_record(zlog_rule_t * a_rule, zc_hashtable_t *records);
+/* ZLOG_THREAD_xxx bufs of a thread, the rule outputs with */
+int zlog_rule_thread_needs(zlog_rule_t * a_rule);
 int zlog_rule_output(zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+/* the level of the line is checked by the caller */
+int zlog_rule_output_matched(zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+/* report repeats folded but not reported yet, before the rule goes away */
+void zlog_rule_flush_repeated(zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+/* report repeats whose window ended, a quiet rule does not hold them */
+void zlog_rule_flush_expired(zlog_rule_t * a_rule, zlog_thread_t * a_thread);
+
+/* for io engine */
+int zlog_rule_async_fd(zlog_rule_t * a_rule, size_t round);
+void zlog_rule_async_written(zlog_rule_t * a_rule, int fd, size_t len);
+
+/* for syncer */
+int zlog_rule_sync_start(zlog_rule_t * a_rule);
+int zlog_rule_sync_wait(zlog_rule_t * a_rule);
 
 #endif
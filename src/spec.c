@@ -21,6 +21,7 @@
 #include "conf.h"
 #include "spec.h"
 #include "level_list.h"
+#include "process.h"
 #include "zc_defs.h"
 
 
@@ -47,10 +48,16 @@ void zlog_spec_profile(zlog_spec_t * a_spec, int flag)
 
 static int zlog_spec_write_time(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
-	zlog_time_cache_t * a_cache = a_thread->event->time_caches + a_spec->time_cache_index;
+	zlog_time_cache_t * a_cache;
 	time_t now_sec = a_thread->event->time_stamp.tv_sec;
 	struct tm *time_local = &(a_thread->event->time_local);
 
+	if (!a_thread->event->time_caches && zlog_event_new_time_caches(a_thread->event)) {
+		zc_error("zlog_event_new_time_caches fail");
+		return -1;
+	}
+	a_cache = a_thread->event->time_caches + a_spec->time_cache_index;
+
 	/* the event meet the 1st time_spec in his life cycle */
 	if (!now_sec) {
 		gettimeofday(&(a_thread->event->time_stamp), NULL);
@@ -118,6 +125,7 @@ static int zlog_spec_write_mdc(zlog_spec_t * a_spec, zlog_thread_t * a_thread, z
 {
 	zlog_mdc_kv_t *a_mdc_kv;
 
+	if (!a_thread->mdc) return 0;	/* no zlog_put_mdc() in this thread */
 	a_mdc_kv = zlog_mdc_get_kv(a_thread->mdc, a_spec->mdc_key);
 	if (!a_mdc_kv) {
 		zc_error("zlog_mdc_get_kv key[%s] fail", a_spec->mdc_key);
@@ -180,7 +188,7 @@ static int zlog_spec_write_srcfunc(zlog_spec_t * a_spec, zlog_thread_t * a_threa
 
 static int zlog_spec_write_hostname(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
-	return zlog_buf_append(a_buf, a_thread->event->host_name, a_thread->event->host_name_len);
+	return zlog_buf_append(a_buf, zlog_env_process.host_name, zlog_env_process.host_name_len);
 }
 
 static int zlog_spec_write_newline(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
@@ -195,19 +203,8 @@ static int zlog_spec_write_percent(zlog_spec_t * a_spec, zlog_thread_t * a_threa
 
 static int zlog_spec_write_pid(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
-	/* 1st in event lifecycle */
-	if (!a_thread->event->pid) {
-		a_thread->event->pid = getpid();
-
-		/* compare with previous event */
-		if (a_thread->event->pid != a_thread->event->last_pid) {
-			a_thread->event->last_pid = a_thread->event->pid;
-			a_thread->event->pid_str_len
-				= sprintf(a_thread->event->pid_str, "%u", a_thread->event->pid);
-		}
-	}
-
-	return zlog_buf_append(a_buf, a_thread->event->pid_str, a_thread->event->pid_str_len);
+	/* a child after fork has it set again, by pthread_atfork */
+	return zlog_buf_append(a_buf, zlog_env_process.pid_str, zlog_env_process.pid_str_len);
 }
 
 static int zlog_spec_write_tid_hex(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
@@ -218,6 +215,22 @@ static int zlog_spec_write_tid_hex(zlog_spec_t * a_spec, zlog_thread_t * a_threa
 	return zlog_buf_append(a_buf, a_thread->event->tid_hex_str, a_thread->event->tid_hex_str_len);
 }
 
+static int zlog_spec_write_ktid(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	if (a_thread->event->ktid_pid != zlog_env_process.pid) {
+		zlog_event_set_ktid(a_thread->event, zlog_env_process.pid);
+	}
+	return zlog_buf_append(a_buf, a_thread->event->ktid_str, a_thread->event->ktid_str_len);
+}
+
+static int zlog_spec_write_thread_name(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
+{
+	if (a_thread->event->thread_name_stale) {
+		zlog_event_set_thread_name(a_thread->event);
+	}
+	return zlog_buf_append(a_buf, a_thread->event->thread_name, a_thread->event->thread_name_len);
+}
+
 static int zlog_spec_write_tid_long(zlog_spec_t * a_spec, zlog_thread_t * a_thread, zlog_buf_t * a_buf)
 {
 
@@ -613,6 +626,12 @@ zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_next, int *time_c
 		case 'T':
 			a_spec->write_buf = zlog_spec_write_tid_long;
 			break;
+		case 'k':
+			a_spec->write_buf = zlog_spec_write_ktid;
+			break;
+		case 'N':
+			a_spec->write_buf = zlog_spec_write_thread_name;
+			break;
 		case '%':
 			a_spec->write_buf = zlog_spec_write_percent;
 			break;
@@ -643,3 +662,11 @@ err:
 	return NULL;
 }
 
+
+/*******************************************************************************/
+int zlog_spec_time_cache_index(zlog_spec_t * a_spec)
+{
+	zc_assert(a_spec, -1);
+	if (a_spec->write_buf != zlog_spec_write_time) return -1;
+	return a_spec->time_cache_index;
+}
@@ -46,6 +46,8 @@ struct zlog_spec_s {
 zlog_spec_t *zlog_spec_new(char *pattern_start, char **pattern_end, int * time_cache_count);
 void zlog_spec_del(zlog_spec_t * a_spec);
 void zlog_spec_profile(zlog_spec_t * a_spec, int flag);
+/* the time cache of a %d or %D, -1 for other specs */
+int zlog_spec_time_cache_index(zlog_spec_t * a_spec);
 
 #define zlog_spec_gen_msg(a_spec, a_thread) \
 	a_spec->gen_msg(a_spec, a_thread)
@@ -56,4 +58,8 @@ void zlog_spec_profile(zlog_spec_t * a_spec, int flag);
 #define zlog_spec_gen_archive_path(a_spec, a_thread) \
 	a_spec->gen_archive_path(a_spec, a_thread)
 
+/* %-10m and the like, go through a pre buf of the thread */
+#define zlog_spec_is_reformat(a_spec) \
+	((a_spec)->print_fmt[0] != '\0')
+
 #endif
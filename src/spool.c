@@ -0,0 +1,255 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "zc_defs.h"
+#include "spool.h"
+
+/* all spools, so a forked child can reset them */
+static pthread_mutex_t zlog_spools_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zlog_spool_t *zlog_spools;
+static pthread_once_t zlog_spool_once = PTHREAD_ONCE_INIT;
+
+static void zlog_spool_prepare(void)
+{
+	pthread_mutex_lock(&zlog_spools_mutex);
+}
+
+static void zlog_spool_parent(void)
+{
+	pthread_mutex_unlock(&zlog_spools_mutex);
+}
+
+/* the consumer and writers waiting are not in the child.
+ * what is in the buffers was put by the parent and is written by it,
+ * the child starts empty, or lines would be written twice
+ */
+static void zlog_spool_child(void)
+{
+	zlog_spool_t *a_spool;
+
+	pthread_mutex_init(&zlog_spools_mutex, NULL);
+	for (a_spool = zlog_spools; a_spool; a_spool = a_spool->next) {
+		pthread_mutex_init(&(a_spool->lock_mutex), NULL);
+		pthread_cond_init(&(a_spool->not_full), NULL);
+		pthread_cond_init(&(a_spool->drained), NULL);
+		a_spool->inherited += a_spool->put_seq - a_spool->done_seq;
+		a_spool->done_seq = a_spool->put_seq;
+		a_spool->len[0] = a_spool->len[1] = 0;
+		a_spool->count[0] = a_spool->count[1] = 0;
+		a_spool->active = 0;
+		a_spool->taken = 0;
+	}
+}
+
+static void zlog_spool_atfork(void)
+{
+	pthread_atfork(zlog_spool_prepare, zlog_spool_parent, zlog_spool_child);
+}
+
+void zlog_spool_profile(zlog_spool_t * a_spool, int flag)
+{
+	zc_assert(a_spool,);
+	zc_profile(flag, "--spool[%p][%ld][%ld,%ld][put %ld,done %ld,waits %ld,dropped %ld,inherited %ld]--",
+		a_spool,
+		(long)a_spool->size,
+		(long)a_spool->len[0],
+		(long)a_spool->len[1],
+		(long)a_spool->put_seq,
+		(long)a_spool->done_seq,
+		(long)a_spool->waits,
+		(long)a_spool->dropped,
+		(long)a_spool->inherited);
+	return;
+}
+
+/*******************************************************************************/
+void zlog_spool_del(zlog_spool_t * a_spool)
+{
+	zc_assert(a_spool,);
+
+	pthread_mutex_lock(&zlog_spools_mutex);
+	if (a_spool->prev) a_spool->prev->next = a_spool->next;
+	else if (zlog_spools == a_spool) zlog_spools = a_spool->next;
+	if (a_spool->next) a_spool->next->prev = a_spool->prev;
+	pthread_mutex_unlock(&zlog_spools_mutex);
+
+	if (a_spool->buf[0]) free(a_spool->buf[0]);
+	if (a_spool->buf[1]) free(a_spool->buf[1]);
+	pthread_cond_destroy(&(a_spool->drained));
+	pthread_cond_destroy(&(a_spool->not_full));
+	pthread_mutex_destroy(&(a_spool->lock_mutex));
+	free(a_spool);
+	zc_debug("zlog_spool_del[%p]", a_spool);
+	return;
+}
+
+zlog_spool_t *zlog_spool_new(size_t size)
+{
+	zlog_spool_t *a_spool;
+
+	pthread_once(&zlog_spool_once, zlog_spool_atfork);
+
+	a_spool = calloc(1, sizeof(zlog_spool_t));
+	if (!a_spool) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	/* for sure init, as del destroys them */
+	pthread_mutex_init(&(a_spool->lock_mutex), NULL);
+	pthread_cond_init(&(a_spool->not_full), NULL);
+	pthread_cond_init(&(a_spool->drained), NULL);
+
+	a_spool->size = size;
+	a_spool->buf[0] = malloc(size);
+	a_spool->buf[1] = malloc(size);
+	if (!a_spool->buf[0] || !a_spool->buf[1]) {
+		zc_error("malloc fail, errno[%d]", errno);
+		zlog_spool_del(a_spool);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&zlog_spools_mutex);
+	a_spool->next = zlog_spools;
+	if (zlog_spools) zlog_spools->prev = a_spool;
+	zlog_spools = a_spool;
+	pthread_mutex_unlock(&zlog_spools_mutex);
+
+	zlog_spool_profile(a_spool, ZC_DEBUG);
+	return a_spool;
+}
+
+/*******************************************************************************/
+int zlog_spool_putv(zlog_spool_t * a_spool, void *owner,
+		const struct iovec *iov, int iovcnt, long wait_ms)
+{
+	int i;
+	int rc = 0;
+	size_t len = 0;
+	size_t need;
+	char *p;
+	zlog_spool_rec_t *a_rec;
+	struct timespec ts;
+	struct timeval now;
+
+	for (i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+
+	need = zlog_spool_rec_size(len);
+	if (need > a_spool->size) {
+		zc_error("msg len[%ld] > spool size[%ld]", (long)len, (long)a_spool->size);
+		return -1;
+	}
+
+	if (wait_ms > 0) {
+		gettimeofday(&now, NULL);
+		ts.tv_sec = now.tv_sec + wait_ms / 1000;
+		ts.tv_nsec = now.tv_usec * 1000 + (wait_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&(a_spool->lock_mutex));
+	while (a_spool->len[a_spool->active] + need > a_spool->size) {
+		if (wait_ms == 0) {
+			rc = ETIMEDOUT;
+		} else if (wait_ms < 0) {
+			a_spool->waits++;
+			rc = pthread_cond_wait(&(a_spool->not_full), &(a_spool->lock_mutex));
+		} else {
+			a_spool->waits++;
+			rc = pthread_cond_timedwait(&(a_spool->not_full), &(a_spool->lock_mutex), &ts);
+		}
+		if (rc == ETIMEDOUT) {
+			a_spool->dropped++;
+			pthread_mutex_unlock(&(a_spool->lock_mutex));
+			return -1;
+		}
+	}
+
+	a_rec = (zlog_spool_rec_t *)(a_spool->buf[a_spool->active] + a_spool->len[a_spool->active]);
+	a_rec->owner = owner;
+	a_rec->len = len;
+	for (i = 0, p = a_rec->data; i < iovcnt; p += iov[i].iov_len, i++) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+	}
+
+	rc = (a_spool->len[a_spool->active] == 0);
+	a_spool->len[a_spool->active] += need;
+	a_spool->count[a_spool->active]++;
+	a_spool->put_seq++;
+	pthread_mutex_unlock(&(a_spool->lock_mutex));
+
+	return rc;
+}
+
+int zlog_spool_put(zlog_spool_t * a_spool, void *owner,
+		const char *data, size_t len, long wait_ms)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+	return zlog_spool_putv(a_spool, owner, &iov, 1, wait_ms);
+}
+
+char *zlog_spool_take(zlog_spool_t * a_spool, size_t *len)
+{
+	char *batch = NULL;
+
+	pthread_mutex_lock(&(a_spool->lock_mutex));
+	if (!a_spool->taken && a_spool->len[a_spool->active]) {
+		batch = a_spool->buf[a_spool->active];
+		*len = a_spool->len[a_spool->active];
+		a_spool->active ^= 1;
+		a_spool->taken = 1;
+		/* the other one is empty, room for writers */
+		pthread_cond_broadcast(&(a_spool->not_full));
+	}
+	pthread_mutex_unlock(&(a_spool->lock_mutex));
+
+	return batch;
+}
+
+void zlog_spool_done(zlog_spool_t * a_spool)
+{
+	int idx;
+
+	pthread_mutex_lock(&(a_spool->lock_mutex));
+	idx = a_spool->active ^ 1;
+	a_spool->done_seq += a_spool->count[idx];
+	a_spool->len[idx] = 0;
+	a_spool->count[idx] = 0;
+	a_spool->taken = 0;
+	pthread_cond_broadcast(&(a_spool->drained));
+	pthread_mutex_unlock(&(a_spool->lock_mutex));
+	return;
+}
+
+void zlog_spool_drain(zlog_spool_t * a_spool)
+{
+	size_t target;
+
+	pthread_mutex_lock(&(a_spool->lock_mutex));
+	target = a_spool->put_seq;
+	while (a_spool->done_seq < target) {
+		pthread_cond_wait(&(a_spool->drained), &(a_spool->lock_mutex));
+	}
+	pthread_mutex_unlock(&(a_spool->lock_mutex));
+	return;
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_spool_h
+#define __zlog_spool_h
+
+/* spool, is a bounded queue of messages between writers and one consumer.
+ * it is two buffers, writers append copies of messages to the active one,
+ * the consumer swaps them and works on a whole batch without lock.
+ * order of put is kept.
+ * in a forked child the locks are made again, and messages the parent
+ * put are left to the parent's consumer, counted in inherited.
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+typedef struct zlog_spool_rec_s {
+	void *owner;		/* rule or whatever the consumer knows */
+	size_t len;
+	char data[1];
+} zlog_spool_rec_t;
+
+typedef struct zlog_spool_s {
+	pthread_mutex_t lock_mutex;
+	pthread_cond_t not_full;
+	pthread_cond_t drained;
+
+	size_t size;		/* of each buffer */
+	char *buf[2];
+	size_t len[2];
+	size_t count[2];
+	int active;		/* writers append to buf[active] */
+	int taken;		/* buf[!active] is with the consumer */
+
+	size_t put_seq;
+	size_t done_seq;
+	size_t waits;		/* times a writer waited for room */
+	size_t dropped;
+	size_t inherited;	/* messages of the parent, not done in a child */
+
+	struct zlog_spool_s *prev;
+	struct zlog_spool_s *next;
+} zlog_spool_t;
+
+#define zlog_spool_rec_size(len) \
+	((offsetof(zlog_spool_rec_t, data) + (len) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+#define zlog_spool_foreach(batch, batch_len, a_rec) \
+	for (a_rec = (zlog_spool_rec_t *)(batch); \
+		(char *)a_rec < (batch) + (batch_len); \
+		a_rec = (zlog_spool_rec_t *)((char *)a_rec + zlog_spool_rec_size(a_rec->len)))
+
+zlog_spool_t *zlog_spool_new(size_t size);
+void zlog_spool_del(zlog_spool_t * a_spool);
+void zlog_spool_profile(zlog_spool_t * a_spool, int flag);
+
+/* wait_ms < 0 wait until there is room, 0 never wait.
+ * return 1 the batch was empty, consumer should be kicked
+ * return 0 put, -1 dropped
+ */
+int zlog_spool_put(zlog_spool_t * a_spool, void *owner,
+		const char *data, size_t len, long wait_ms);
+/* same, the record is the iovecs one after another */
+int zlog_spool_putv(zlog_spool_t * a_spool, void *owner,
+		const struct iovec *iov, int iovcnt, long wait_ms);
+
+/* consumer only, NULL if nothing */
+char *zlog_spool_take(zlog_spool_t * a_spool, size_t *len);
+void zlog_spool_done(zlog_spool_t * a_spool);
+
+/* wait until messages put before are done, the consumer must be kicked */
+void zlog_spool_drain(zlog_spool_t * a_spool);
+
+#endif
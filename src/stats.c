@@ -0,0 +1,357 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+#include "zc_defs.h"
+
+/* blocks of living threads, and counters of threads gone */
+static pthread_mutex_t zlog_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zlog_stats_block_t *zlog_stats_blocks;
+static zlog_stats_block_t zlog_stats_retired;
+/* slots taken by categories and rules */
+static unsigned char *zlog_stats_slots_used;
+static size_t zlog_stats_slot_max;
+
+/*******************************************************************************/
+unsigned long long zlog_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* 0-3 one bucket each, then 4 buckets for each power of 2 */
+static int zlog_stats_bucket(unsigned long long ns)
+{
+	int msb;
+
+	if (ns < 4) return (int)ns;
+	msb = 63 - __builtin_clzll(ns);
+	return (msb - 1) * 4 + (int)((ns >> (msb - 2)) & 3);
+}
+
+/* the largest ns in bucket i */
+static unsigned long long zlog_stats_bucket_top(int i)
+{
+	int msb;
+
+	if (i < 4) return i;
+	msb = i / 4 + 1;
+	return ((unsigned long long)(4 + i % 4 + 1) << (msb - 2)) - 1;
+}
+
+void zlog_stats_hist_add(zlog_stats_hist_t * a_hist, unsigned long long ns)
+{
+	int i = zlog_stats_bucket(ns);
+
+	zlog_stats_add(a_hist->buckets[i], 1);
+	zlog_stats_add(a_hist->count, 1);
+	zlog_stats_add(a_hist->sum, ns);
+	if (ns > a_hist->max) __atomic_store_n(&(a_hist->max), ns, __ATOMIC_RELAXED);
+	return;
+}
+
+unsigned long long zlog_stats_percentile(const zlog_stats_hist_t * a_hist, double percent)
+{
+	int i;
+	unsigned long long seen = 0;
+	unsigned long long rank;
+
+	if (!a_hist->count) return 0;
+	rank = (unsigned long long)(a_hist->count * percent / 100.0);
+	if (rank >= a_hist->count) rank = a_hist->count - 1;
+
+	for (i = 0; i < ZLOG_STATS_BUCKETS; i++) {
+		seen += a_hist->buckets[i];
+		if (seen > rank) break;
+	}
+	if (i == ZLOG_STATS_BUCKETS) return a_hist->max;
+	/* never more than what was seen */
+	return zlog_stats_bucket_top(i) < a_hist->max ? zlog_stats_bucket_top(i) : a_hist->max;
+}
+
+/*******************************************************************************/
+int zlog_stats_slot_new(void)
+{
+	size_t i;
+	size_t max;
+	unsigned char *used;
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	for (i = 0; i < zlog_stats_slot_max; i++) {
+		if (!zlog_stats_slots_used[i]) break;
+	}
+	if (i == zlog_stats_slot_max) {
+		max = zlog_stats_slot_max ? zlog_stats_slot_max * 2 : 64;
+		used = realloc(zlog_stats_slots_used, max);
+		if (!used) {
+			pthread_mutex_unlock(&zlog_stats_mutex);
+			zc_error("realloc fail, errno[%d]", errno);
+			return -1;
+		}
+		memset(used + zlog_stats_slot_max, 0x00, max - zlog_stats_slot_max);
+		zlog_stats_slots_used = used;
+		zlog_stats_slot_max = max;
+	}
+	zlog_stats_slots_used[i] = 1;
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	return (int)i;
+}
+
+/* no thread writes a slot of a category or a rule being deleted,
+ * as they are deleted under the write lock of zlog
+ */
+void zlog_stats_slot_del(int slot)
+{
+	zlog_stats_block_t *a_block;
+
+	if (slot < 0) return;
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	if ((size_t)slot < zlog_stats_slot_max) zlog_stats_slots_used[slot] = 0;
+	if ((size_t)slot < zlog_stats_retired.slot_count) {
+		memset(zlog_stats_retired.slots + slot, 0x00, sizeof(zlog_stats_counter_t));
+	}
+	for (a_block = zlog_stats_blocks; a_block; a_block = a_block->next) {
+		if ((size_t)slot < a_block->slot_count) {
+			memset(a_block->slots + slot, 0x00, sizeof(zlog_stats_counter_t));
+		}
+	}
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	return;
+}
+
+/* under the mutex */
+static int zlog_stats_block_fit(zlog_stats_block_t * a_block, size_t slot_count)
+{
+	size_t count;
+	zlog_stats_counter_t *slots;
+
+	if (slot_count <= a_block->slot_count) return 0;
+
+	count = a_block->slot_count ? a_block->slot_count : 16;
+	while (count < slot_count) count *= 2;
+	slots = realloc(a_block->slots, count * sizeof(zlog_stats_counter_t));
+	if (!slots) {
+		zc_error("realloc fail, errno[%d]", errno);
+		return -1;
+	}
+	memset(slots + a_block->slot_count, 0x00,
+		(count - a_block->slot_count) * sizeof(zlog_stats_counter_t));
+	a_block->slots = slots;
+	a_block->slot_count = count;
+	return 0;
+}
+
+zlog_stats_counter_t *zlog_stats_block_grow(zlog_stats_block_t * a_block, int slot)
+{
+	int rc;
+
+	if (slot < 0) return NULL;
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	rc = zlog_stats_block_fit(a_block, (size_t)slot + 1);
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	if (rc) return NULL;
+	return a_block->slots + slot;
+}
+
+/*******************************************************************************/
+zlog_stats_block_t *zlog_stats_block_new(void)
+{
+	zlog_stats_block_t *a_block;
+
+	a_block = calloc(1, sizeof(zlog_stats_block_t));
+	if (!a_block) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	a_block->next = zlog_stats_blocks;
+	if (zlog_stats_blocks) zlog_stats_blocks->prev = a_block;
+	zlog_stats_blocks = a_block;
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	return a_block;
+}
+
+static void zlog_stats_hist_merge(zlog_stats_hist_t * a_to, const zlog_stats_hist_t * a_from)
+{
+	int i;
+
+	for (i = 0; i < ZLOG_STATS_BUCKETS; i++) {
+		a_to->buckets[i] += __atomic_load_n(&(a_from->buckets[i]), __ATOMIC_RELAXED);
+	}
+	a_to->count += __atomic_load_n(&(a_from->count), __ATOMIC_RELAXED);
+	a_to->sum += __atomic_load_n(&(a_from->sum), __ATOMIC_RELAXED);
+	if (a_from->max > a_to->max) a_to->max = a_from->max;
+	return;
+}
+
+#define zlog_stats_merge(a_to, a_from) do { \
+	int j_; \
+	(a_to)->lines += __atomic_load_n(&((a_from)->lines), __ATOMIC_RELAXED); \
+	(a_to)->bytes += __atomic_load_n(&((a_from)->bytes), __ATOMIC_RELAXED); \
+	(a_to)->errors += __atomic_load_n(&((a_from)->errors), __ATOMIC_RELAXED); \
+	(a_to)->truncates += __atomic_load_n(&((a_from)->truncates), __ATOMIC_RELAXED); \
+	for (j_ = 0; j_ < 256; j_++) { \
+		(a_to)->levels[j_] += __atomic_load_n(&((a_from)->levels[j_]), __ATOMIC_RELAXED); \
+	} \
+	zlog_stats_hist_merge(&((a_to)->format), &((a_from)->format)); \
+	zlog_stats_hist_merge(&((a_to)->output), &((a_from)->output)); \
+} while (0)
+
+#define zlog_stats_counter_merge(a_to, a_from) do { \
+	(a_to)->lines += __atomic_load_n(&((a_from)->lines), __ATOMIC_RELAXED); \
+	(a_to)->bytes += __atomic_load_n(&((a_from)->bytes), __ATOMIC_RELAXED); \
+	(a_to)->errors += __atomic_load_n(&((a_from)->errors), __ATOMIC_RELAXED); \
+} while (0)
+
+void zlog_stats_block_del(zlog_stats_block_t * a_block)
+{
+	size_t i;
+
+	zc_assert(a_block,);
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	zlog_stats_merge(&zlog_stats_retired, a_block);
+	if (zlog_stats_block_fit(&zlog_stats_retired, a_block->slot_count)) {
+		zc_warn("counters of categories and rules by a thread gone are lost");
+	} else {
+		for (i = 0; i < a_block->slot_count; i++) {
+			zlog_stats_counter_merge(zlog_stats_retired.slots + i, a_block->slots + i);
+		}
+	}
+	if (a_block->prev) a_block->prev->next = a_block->next;
+	else zlog_stats_blocks = a_block->next;
+	if (a_block->next) a_block->next->prev = a_block->prev;
+	pthread_mutex_unlock(&zlog_stats_mutex);
+
+	if (a_block->slots) free(a_block->slots);
+	free(a_block);
+	return;
+}
+
+void zlog_stats_sum(zlog_stats_t * a_stats)
+{
+	zlog_stats_block_t *a_block;
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	zlog_stats_merge(a_stats, &zlog_stats_retired);
+	for (a_block = zlog_stats_blocks; a_block; a_block = a_block->next) {
+		zlog_stats_merge(a_stats, a_block);
+	}
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	return;
+}
+
+void zlog_stats_slot_get(int slot, zlog_stats_count_t * a_count, const char *name)
+{
+	zlog_stats_block_t *a_block;
+
+	snprintf(a_count->name, sizeof(a_count->name), "%s", name);
+	a_count->lines = 0;
+	a_count->bytes = 0;
+	a_count->errors = 0;
+	if (slot < 0) return;
+
+	pthread_mutex_lock(&zlog_stats_mutex);
+	if ((size_t)slot < zlog_stats_retired.slot_count) {
+		zlog_stats_counter_merge(a_count, zlog_stats_retired.slots + slot);
+	}
+	for (a_block = zlog_stats_blocks; a_block; a_block = a_block->next) {
+		if ((size_t)slot < a_block->slot_count) {
+			zlog_stats_counter_merge(a_count, a_block->slots + slot);
+		}
+	}
+	pthread_mutex_unlock(&zlog_stats_mutex);
+	return;
+}
+
+void zlog_stats_free(zlog_stats_t * a_stats)
+{
+	zc_assert(a_stats,);
+
+	if (a_stats->categories) free(a_stats->categories);
+	if (a_stats->rules) free(a_stats->rules);
+	a_stats->categories = NULL;
+	a_stats->rules = NULL;
+	a_stats->category_count = 0;
+	a_stats->rule_count = 0;
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_stats_print_hist(FILE * fp, const char *name, zlog_stats_hist_t * a_hist)
+{
+	fprintf(fp, " %s[count:%llu avg:%llu p50:%llu p99:%llu p999:%llu max:%llu]",
+		name, a_hist->count,
+		a_hist->count ? a_hist->sum / a_hist->count : 0,
+		zlog_stats_percentile(a_hist, 50),
+		zlog_stats_percentile(a_hist, 99),
+		zlog_stats_percentile(a_hist, 99.9),
+		a_hist->max);
+	return;
+}
+
+static void zlog_stats_print_count(FILE * fp, const char *kind, zlog_stats_count_t * a_count)
+{
+	fprintf(fp, "  %s[%s] lines[%llu] bytes[%llu] errors[%llu]\n",
+		kind, a_count->name, a_count->lines, a_count->bytes, a_count->errors);
+	return;
+}
+
+int zlog_stats_print(zlog_stats_t * a_stats, const char *path)
+{
+	size_t i;
+	FILE *fp;
+	time_t now;
+	struct tm tm;
+	char stamp[32];
+
+	fp = fopen(path, "a");
+	if (!fp) {
+		zc_error("fopen[%s] fail, errno[%d]", path, errno);
+		return -1;
+	}
+
+	now = time(NULL);
+	localtime_r(&now, &tm);
+	strftime(stamp, sizeof(stamp), "%F %T", &tm);
+	fprintf(fp, "%s lines[%llu] bytes[%llu] errors[%llu] truncates[%llu]",
+		stamp, a_stats->lines, a_stats->bytes, a_stats->errors, a_stats->truncates);
+	zlog_stats_print_hist(fp, "format_ns", &(a_stats->format));
+	zlog_stats_print_hist(fp, "output_ns", &(a_stats->output));
+	fprintf(fp, "\n  levels");
+	for (i = 0; i < 256; i++) {
+		if (a_stats->levels[i]) fprintf(fp, " %ld[%llu]", (long)i, a_stats->levels[i]);
+	}
+	fprintf(fp, "\n");
+	for (i = 0; i < a_stats->category_count; i++) {
+		zlog_stats_print_count(fp, "category", a_stats->categories + i);
+	}
+	for (i = 0; i < a_stats->rule_count; i++) {
+		zlog_stats_print_count(fp, "rule", a_stats->rules + i);
+	}
+
+	if (fclose(fp)) {
+		zc_error("fclose[%s] fail, errno[%d]", path, errno);
+		return -1;
+	}
+	return 0;
+}
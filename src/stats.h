@@ -0,0 +1,118 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_stats_h
+#define __zlog_stats_h
+
+/* stats, are counters of lines written, turned on by [global] stats = true.
+ * each thread has a block only it writes, with plain stores, no lock.
+ * a category or a rule has a slot, its counters are at that index in
+ * the slots of each block, so no line writes a cache line of another.
+ * zlog_stats_snapshot() sums blocks of living threads, and what threads
+ * gone left in the retired block.
+ * latency is kept in log linear histograms, 4 buckets per power of 2 ns,
+ * so a percentile is off by 25% at most.
+ */
+
+#include "zc_defs.h"
+
+/* same as in zlog.h */
+#define ZLOG_STATS_BUCKETS 256
+#define ZLOG_STATS_NAME_LEN 256
+
+typedef struct zlog_stats_hist_s {
+	unsigned long long count;
+	unsigned long long sum;
+	unsigned long long max;
+	unsigned long long buckets[ZLOG_STATS_BUCKETS];
+} zlog_stats_hist_t;
+
+typedef struct zlog_stats_count_s {
+	char name[ZLOG_STATS_NAME_LEN];
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+} zlog_stats_count_t;
+
+typedef struct zlog_stats_s {
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+	unsigned long long truncates;
+	unsigned long long levels[256];
+	zlog_stats_hist_t format;
+	zlog_stats_hist_t output;
+	size_t category_count;
+	zlog_stats_count_t *categories;
+	size_t rule_count;
+	zlog_stats_count_t *rules;
+} zlog_stats_t;
+/* end of same as in zlog.h */
+
+/* counters of a category or a rule */
+typedef struct zlog_stats_counter_s {
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+} zlog_stats_counter_t;
+
+typedef struct zlog_stats_block_s {
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+	unsigned long long truncates;
+	unsigned long long levels[256];
+	zlog_stats_hist_t format;
+	zlog_stats_hist_t output;
+
+	/* by category and rule slot, grown by the owner under the mutex */
+	zlog_stats_counter_t *slots;
+	size_t slot_count;
+
+	/* of the rule being output */
+	unsigned long long formats;	/* zlog_format_gen_msg() calls */
+	unsigned long long format_ns;
+
+	struct zlog_stats_block_s *prev;
+	struct zlog_stats_block_s *next;
+} zlog_stats_block_t;
+
+/* registered, so snapshots see it */
+zlog_stats_block_t *zlog_stats_block_new(void);
+/* counters go to the retired block */
+void zlog_stats_block_del(zlog_stats_block_t * a_block);
+
+#define zlog_stats_add(field, n) \
+	__atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+
+/* a slot for a category or a rule, -1 if out of memory */
+int zlog_stats_slot_new(void);
+/* counters of the slot are cleared in all blocks, for the next one got */
+void zlog_stats_slot_del(int slot);
+
+/* counters of the slot in a_block, NULL if slot is -1 or out of memory */
+zlog_stats_counter_t *zlog_stats_block_grow(zlog_stats_block_t * a_block, int slot);
+#define zlog_stats_slot(a_block, slot) \
+	((size_t)(slot) < (a_block)->slot_count ? \
+		(a_block)->slots + (slot) : zlog_stats_block_grow(a_block, slot))
+
+/* monotonic ns */
+unsigned long long zlog_stats_now(void);
+/* only by the thread owning the block */
+void zlog_stats_hist_add(zlog_stats_hist_t * a_hist, unsigned long long ns);
+unsigned long long zlog_stats_percentile(const zlog_stats_hist_t * a_hist, double percent);
+
+/* add up blocks of all threads to a_stats */
+void zlog_stats_sum(zlog_stats_t * a_stats);
+/* add up the slot in blocks of all threads */
+void zlog_stats_slot_get(int slot, zlog_stats_count_t * a_count, const char *name);
+/* append a_stats as text to file path */
+int zlog_stats_print(zlog_stats_t * a_stats, const char *path);
+void zlog_stats_free(zlog_stats_t * a_stats);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "rule.h"
+#include "syncer.h"
+
+void zlog_syncer_profile(zlog_syncer_t * a_syncer, int flag)
+{
+	zc_assert(a_syncer,);
+	zc_profile(flag, "--syncer[%p][%ld][rounds %ld,synced %ld]--",
+		a_syncer,
+		a_syncer->interval,
+		(long)a_syncer->rounds,
+		(long)a_syncer->synced);
+	if (a_syncer->worker) zlog_worker_profile(a_syncer->worker, flag);
+	return;
+}
+
+/*******************************************************************************/
+static int zlog_syncer_round(zlog_syncer_t * a_syncer, int force)
+{
+	int i;
+	int rc = 0;
+	zlog_rule_t *a_rule;
+
+	pthread_mutex_lock(&(a_syncer->round_mutex));
+
+	/* lines written after the count is taken belong to next round */
+	zc_arraylist_foreach(a_syncer->rules, i, a_rule) {
+		/* in the middle of a reload, the syncer of the conf in use
+		 * has it, the lines are left for the one that stays */
+		if (zlog_rule_is_shared(a_rule)) continue;
+		a_rule->sync_pending = 0;
+		if (!__sync_lock_test_and_set(&(a_rule->fsync_count), 0) && !force) continue;
+
+		switch (zlog_rule_sync_start(a_rule)) {
+		case 0:
+			a_rule->sync_pending = 1;
+			break;
+		case 1:
+			/* not a file, or O_SYNC */
+			break;
+		default:
+			zc_error("zlog_rule_sync_start fail");
+			rc = -1;
+			break;
+		}
+	}
+
+	zc_arraylist_foreach(a_syncer->rules, i, a_rule) {
+		if (zlog_rule_is_shared(a_rule) || !a_rule->sync_pending) continue;
+		if (zlog_rule_sync_wait(a_rule)) {
+			zc_error("zlog_rule_sync_wait fail");
+			rc = -1;
+			continue;
+		}
+		a_syncer->synced++;
+	}
+	a_syncer->rounds++;
+
+	pthread_mutex_unlock(&(a_syncer->round_mutex));
+	return rc;
+}
+
+static void zlog_syncer_run(void *arg)
+{
+	zlog_syncer_round(arg, 0);
+	return;
+}
+
+/*******************************************************************************/
+void zlog_syncer_del(zlog_syncer_t * a_syncer)
+{
+	zc_assert(a_syncer,);
+
+	/* worker does a last round before it stops */
+	if (a_syncer->worker) zlog_worker_del(a_syncer->worker);
+	pthread_mutex_destroy(&(a_syncer->round_mutex));
+	free(a_syncer);
+	zc_debug("zlog_syncer_del[%p]", a_syncer);
+	return;
+}
+
+zlog_syncer_t *zlog_syncer_new(zc_arraylist_t *rules, long interval)
+{
+	zlog_syncer_t *a_syncer;
+
+	zc_assert(rules, NULL);
+
+	a_syncer = calloc(1, sizeof(zlog_syncer_t));
+	if (!a_syncer) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_syncer->rules = rules;
+	a_syncer->interval = interval;
+
+	if (pthread_mutex_init(&(a_syncer->round_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		free(a_syncer);
+		return NULL;
+	}
+
+	/* thread is not started until the first dirty line */
+	a_syncer->worker = zlog_worker_new("syncer", interval, 0, zlog_syncer_run, a_syncer);
+	if (!a_syncer->worker) {
+		zc_error("zlog_worker_new fail");
+		zlog_syncer_del(a_syncer);
+		return NULL;
+	}
+
+	zlog_syncer_profile(a_syncer, ZC_DEBUG);
+	return a_syncer;
+}
+
+/*******************************************************************************/
+int zlog_syncer_start(zlog_syncer_t * a_syncer)
+{
+	return zlog_worker_start(a_syncer->worker);
+}
+
+/* rules kept from the last conf may have lines not synced yet */
+int zlog_syncer_resume(zlog_syncer_t * a_syncer)
+{
+	int i;
+	zlog_rule_t *a_rule;
+
+	zc_arraylist_foreach(a_syncer->rules, i, a_rule) {
+		if (__atomic_load_n(&(a_rule->fsync_count), __ATOMIC_RELAXED)) {
+			return zlog_syncer_start(a_syncer);
+		}
+	}
+	return 0;
+}
+
+void zlog_syncer_kick(zlog_syncer_t * a_syncer)
+{
+	zlog_worker_kick(a_syncer->worker);
+	return;
+}
+
+int zlog_syncer_sync(zlog_syncer_t * a_syncer)
+{
+	return zlog_syncer_round(a_syncer, 1);
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_syncer_h
+#define __zlog_syncer_h
+
+/* syncer, makes file rules durable in the background.
+ * writers only count lines and kick it when fsync period is reached,
+ * it also wakes up every fsync interval.
+ * a round starts writeback of all dirty files first, then waits for each,
+ * so several files are flushed by the disk at the same time.
+ */
+
+#include <pthread.h>
+
+#include "zc_defs.h"
+#include "worker.h"
+
+typedef struct zlog_syncer_s {
+	zc_arraylist_t *rules;	/* not owned, belongs to conf */
+	long interval;		/* ms */
+	pthread_mutex_t round_mutex;
+	zlog_worker_t *worker;
+
+	size_t rounds;
+	size_t synced;
+} zlog_syncer_t;
+
+zlog_syncer_t *zlog_syncer_new(zc_arraylist_t *rules, long interval);
+void zlog_syncer_del(zlog_syncer_t * a_syncer);
+void zlog_syncer_profile(zlog_syncer_t * a_syncer, int flag);
+
+/* from writers, cheap */
+int zlog_syncer_start(zlog_syncer_t * a_syncer);
+void zlog_syncer_kick(zlog_syncer_t * a_syncer);
+/* after a reload, start if a rule kept has lines to sync */
+int zlog_syncer_resume(zlog_syncer_t * a_syncer);
+
+/* barrier, all rules are synced when return, even if not dirty */
+int zlog_syncer_sync(zlog_syncer_t * a_syncer);
+
+#endif
@@ -0,0 +1,692 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+#include "zc_defs.h"
+#include "tcp.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* iovecs of one sendmsg */
+#define ZLOG_TCP_IOV 1024
+#define ZLOG_TCP_RETRY_MAX 32
+#define ZLOG_TCP_REPLAY_MIN (64 * 1024)
+#define ZLOG_TCP_REPLAY_MAX (64 * 1024 * 1024)
+#define ZLOG_TCP_OVERFLOW_MAX (1024L * 1024 * 1024)
+
+void zlog_tcp_profile(zlog_tcp_t * a_tcp, int flag)
+{
+	zc_assert(a_tcp,);
+	zc_profile(flag, "--tcp[%p][%s][%d][%s,%ld][%d][%ld,%ld,%ld,%ld,%ld]--",
+		a_tcp,
+		a_tcp->target,
+		a_tcp->frame,
+		a_tcp->overflow,
+		a_tcp->overflow_max,
+		a_tcp->fd,
+		(long)a_tcp->sent,
+		(long)a_tcp->sends,
+		(long)a_tcp->connects,
+		(long)a_tcp->spilled,
+		(long)a_tcp->lost);
+	if (a_tcp->spool) zlog_spool_profile(a_tcp->spool, flag);
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_tcp_retry_later(zlog_tcp_t * a_tcp)
+{
+	a_tcp->retry_at = time(NULL) + a_tcp->retry_delay;
+	if (a_tcp->retry_delay < ZLOG_TCP_RETRY_MAX) a_tcp->retry_delay *= 2;
+	return;
+}
+
+static int zlog_tcp_connect(zlog_tcp_t * a_tcp, int stop)
+{
+	int rc;
+	int fd = -1;
+	int err;
+	int on = 1;
+	socklen_t err_len;
+	char host[MAXLEN_PATH + 1];
+	char *port;
+	char *p;
+	struct addrinfo hints;
+	struct addrinfo *res;
+	struct addrinfo *ai;
+	struct pollfd pfd;
+
+	/* at fini, one more try anyway */
+	if (!stop && time(NULL) < a_tcp->retry_at) return -1;
+
+	strcpy(host, a_tcp->target);
+	port = strrchr(host, ':');
+	*port++ = '\0';
+	p = host;
+	if (*p == '[') {
+		/* [::1]:5140 */
+		p++;
+		if (port - host >= 3 && *(port - 2) == ']') *(port - 2) = '\0';
+	}
+
+	memset(&hints, 0x00, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	rc = getaddrinfo(p, port, &hints, &res);
+	if (rc) {
+		zc_warn("getaddrinfo [%s] fail, rc[%d]", a_tcp->target, rc);
+		zlog_tcp_retry_later(a_tcp);
+		return -1;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0) continue;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+		if (errno == EINPROGRESS) {
+			/* do not hang the sender on a black hole */
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			err = ETIMEDOUT;
+			err_len = sizeof(err);
+			if (poll(&pfd, 1, 1000) == 1) {
+				getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+			}
+			if (err == 0) break;
+			errno = err;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0) {
+		zc_warn("connect [%s] fail, errno[%d]", a_tcp->target, errno);
+		zlog_tcp_retry_later(a_tcp);
+		return -1;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+	a_tcp->fd = fd;
+	a_tcp->retry_delay = 1;
+	a_tcp->connects++;
+	zc_debug("connect [%s] ok, fd[%d]", a_tcp->target, fd);
+	return 0;
+}
+
+static void zlog_tcp_close(zlog_tcp_t * a_tcp)
+{
+	if (a_tcp->fd >= 0) close(a_tcp->fd);
+	a_tcp->fd = -1;
+	zlog_tcp_retry_later(a_tcp);
+	return;
+}
+
+/*******************************************************************************/
+/* send iovecs, *done is how many of them are all out
+ * return 0 all sent, -1 collector gone, or stuck at fini
+ */
+static int zlog_tcp_sendv(zlog_tcp_t * a_tcp, struct iovec *iov, int count, int *done)
+{
+	int i = 0;
+	ssize_t rc;
+	struct msghdr msg;
+	struct pollfd pfd;
+
+	*done = 0;
+	while (i < count) {
+		memset(&msg, 0x00, sizeof(msg));
+		msg.msg_iov = iov + i;
+		msg.msg_iovlen = count - i;
+		rc = sendmsg(a_tcp->fd, &msg, MSG_NOSIGNAL);
+		if (rc >= 0) {
+			a_tcp->sends++;
+			a_tcp->sent += rc;
+			for (; i < count && (size_t)rc >= iov[i].iov_len; i++) {
+				rc -= iov[i].iov_len;
+			}
+			if (rc > 0) {
+				iov[i].iov_base = (char *)iov[i].iov_base + rc;
+				iov[i].iov_len -= rc;
+			}
+			*done = i;
+			continue;
+		}
+
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			pfd.fd = a_tcp->fd;
+			pfd.events = POLLOUT;
+			if (poll(&pfd, 1, 1000) == 0
+				&& __atomic_load_n(&(a_tcp->worker->stop), __ATOMIC_SEQ_CST)) {
+				zc_warn("collector [%s] reads nothing, give up", a_tcp->target);
+				return -1;
+			}
+			continue;
+		}
+
+		zc_warn("send to [%s] fail, errno[%d]", a_tcp->target, errno);
+		return -1;
+	}
+	return 0;
+}
+
+/* the batch taken from spool, a line cut by a broken connection
+ * is sent again as a whole
+ */
+static int zlog_tcp_send_hold(zlog_tcp_t * a_tcp)
+{
+	int i;
+	int n;
+	int done;
+	int rc;
+	size_t pos;
+	size_t rec_size[ZLOG_TCP_IOV];
+	zlog_spool_rec_t *a_rec;
+	struct iovec iov[ZLOG_TCP_IOV];
+
+	while (a_tcp->hold_pos < a_tcp->hold_len) {
+		n = 0;
+		for (pos = a_tcp->hold_pos; pos < a_tcp->hold_len && n < ZLOG_TCP_IOV; n++) {
+			a_rec = (zlog_spool_rec_t *)(a_tcp->hold + pos);
+			iov[n].iov_base = a_rec->data;
+			iov[n].iov_len = a_rec->len;
+			rec_size[n] = zlog_spool_rec_size(a_rec->len);
+			pos += rec_size[n];
+		}
+
+		rc = zlog_tcp_sendv(a_tcp, iov, n, &done);
+		for (i = 0; i < done; i++) a_tcp->hold_pos += rec_size[i];
+		if (rc) return -1;
+	}
+	return 0;
+}
+
+/* iovecs of whole lines in buf, return count of them */
+static int zlog_tcp_split(zlog_tcp_t * a_tcp, char *buf, size_t len, struct iovec *iov)
+{
+	int n = 0;
+	size_t pos = 0;
+	size_t rec;
+	uint32_t net;
+	char *p;
+
+	while (n < ZLOG_TCP_IOV && pos < len) {
+		if (a_tcp->frame == ZLOG_TCP_LEN) {
+			if (len - pos < sizeof(net)) break;
+			memcpy(&net, buf + pos, sizeof(net));
+			rec = sizeof(net) + ntohl(net);
+			if (len - pos < rec) break;
+		} else {
+			p = memchr(buf + pos, '\n', len - pos);
+			if (!p) break;
+			rec = p - (buf + pos) + 1;
+		}
+		iov[n].iov_base = buf + pos;
+		iov[n].iov_len = rec;
+		n++;
+		pos += rec;
+	}
+	return n;
+}
+
+/* send the overflow file from replay_pos, when it is all sent,
+ * empty it and let writers use the spool again.
+ * return 0 all sent, -1 collector gone
+ */
+static int zlog_tcp_replay(zlog_tcp_t * a_tcp)
+{
+	int i;
+	int n;
+	int done;
+	int rc;
+	long end;
+	size_t len;
+	ssize_t nread;
+	char *buf;
+	struct iovec iov[ZLOG_TCP_IOV];
+	size_t rec_len[ZLOG_TCP_IOV];
+
+	if (!a_tcp->replay_buf) {
+		a_tcp->replay_size = a_tcp->spool->size;
+		if (a_tcp->replay_size < ZLOG_TCP_REPLAY_MIN) a_tcp->replay_size = ZLOG_TCP_REPLAY_MIN;
+		a_tcp->replay_buf = malloc(a_tcp->replay_size);
+		if (!a_tcp->replay_buf) {
+			zc_error("malloc fail, errno[%d]", errno);
+			return -1;
+		}
+	}
+
+	for (;;) {
+		/* only whole lines are below overflow_size */
+		end = __atomic_load_n(&(a_tcp->overflow_size), __ATOMIC_SEQ_CST);
+		if (a_tcp->replay_pos >= end) {
+			pthread_mutex_lock(&(a_tcp->overflow_mutex));
+			if (a_tcp->replay_pos >= a_tcp->overflow_size) {
+				if (ftruncate(a_tcp->overflow_fd, 0)) {
+					zc_error("ftruncate [%s] fail, errno[%d]", a_tcp->overflow, errno);
+				}
+				a_tcp->overflow_size = 0;
+				a_tcp->replay_pos = 0;
+				__atomic_store_n(&(a_tcp->spilling), 0, __ATOMIC_SEQ_CST);
+				pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+				return 0;
+			}
+			pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+			continue;
+		}
+
+		len = end - a_tcp->replay_pos;
+		if (len > a_tcp->replay_size) len = a_tcp->replay_size;
+		nread = pread(a_tcp->overflow_fd, a_tcp->replay_buf, len, a_tcp->replay_pos);
+		if (nread <= 0) {
+			zc_error("read [%s] fail, errno[%d], lines in it are lost", a_tcp->overflow, errno);
+			a_tcp->lost++;
+			a_tcp->replay_pos = end;
+			continue;
+		}
+
+		n = zlog_tcp_split(a_tcp, a_tcp->replay_buf, nread, iov);
+		if (n == 0) {
+			if ((size_t)nread == a_tcp->replay_size
+				&& a_tcp->replay_size < ZLOG_TCP_REPLAY_MAX) {
+				/* a line longer than the buffer */
+				buf = realloc(a_tcp->replay_buf, a_tcp->replay_size * 2);
+				if (buf) {
+					a_tcp->replay_buf = buf;
+					a_tcp->replay_size *= 2;
+					continue;
+				}
+			}
+			/* cut by a crash, or not made by us */
+			zc_error("broken line in [%s] at [%ld], rest of it is lost",
+				a_tcp->overflow, a_tcp->replay_pos);
+			a_tcp->lost++;
+			a_tcp->replay_pos = end;
+			continue;
+		}
+
+		for (i = 0; i < n; i++) rec_len[i] = iov[i].iov_len;
+		rc = zlog_tcp_sendv(a_tcp, iov, n, &done);
+		for (i = 0; i < done; i++) a_tcp->replay_pos += rec_len[i];
+		if (rc) return -1;
+	}
+}
+
+/*******************************************************************************/
+/* writers and sender both need the file, open it at the first line,
+ * not in new, as the rule of the old conf may still save to it
+ */
+static int zlog_tcp_overflow_open(zlog_tcp_t * a_tcp)
+{
+	int fd;
+	int left = 0;
+	struct stat stb;
+
+	pthread_mutex_lock(&(a_tcp->overflow_mutex));
+	if (a_tcp->overflow_fd != -1) goto exit;
+
+	fd = open(a_tcp->overflow, O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (fd < 0 || fstat(fd, &stb)) {
+		zc_error("open [%s] fail, errno[%d], no overflow", a_tcp->overflow, errno);
+		if (fd >= 0) close(fd);
+		__atomic_store_n(&(a_tcp->overflow_fd), -2, __ATOMIC_SEQ_CST);
+		goto exit;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	a_tcp->overflow_size = stb.st_size;
+	/* left by last run, they go before any new line */
+	if (stb.st_size > 0) {
+		__atomic_store_n(&(a_tcp->spilling), 1, __ATOMIC_SEQ_CST);
+		left = 1;
+	}
+	__atomic_store_n(&(a_tcp->overflow_fd), fd, __ATOMIC_SEQ_CST);
+exit:
+	pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+
+	if (left) {
+		if (zlog_worker_start(a_tcp->worker)) {
+			zc_error("zlog_worker_start fail");
+			return -1;
+		}
+		zlog_worker_kick(a_tcp->worker);
+	}
+	return 0;
+}
+
+static int zlog_tcp_spill(zlog_tcp_t * a_tcp, struct iovec *iov, int iovcnt, size_t len)
+{
+	int spilling;
+	ssize_t rc;
+
+	pthread_mutex_lock(&(a_tcp->overflow_mutex));
+	if (a_tcp->overflow_size + (long)len > a_tcp->overflow_max) {
+		pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+		__sync_fetch_and_add(&(a_tcp->lost), 1);
+		return 0;
+	}
+
+	rc = writev(a_tcp->overflow_fd, iov, iovcnt);
+	if (rc != (ssize_t)len) {
+		zc_error("writev [%s] fail, errno[%d]", a_tcp->overflow, errno);
+		/* keep the file made of whole lines */
+		if (rc > 0 && ftruncate(a_tcp->overflow_fd, a_tcp->overflow_size)) {
+			zc_error("ftruncate [%s] fail, errno[%d]", a_tcp->overflow, errno);
+		}
+		pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+		__sync_fetch_and_add(&(a_tcp->lost), 1);
+		return 0;
+	}
+	__atomic_store_n(&(a_tcp->overflow_size), a_tcp->overflow_size + len, __ATOMIC_SEQ_CST);
+	a_tcp->spilled++;
+	spilling = __atomic_exchange_n(&(a_tcp->spilling), 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&(a_tcp->overflow_mutex));
+
+	/* the sender sends the file after the spool */
+	if (!spilling) {
+		if (zlog_worker_start(a_tcp->worker)) {
+			zc_error("zlog_worker_start fail");
+			return -1;
+		}
+		zlog_worker_kick(a_tcp->worker);
+	}
+	return 0;
+}
+
+static size_t zlog_tcp_hold_lines(zlog_tcp_t * a_tcp)
+{
+	size_t count = 0;
+	size_t pos;
+	zlog_spool_rec_t *a_rec;
+
+	for (pos = a_tcp->hold_pos; pos < a_tcp->hold_len; count++) {
+		a_rec = (zlog_spool_rec_t *)(a_tcp->hold + pos);
+		pos += zlog_spool_rec_size(a_rec->len);
+	}
+	return count;
+}
+
+static void zlog_tcp_hold_next(zlog_tcp_t * a_tcp)
+{
+	zlog_spool_done(a_tcp->spool);
+	a_tcp->hold = zlog_spool_take(a_tcp->spool, &(a_tcp->hold_len));
+	a_tcp->hold_pos = 0;
+	return;
+}
+
+/* at fini, what is not sent is saved to the overflow file, in order.
+ * spool lines are older than lines in the file, but lines of last run
+ * in a file never opened are older than both
+ */
+static void zlog_tcp_save(zlog_tcp_t * a_tcp)
+{
+	int fd;
+	ssize_t nread;
+	char buf[4096];
+	char path[MAXLEN_PATH + 8];
+	zlog_spool_rec_t *a_rec;
+
+	if (!a_tcp->hold) {
+		a_tcp->hold = zlog_spool_take(a_tcp->spool, &(a_tcp->hold_len));
+		a_tcp->hold_pos = 0;
+	}
+	if (!a_tcp->hold && a_tcp->replay_pos == 0) return;
+
+	if (a_tcp->overflow[0] == '\0' || a_tcp->overflow_fd == -2) {
+		for (; a_tcp->hold; zlog_tcp_hold_next(a_tcp)) {
+			a_tcp->lost += zlog_tcp_hold_lines(a_tcp);
+		}
+		zc_warn("[%s] not reached, [%ld] lines lost", a_tcp->target, (long)a_tcp->lost);
+		return;
+	}
+
+	if (a_tcp->overflow_fd == -1) {
+		snprintf(path, sizeof(path), "%s", a_tcp->overflow);
+		fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	} else {
+		snprintf(path, sizeof(path), "%s.tmp", a_tcp->overflow);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	}
+	if (fd < 0) {
+		zc_error("open [%s] fail, errno[%d]", path, errno);
+		for (; a_tcp->hold; zlog_tcp_hold_next(a_tcp)) {
+			a_tcp->lost += zlog_tcp_hold_lines(a_tcp);
+		}
+		return;
+	}
+
+	for (; a_tcp->hold; zlog_tcp_hold_next(a_tcp)) {
+		for (; a_tcp->hold_pos < a_tcp->hold_len;
+			a_tcp->hold_pos += zlog_spool_rec_size(a_rec->len)) {
+			a_rec = (zlog_spool_rec_t *)(a_tcp->hold + a_tcp->hold_pos);
+			if (write(fd, a_rec->data, a_rec->len) != (ssize_t)a_rec->len) {
+				zc_error("write [%s] fail, errno[%d]", path, errno);
+				a_tcp->lost++;
+			}
+		}
+	}
+
+	if (a_tcp->overflow_fd >= 0) {
+		/* lines in the old file not sent yet */
+		while ((nread = pread(a_tcp->overflow_fd, buf, sizeof(buf), a_tcp->replay_pos)) > 0) {
+			if (write(fd, buf, nread) != nread) {
+				zc_error("write [%s] fail, errno[%d]", path, errno);
+				break;
+			}
+			a_tcp->replay_pos += nread;
+		}
+		if (rename(path, a_tcp->overflow)) {
+			zc_error("rename [%s] fail, errno[%d]", path, errno);
+		}
+	}
+	close(fd);
+	zc_debug("lines not sent to [%s] saved in [%s]", a_tcp->target, a_tcp->overflow);
+	return;
+}
+
+/*******************************************************************************/
+static void zlog_tcp_run(void *arg)
+{
+	int stop;
+	zlog_tcp_t *a_tcp = arg;
+
+	stop = __atomic_load_n(&(a_tcp->worker->stop), __ATOMIC_SEQ_CST);
+
+	/* forked, the connection and the batch held are the parent's */
+	if (a_tcp->pid != getpid()) {
+		if (a_tcp->fd >= 0) close(a_tcp->fd);
+		a_tcp->fd = -1;
+		a_tcp->hold = NULL;
+		a_tcp->pid = getpid();
+	}
+
+	for (;;) {
+		if (!a_tcp->hold) {
+			a_tcp->hold = zlog_spool_take(a_tcp->spool, &(a_tcp->hold_len));
+			a_tcp->hold_pos = 0;
+		}
+		if (!a_tcp->hold && !__atomic_load_n(&(a_tcp->spilling), __ATOMIC_SEQ_CST)) break;
+
+		/* the batch is kept until the collector is back */
+		if (a_tcp->fd < 0 && zlog_tcp_connect(a_tcp, stop)) break;
+
+		if (a_tcp->hold) {
+			if (zlog_tcp_send_hold(a_tcp)) {
+				zlog_tcp_close(a_tcp);
+				break;
+			}
+			a_tcp->hold = NULL;
+			zlog_spool_done(a_tcp->spool);
+		} else if (zlog_tcp_replay(a_tcp)) {
+			zlog_tcp_close(a_tcp);
+			break;
+		}
+	}
+
+	if (stop) zlog_tcp_save(a_tcp);
+	return;
+}
+
+/*******************************************************************************/
+int zlog_tcp_write(zlog_tcp_t * a_tcp, const char *buf, size_t len)
+{
+	int rc;
+	int iovcnt = 0;
+	size_t total = 0;
+	uint32_t net;
+	struct iovec iov[3];
+
+	if (a_tcp->frame == ZLOG_TCP_LEN) {
+		net = htonl((uint32_t)len);
+		iov[iovcnt].iov_base = &net;
+		iov[iovcnt].iov_len = sizeof(net);
+		iovcnt++;
+		total += sizeof(net);
+	}
+	iov[iovcnt].iov_base = (char *)buf;
+	iov[iovcnt].iov_len = len;
+	iovcnt++;
+	total += len;
+	if (a_tcp->frame == ZLOG_TCP_LINE && (len == 0 || buf[len - 1] != '\n')) {
+		iov[iovcnt].iov_base = "\n";
+		iov[iovcnt].iov_len = 1;
+		iovcnt++;
+		total++;
+	}
+
+	if (a_tcp->overflow[0] != '\0'
+		&& __atomic_load_n(&(a_tcp->overflow_fd), __ATOMIC_SEQ_CST) == -1) {
+		if (zlog_tcp_overflow_open(a_tcp)) return -1;
+	}
+
+	/* before the put, a forked child has no sender yet */
+	if (zlog_worker_start(a_tcp->worker)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+
+	if (!__atomic_load_n(&(a_tcp->spilling), __ATOMIC_SEQ_CST)) {
+		rc = zlog_spool_putv(a_tcp->spool, a_tcp, iov, iovcnt, 0);
+		if (rc == 1) {
+			zlog_worker_kick(a_tcp->worker);
+			return 0;
+		} else if (rc == 0) {
+			return 0;
+		}
+		if (__atomic_load_n(&(a_tcp->overflow_fd), __ATOMIC_SEQ_CST) < 0) {
+			if (zlog_spool_rec_size(total) > a_tcp->spool->size) {
+				zc_error("zlog_spool_putv fail");
+				return -1;
+			}
+			/* dropped, counted by spool */
+			return 0;
+		}
+	}
+
+	return zlog_tcp_spill(a_tcp, iov, iovcnt, total);
+}
+
+/*******************************************************************************/
+void zlog_tcp_del(zlog_tcp_t * a_tcp)
+{
+	zc_assert(a_tcp,);
+
+	/* sender sends or saves the rest before it stops */
+	if (a_tcp->worker) zlog_worker_del(a_tcp->worker);
+	if (a_tcp->spool) zlog_spool_del(a_tcp->spool);
+
+	if (a_tcp->fd >= 0) close(a_tcp->fd);
+	if (a_tcp->overflow_fd >= 0) close(a_tcp->overflow_fd);
+	if (a_tcp->replay_buf) free(a_tcp->replay_buf);
+	pthread_mutex_destroy(&(a_tcp->overflow_mutex));
+
+	free(a_tcp);
+	zc_debug("zlog_tcp_del[%p]", a_tcp);
+	return;
+}
+
+zlog_tcp_t *zlog_tcp_new(const char *target, int frame, size_t spool_size,
+		const char *overflow, long overflow_max)
+{
+	zlog_tcp_t *a_tcp;
+
+	zc_assert(target, NULL);
+
+	a_tcp = calloc(1, sizeof(zlog_tcp_t));
+	if (!a_tcp) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+	a_tcp->pid = getpid();
+	a_tcp->fd = -1;
+	a_tcp->overflow_fd = -1;
+	a_tcp->retry_delay = 1;
+	a_tcp->frame = frame;
+	a_tcp->overflow_max = overflow_max > 0 ? overflow_max : ZLOG_TCP_OVERFLOW_MAX;
+	pthread_mutex_init(&(a_tcp->overflow_mutex), NULL);
+
+	if (strlen(target) > sizeof(a_tcp->target) - 1) {
+		zc_error("target[%s] too long", target);
+		goto err;
+	}
+	strcpy(a_tcp->target, target);
+	if (!strrchr(target, ':')) {
+		zc_error("no port in [%s]", target);
+		goto err;
+	}
+
+	if (overflow) {
+		if (strlen(overflow) > sizeof(a_tcp->overflow) - 1) {
+			zc_error("overflow[%s] too long", overflow);
+			goto err;
+		}
+		strcpy(a_tcp->overflow, overflow);
+	}
+
+	a_tcp->spool = zlog_spool_new(spool_size);
+	if (!a_tcp->spool) {
+		zc_error("zlog_spool_new fail");
+		goto err;
+	}
+
+	/* thread is not started until the first line, retries every second */
+	a_tcp->worker = zlog_worker_new("tcp", 1000, 0, zlog_tcp_run, a_tcp);
+	if (!a_tcp->worker) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
+	zlog_tcp_profile(a_tcp, ZC_DEBUG);
+	return a_tcp;
+err:
+	zlog_tcp_del(a_tcp);
+	return NULL;
+}
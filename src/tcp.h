@@ -0,0 +1,81 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_tcp_h
+#define __zlog_tcp_h
+
+/* tcp, is the streaming output of rules like
+ *	my_cat.*	tcp://loghost:5140, frame=len overflow=/var/spool/my.tcp
+ * writers copy framed lines into a bounded spool and return.
+ * a sender thread connects, and sends a batch with one sendmsg(),
+ * when the collector is gone, it connects again, 1s, 2s ... 32s later.
+ * a batch being sent is kept until it is all out, so nothing is lost
+ * in a collector restart. when the spool is full, lines go to the
+ * overflow file if there is one, or are dropped, and from then on
+ * to the file, until the sender has sent the whole file.
+ * what is not sent at zlog_fini() is saved in the overflow file,
+ * and sent first the next time.
+ */
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "zc_defs.h"
+#include "spool.h"
+#include "worker.h"
+
+#define ZLOG_TCP_LINE 0		/* a line ends with \n */
+#define ZLOG_TCP_LEN 1		/* 4 bytes big endian length before a line */
+
+typedef struct zlog_tcp_s {
+	char target[MAXLEN_PATH + 1];	/* host:port */
+	int frame;
+
+	zlog_spool_t *spool;
+	zlog_worker_t *worker;
+
+	/* overflow file, empty path means none */
+	char overflow[MAXLEN_PATH + 1];
+	long overflow_max;
+	pthread_mutex_t overflow_mutex;
+	int overflow_fd;
+	long overflow_size;
+	int spilling;		/* writers go to the file, atomic */
+
+	/* only used by sender */
+	pid_t pid;		/* process fd and hold belong to */
+	int fd;
+	time_t retry_at;
+	int retry_delay;
+	char *hold;		/* batch taken from spool, not all sent */
+	size_t hold_len;
+	size_t hold_pos;	/* start of the first line not sent */
+	char *replay_buf;
+	size_t replay_size;
+	long replay_pos;	/* of overflow file */
+
+	size_t sent;
+	size_t sends;		/* sendmsg calls */
+	size_t connects;
+	size_t spilled;
+	size_t lost;		/* dropped after spool is full, or at fini */
+} zlog_tcp_t;
+
+/* target	host:port
+ * overflow	NULL or "" for none
+ */
+zlog_tcp_t *zlog_tcp_new(const char *target, int frame, size_t spool_size,
+		const char *overflow, long overflow_max);
+void zlog_tcp_del(zlog_tcp_t * a_tcp);
+void zlog_tcp_profile(zlog_tcp_t * a_tcp, int flag);
+
+/* return 0 queued, spilled or dropped, -1 fail */
+int zlog_tcp_write(zlog_tcp_t * a_tcp, const char *buf, size_t len);
+
+#endif
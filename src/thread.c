@@ -18,8 +18,9 @@
 void zlog_thread_profile(zlog_thread_t * a_thread, int flag)
 {
 	zc_assert(a_thread,);
-	zc_profile(flag, "--thread[%p][%p][%p][%p,%p,%p,%p,%p]--",
+	zc_profile(flag, "--thread[%p][level set %d][%p][%p][%p,%p,%p,%p,%p]--",
 			a_thread,
+			a_thread->level_set,
 			a_thread->mdc,
 			a_thread->event,
 			a_thread->pre_path_buf,
@@ -28,12 +29,12 @@ void zlog_thread_profile(zlog_thread_t * a_thread, int flag)
 			a_thread->pre_msg_buf,
 			a_thread->msg_buf);
 
-	zlog_mdc_profile(a_thread->mdc, flag);
+	if (a_thread->mdc) zlog_mdc_profile(a_thread->mdc, flag);
 	zlog_event_profile(a_thread->event, flag);
-	zlog_buf_profile(a_thread->pre_path_buf, flag);
-	zlog_buf_profile(a_thread->path_buf, flag);
-	zlog_buf_profile(a_thread->archive_path_buf, flag);
-	zlog_buf_profile(a_thread->pre_msg_buf, flag);
+	if (a_thread->pre_path_buf) zlog_buf_profile(a_thread->pre_path_buf, flag);
+	if (a_thread->path_buf) zlog_buf_profile(a_thread->path_buf, flag);
+	if (a_thread->archive_path_buf) zlog_buf_profile(a_thread->archive_path_buf, flag);
+	if (a_thread->pre_msg_buf) zlog_buf_profile(a_thread->pre_msg_buf, flag);
 	zlog_buf_profile(a_thread->msg_buf, flag);
 	return;
 }
@@ -55,13 +56,17 @@ void zlog_thread_del(zlog_thread_t * a_thread)
 		zlog_buf_del(a_thread->pre_msg_buf);
 	if (a_thread->msg_buf)
 		zlog_buf_del(a_thread->msg_buf);
+	if (a_thread->stats)
+		zlog_stats_block_del(a_thread->stats);
+	zlog_thread_set_level(a_thread, -1);
 
 	free(a_thread);
 	zc_debug("zlog_thread_del[%p]", a_thread);
 	return;
 }
 
-zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf_size_max, int time_cache_count)
+zlog_thread_t *zlog_thread_new(int init_version, int needs,
+		size_t buf_size_min, size_t buf_size_max, int time_cache_count)
 {
 	zlog_thread_t *a_thread;
 
@@ -72,12 +77,7 @@ zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf
 	}
 
 	a_thread->init_version = init_version;
-
-	a_thread->mdc = zlog_mdc_new();
-	if (!a_thread->mdc) {
-		zc_error("zlog_mdc_new fail");
-		goto err;
-	}
+	a_thread->level_set = -1;
 
 	a_thread->event = zlog_event_new(time_cache_count);
 	if (!a_thread->event) {
@@ -85,37 +85,16 @@ zlog_thread_t *zlog_thread_new(int init_version, size_t buf_size_min, size_t buf
 		goto err;
 	}
 
-	a_thread->pre_path_buf = zlog_buf_new(MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL);
-	if (!a_thread->pre_path_buf) {
-		zc_error("zlog_buf_new fail");
-		goto err;
-	}
-
-	a_thread->path_buf = zlog_buf_new(MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL);
-	if (!a_thread->path_buf) {
-		zc_error("zlog_buf_new fail");
-		goto err;
-	}
-
-	a_thread->archive_path_buf = zlog_buf_new(MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL);
-	if (!a_thread->archive_path_buf) {
-		zc_error("zlog_buf_new fail");
-		goto err;
-	}
-
-	a_thread->pre_msg_buf = zlog_buf_new(buf_size_min, buf_size_max, "..." FILE_NEWLINE);
-	if (!a_thread->pre_msg_buf) {
-		zc_error("zlog_buf_new fail");
+	if (zlog_thread_rebuild_msg_buf(a_thread, needs, buf_size_min, buf_size_max)) {
+		zc_error("zlog_thread_rebuild_msg_buf fail");
 		goto err;
 	}
 
-	a_thread->msg_buf = zlog_buf_new(buf_size_min, buf_size_max, "..." FILE_NEWLINE);
-	if (!a_thread->msg_buf) {
-		zc_error("zlog_buf_new fail");
+	if (zlog_thread_rebuild_path_buf(a_thread, needs)) {
+		zc_error("zlog_thread_rebuild_path_buf fail");
 		goto err;
 	}
 
-
 	//zlog_thread_profile(a_thread, ZC_DEBUG);
 	return a_thread;
 err:
@@ -124,41 +103,61 @@ err:
 }
 
 /*******************************************************************************/
-int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, size_t buf_size_min, size_t buf_size_max)
+/* a buf of min and max if need, else none */
+static int zlog_thread_rebuild_buf(zlog_buf_t ** a_buf, int need,
+		size_t buf_size_min, size_t buf_size_max, const char *truncate_str)
 {
-	zlog_buf_t *pre_msg_buf_new = NULL;
-	zlog_buf_t *msg_buf_new = NULL;
-	zc_assert(a_thread, -1);
+	zlog_buf_t *buf_new;
 
-	if ( (a_thread->msg_buf->size_min == buf_size_min)
-		&& (a_thread->msg_buf->size_max == buf_size_max)) {
-		zc_debug("buf size not changed, no need rebuild");
+	if (!need) {
+		if (*a_buf) zlog_buf_del(*a_buf);
+		*a_buf = NULL;
 		return 0;
 	}
 
-	pre_msg_buf_new = zlog_buf_new(buf_size_min, buf_size_max, "..." FILE_NEWLINE);
-	if (!pre_msg_buf_new) {
-		zc_error("zlog_buf_new fail");
-		goto err;
+	if (*a_buf && (*a_buf)->size_min == buf_size_min && (*a_buf)->size_max == buf_size_max) {
+		return 0;
 	}
 
-	msg_buf_new = zlog_buf_new(buf_size_min, buf_size_max, "..." FILE_NEWLINE);
-	if (!msg_buf_new) {
+	buf_new = zlog_buf_new(buf_size_min, buf_size_max, truncate_str);
+	if (!buf_new) {
 		zc_error("zlog_buf_new fail");
-		goto err;
+		return -1;
 	}
+	if (*a_buf) zlog_buf_del(*a_buf);
+	*a_buf = buf_new;
+	return 0;
+}
 
-	zlog_buf_del(a_thread->pre_msg_buf);
-	a_thread->pre_msg_buf = pre_msg_buf_new;
+int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, int needs,
+		size_t buf_size_min, size_t buf_size_max)
+{
+	zc_assert(a_thread, -1);
 
-	zlog_buf_del(a_thread->msg_buf);
-	a_thread->msg_buf = msg_buf_new;
+	if (zlog_thread_rebuild_buf(&(a_thread->msg_buf), 1,
+			buf_size_min, buf_size_max, "..." FILE_NEWLINE)
+		|| zlog_thread_rebuild_buf(&(a_thread->pre_msg_buf), needs & ZLOG_THREAD_PRE_MSG,
+			buf_size_min, buf_size_max, "..." FILE_NEWLINE)) {
+		zc_error("zlog_thread_rebuild_buf fail");
+		return -1;
+	}
+	return 0;
+}
+
+int zlog_thread_rebuild_path_buf(zlog_thread_t * a_thread, int needs)
+{
+	zc_assert(a_thread, -1);
 
+	if (zlog_thread_rebuild_buf(&(a_thread->path_buf), needs & ZLOG_THREAD_PATH,
+			MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL)
+		|| zlog_thread_rebuild_buf(&(a_thread->pre_path_buf), needs & ZLOG_THREAD_PRE_PATH,
+			MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL)
+		|| zlog_thread_rebuild_buf(&(a_thread->archive_path_buf), needs & ZLOG_THREAD_ARCHIVE,
+			MAXLEN_PATH + 1, MAXLEN_PATH + 1, NULL)) {
+		zc_error("zlog_thread_rebuild_buf fail");
+		return -1;
+	}
 	return 0;
-err:
-	if (pre_msg_buf_new) zlog_buf_del(pre_msg_buf_new);
-	if (msg_buf_new) zlog_buf_del(msg_buf_new);
-	return -1;
 }
 
 int zlog_thread_rebuild_event(zlog_thread_t * a_thread, int time_cache_count)
@@ -182,3 +181,113 @@ err:
 
 
 /*******************************************************************************/
+/* push is a CAS on the head, pop takes the whole list by exchange,
+ * keeps the first, and pushes the rest back, so no ABA.
+ * a pop meeting an empty list in between just news a state.
+ */
+static zlog_thread_t *zlog_thread_pool;
+static size_t zlog_thread_pool_count;
+static size_t zlog_thread_pool_max;
+
+static void zlog_thread_pool_push(zlog_thread_t * first, zlog_thread_t * last)
+{
+	zlog_thread_t *head = __atomic_load_n(&zlog_thread_pool, __ATOMIC_RELAXED);
+
+	do {
+		last->next = head;
+	} while (!__atomic_compare_exchange_n(&zlog_thread_pool, &head, first,
+			1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return;
+}
+
+void zlog_thread_recycle(zlog_thread_t * a_thread)
+{
+	if (!a_thread) return;
+
+	if (__atomic_fetch_add(&zlog_thread_pool_count, 1, __ATOMIC_RELAXED)
+			>= __atomic_load_n(&zlog_thread_pool_max, __ATOMIC_RELAXED)) {
+		__atomic_fetch_sub(&zlog_thread_pool_count, 1, __ATOMIC_RELAXED);
+		zlog_thread_del(a_thread);
+		return;
+	}
+
+	if (a_thread->mdc) zlog_mdc_clean(a_thread->mdc);
+	/* the next thread does not trace as this one did */
+	zlog_thread_set_level(a_thread, -1);
+	/* counters of the thread go to the retired block */
+	zlog_thread_set_stats(a_thread, 0);
+	zlog_thread_pool_push(a_thread, a_thread);
+	return;
+}
+
+zlog_thread_t *zlog_thread_reuse(void)
+{
+	zlog_thread_t *a_thread;
+	zlog_thread_t *last;
+
+	if (!__atomic_load_n(&zlog_thread_pool, __ATOMIC_RELAXED)) return NULL;
+	a_thread = __atomic_exchange_n(&zlog_thread_pool, NULL, __ATOMIC_ACQUIRE);
+	if (!a_thread) return NULL;
+
+	if (a_thread->next) {
+		for (last = a_thread->next; last->next; last = last->next) ;
+		zlog_thread_pool_push(a_thread->next, last);
+	}
+	__atomic_fetch_sub(&zlog_thread_pool_count, 1, __ATOMIC_RELAXED);
+
+	a_thread->next = NULL;
+	zlog_event_set_tid(a_thread->event);
+	return a_thread;
+}
+
+void zlog_thread_pool_set_max(size_t max)
+{
+	__atomic_store_n(&zlog_thread_pool_max, max, __ATOMIC_RELAXED);
+	if (!max) zlog_thread_pool_clean();
+	return;
+}
+
+void zlog_thread_pool_clean(void)
+{
+	zlog_thread_t *a_thread;
+	zlog_thread_t *next;
+
+	a_thread = __atomic_exchange_n(&zlog_thread_pool, NULL, __ATOMIC_ACQUIRE);
+	for (; a_thread; a_thread = next) {
+		next = a_thread->next;
+		__atomic_fetch_sub(&zlog_thread_pool_count, 1, __ATOMIC_RELAXED);
+		zlog_thread_del(a_thread);
+	}
+	return;
+}
+
+/*******************************************************************************/
+void zlog_thread_set_stats(zlog_thread_t * a_thread, int on)
+{
+	zc_assert(a_thread,);
+
+	if (on && !a_thread->stats) {
+		/* no stats of this thread, if it fails */
+		a_thread->stats = zlog_stats_block_new();
+	} else if (!on && a_thread->stats) {
+		zlog_stats_block_del(a_thread->stats);
+		a_thread->stats = NULL;
+	}
+	return;
+}
+
+/*******************************************************************************/
+int zlog_thread_levels;
+
+void zlog_thread_set_level(zlog_thread_t * a_thread, int level)
+{
+	zc_assert(a_thread,);
+
+	if (a_thread->level_set < 0 && level >= 0) {
+		__atomic_fetch_add(&zlog_thread_levels, 1, __ATOMIC_RELAXED);
+	} else if (a_thread->level_set >= 0 && level < 0) {
+		__atomic_fetch_sub(&zlog_thread_levels, 1, __ATOMIC_RELAXED);
+	}
+	a_thread->level_set = level;
+	return;
+}
@@ -13,10 +13,17 @@
 #include "event.h"
 #include "buf.h"
 #include "mdc.h"
+#include "stats.h"
 
-typedef struct {
+/* bufs a thread only has when some rule of the conf needs them */
+#define ZLOG_THREAD_PRE_MSG	0x01	/* reformat of msg, dedup */
+#define ZLOG_THREAD_PATH	0x02	/* dynamic file path */
+#define ZLOG_THREAD_PRE_PATH	0x04	/* reformat of path */
+#define ZLOG_THREAD_ARCHIVE	0x08	/* dynamic archive path */
+
+typedef struct zlog_thread_s {
 	int init_version;
-	zlog_mdc_t *mdc;
+	zlog_mdc_t *mdc;	/* NULL till the first zlog_put_mdc() */
 	zlog_event_t *event;
 
 	zlog_buf_t *pre_path_buf;
@@ -24,15 +31,43 @@ typedef struct {
 	zlog_buf_t *archive_path_buf;
 	zlog_buf_t *pre_msg_buf;
 	zlog_buf_t *msg_buf;
+
+	zlog_stats_block_t *stats;	/* NULL when [global] stats is off */
+	int level_set;	/* by zlog_set_thread_level(), -1 none */
+
+	struct zlog_thread_s *next;	/* in the pool */
 } zlog_thread_t;
 
 
 void zlog_thread_del(zlog_thread_t * a_thread);
 void zlog_thread_profile(zlog_thread_t * a_thread, int flag);
-zlog_thread_t *zlog_thread_new(int init_version,
+zlog_thread_t *zlog_thread_new(int init_version, int needs,
 			size_t buf_size_min, size_t buf_size_max, int time_cache_count);
 
-int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, size_t buf_size_min, size_t buf_size_max);
+int zlog_thread_rebuild_msg_buf(zlog_thread_t * a_thread, int needs,
+			size_t buf_size_min, size_t buf_size_max);
+int zlog_thread_rebuild_path_buf(zlog_thread_t * a_thread, int needs);
 int zlog_thread_rebuild_event(zlog_thread_t * a_thread, int time_cache_count);
+/* on, get a stats block, off, give it back */
+void zlog_thread_set_stats(zlog_thread_t * a_thread, int on);
+
+/* count of threads with a level set, log calls look at their own state
+ * for the level only when it is not 0
+ */
+extern int zlog_thread_levels;
+#define zlog_thread_level_any() \
+	__atomic_load_n(&zlog_thread_levels, __ATOMIC_RELAXED)
+/* -1 resets, lines of level or higher go to all rules of any category */
+void zlog_thread_set_level(zlog_thread_t * a_thread, int level);
+
+/* the pool keeps states of threads gone, up to [global] thread pool,
+ * a new thread takes one, so its first log call needs no malloc.
+ * recycle is the destructor of the thread key.
+ */
+void zlog_thread_recycle(zlog_thread_t * a_thread);
+/* NULL when the pool is empty, else a state bound to the calling thread */
+zlog_thread_t *zlog_thread_reuse(void);
+void zlog_thread_pool_set_max(size_t max);
+void zlog_thread_pool_clean(void);
 
 #endif
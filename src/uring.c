@@ -0,0 +1,515 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ZLOG_HAVE_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include "zc_defs.h"
+#include "rule.h"
+#include "uring.h"
+
+#define ZLOG_URING_ENTRIES 64
+#define ZLOG_URING_IOVS 1024
+
+typedef struct {
+	zlog_rule_t *a_rule;
+	int fd;
+	struct iovec *iov;
+	int iovcnt;
+	size_t total;
+	int res;
+} zlog_uring_req_t;
+
+struct zlog_uring_ring_s {
+	int fd;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	void *sqes;
+	void *cqes;
+	void *sq_ptr;
+	size_t sq_len;
+	void *cq_ptr;
+	size_t cq_len;
+	size_t sqes_len;
+	int cur_pos;		/* offset -1 means current position */
+	int broken;		/* requests may be left in the kernel, get a new ring */
+
+	/* one chunk of linked requests */
+	int nreq;
+	int niov;
+	zlog_uring_req_t reqs[ZLOG_URING_ENTRIES];
+	struct iovec iovs[ZLOG_URING_IOVS];
+};
+
+void zlog_uring_profile(zlog_uring_t * a_uring, int flag)
+{
+	zc_assert(a_uring,);
+	zc_profile(flag, "--uring[%p][%d][batches %ld,submits %ld,fallbacks %ld,losts %ld]--",
+		a_uring,
+		a_uring->ring ? a_uring->ring->fd : -1,
+		(long)a_uring->batches,
+		(long)a_uring->submits,
+		(long)a_uring->fallbacks,
+		(long)a_uring->losts);
+	if (a_uring->spool) zlog_spool_profile(a_uring->spool, flag);
+	if (a_uring->worker) zlog_worker_profile(a_uring->worker, flag);
+	return;
+}
+
+/*******************************************************************************/
+#ifdef ZLOG_HAVE_URING
+
+static void zlog_uring_ring_del(zlog_uring_ring_t * a_ring)
+{
+	if (a_ring->sqes) munmap(a_ring->sqes, a_ring->sqes_len);
+	if (a_ring->cq_ptr && a_ring->cq_ptr != a_ring->sq_ptr) munmap(a_ring->cq_ptr, a_ring->cq_len);
+	if (a_ring->sq_ptr) munmap(a_ring->sq_ptr, a_ring->sq_len);
+	if (a_ring->fd > 0) close(a_ring->fd);
+	free(a_ring);
+	return;
+}
+
+static zlog_uring_ring_t *zlog_uring_ring_new(void)
+{
+	struct io_uring_params p;
+	zlog_uring_ring_t *a_ring;
+
+	a_ring = calloc(1, sizeof(zlog_uring_ring_t));
+	if (!a_ring) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	memset(&p, 0x00, sizeof(p));
+	a_ring->fd = syscall(__NR_io_uring_setup, ZLOG_URING_ENTRIES, &p);
+	if (a_ring->fd < 0) {
+		zc_warn("io_uring_setup fail, errno[%d]", errno);
+		free(a_ring);
+		return NULL;
+	}
+
+	a_ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	a_ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (a_ring->cq_len > a_ring->sq_len) a_ring->sq_len = a_ring->cq_len;
+	}
+
+	a_ring->sq_ptr = mmap(NULL, a_ring->sq_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, a_ring->fd, IORING_OFF_SQ_RING);
+	if (a_ring->sq_ptr == MAP_FAILED) {
+		zc_error("mmap sq fail, errno[%d]", errno);
+		a_ring->sq_ptr = NULL;
+		goto err;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		a_ring->cq_ptr = a_ring->sq_ptr;
+	} else {
+		a_ring->cq_ptr = mmap(NULL, a_ring->cq_len, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, a_ring->fd, IORING_OFF_CQ_RING);
+		if (a_ring->cq_ptr == MAP_FAILED) {
+			zc_error("mmap cq fail, errno[%d]", errno);
+			a_ring->cq_ptr = NULL;
+			goto err;
+		}
+	}
+
+	a_ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	a_ring->sqes = mmap(NULL, a_ring->sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, a_ring->fd, IORING_OFF_SQES);
+	if (a_ring->sqes == MAP_FAILED) {
+		zc_error("mmap sqes fail, errno[%d]", errno);
+		a_ring->sqes = NULL;
+		goto err;
+	}
+
+	a_ring->sq_head = (unsigned *)((char *)a_ring->sq_ptr + p.sq_off.head);
+	a_ring->sq_tail = (unsigned *)((char *)a_ring->sq_ptr + p.sq_off.tail);
+	a_ring->sq_mask = (unsigned *)((char *)a_ring->sq_ptr + p.sq_off.ring_mask);
+	a_ring->sq_array = (unsigned *)((char *)a_ring->sq_ptr + p.sq_off.array);
+	a_ring->cq_head = (unsigned *)((char *)a_ring->cq_ptr + p.cq_off.head);
+	a_ring->cq_tail = (unsigned *)((char *)a_ring->cq_ptr + p.cq_off.tail);
+	a_ring->cq_mask = (unsigned *)((char *)a_ring->cq_ptr + p.cq_off.ring_mask);
+	a_ring->cqes = (char *)a_ring->cq_ptr + p.cq_off.cqes;
+	a_ring->cur_pos = (p.features & IORING_FEAT_RW_CUR_POS) ? 1 : 0;
+
+	return a_ring;
+err:
+	zlog_uring_ring_del(a_ring);
+	return NULL;
+}
+
+static int zlog_uring_ring_broken(zlog_uring_ring_t * a_ring)
+{
+	return a_ring->broken;
+}
+
+/* write what io_uring did not, in order */
+static int zlog_uring_write_rest(zlog_uring_req_t * a_req, size_t skip)
+{
+	int i;
+	char *p;
+	size_t n;
+	ssize_t rc;
+
+	for (i = 0; i < a_req->iovcnt; i++) {
+		if (skip >= a_req->iov[i].iov_len) {
+			skip -= a_req->iov[i].iov_len;
+			continue;
+		}
+		p = (char *)a_req->iov[i].iov_base + skip;
+		n = a_req->iov[i].iov_len - skip;
+		skip = 0;
+		while (n > 0) {
+			rc = write(a_req->fd, p, n);
+			if (rc < 0) {
+				if (errno == EINTR) continue;
+				zc_error("write fail, errno[%d]", errno);
+				return -1;
+			}
+			p += rc;
+			n -= rc;
+		}
+	}
+	return 0;
+}
+
+/* the kernel has the request, no cqe yet */
+#define ZLOG_URING_INFLIGHT (-EINPROGRESS)
+
+/* reap cqes there, return how many */
+static int zlog_uring_reap(zlog_uring_ring_t * a_ring)
+{
+	int n = 0;
+	unsigned head;
+	struct io_uring_cqe *cqe;
+
+	head = *a_ring->cq_head;
+	while (head != __atomic_load_n(a_ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		cqe = (struct io_uring_cqe *)a_ring->cqes + (head & *a_ring->cq_mask);
+		if (cqe->user_data < (__u64)a_ring->nreq) {
+			a_ring->reqs[cqe->user_data].res = cqe->res;
+		}
+		head++;
+		n++;
+	}
+	__atomic_store_n(a_ring->cq_head, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+/* submit the chunk as one link, wait for all the kernel took.
+ * reqs, iovs and the batch are used again after return,
+ * so requests never outlive it. if waiting fails, the ring is broken,
+ * requests left in it are not written again, and it is never reused.
+ */
+static void zlog_uring_submit(zlog_uring_t * a_uring)
+{
+	int i;
+	int rc;
+	int done = 0;
+	int taken;
+	unsigned start;
+	unsigned tail;
+	struct io_uring_sqe *sqe;
+	zlog_uring_req_t *a_req;
+	zlog_uring_ring_t *a_ring = a_uring->ring;
+
+	if (a_ring->nreq == 0) return;
+
+	start = tail = *a_ring->sq_tail;
+	for (i = 0; i < a_ring->nreq; i++) {
+		a_req = &(a_ring->reqs[i]);
+		sqe = (struct io_uring_sqe *)a_ring->sqes + (tail & *a_ring->sq_mask);
+		memset(sqe, 0x00, sizeof(*sqe));
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->fd = a_req->fd;
+		sqe->addr = (unsigned long)a_req->iov;
+		sqe->len = a_req->iovcnt;
+		/* files are O_APPEND, the offset is not used */
+		sqe->off = a_ring->cur_pos ? (__u64)-1 : 0;
+		/* keep the order of lines, even of different files */
+		if (i < a_ring->nreq - 1) sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = i;
+		a_ring->sq_array[tail & *a_ring->sq_mask] = tail & *a_ring->sq_mask;
+		a_req->res = ZLOG_URING_INFLIGHT;
+		tail++;
+	}
+	__atomic_store_n(a_ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	/* one syscall submits all and waits for all */
+	rc = syscall(__NR_io_uring_enter, a_ring->fd, a_ring->nreq, a_ring->nreq,
+			IORING_ENTER_GETEVENTS, NULL, 0);
+	a_uring->submits++;
+	if (rc < 0 && errno != EINTR) {
+		zc_error("io_uring_enter fail, errno[%d]", errno);
+		/* no sqpoll, the kernel takes sqes only in enter, so take back the rest */
+		__atomic_store_n(a_ring->sq_tail,
+			__atomic_load_n(a_ring->sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+	}
+
+	taken = __atomic_load_n(a_ring->sq_head, __ATOMIC_ACQUIRE) - start;
+	for (i = taken; i < a_ring->nreq; i++) a_ring->reqs[i].res = -ECANCELED;
+
+	while (1) {
+		done += zlog_uring_reap(a_ring);
+		if (done >= taken) break;
+
+		rc = syscall(__NR_io_uring_enter, a_ring->fd, 0, taken - done,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+		a_uring->submits++;
+		if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			zc_error("io_uring_enter wait fail, errno[%d], [%d] requests left in kernel",
+				errno, taken - done);
+			a_ring->broken = 1;
+			break;
+		}
+	}
+
+	for (i = 0; i < a_ring->nreq; i++) {
+		a_req = &(a_ring->reqs[i]);
+		if (a_req->res == ZLOG_URING_INFLIGHT) {
+			/* may still be written by the kernel, writing again would double it */
+			a_uring->losts++;
+		} else if (a_req->res < 0 || (size_t)a_req->res < a_req->total) {
+			/* short, failed, or cancelled as an earlier one in the link failed */
+			if (a_req->res < 0 && a_req->res != -ECANCELED) {
+				zc_error("io_uring writev fail, errno[%d]", -a_req->res);
+			}
+			a_uring->fallbacks++;
+			zlog_uring_write_rest(a_req, a_req->res > 0 ? a_req->res : 0);
+		}
+		zlog_rule_async_written(a_req->a_rule, a_req->fd, a_req->total);
+	}
+
+	a_ring->nreq = 0;
+	a_ring->niov = 0;
+	return;
+}
+
+/* the rest of a batch after the ring broke, or a batch with no ring */
+static void zlog_uring_write_direct(zlog_uring_t * a_uring, zlog_spool_rec_t * a_rec)
+{
+	struct iovec iov;
+	zlog_uring_req_t a_req;
+
+	iov.iov_base = a_rec->data;
+	iov.iov_len = a_rec->len;
+	a_req.a_rule = a_rec->owner;
+	a_req.fd = zlog_rule_async_fd(a_req.a_rule, a_uring->round);
+	a_req.iov = &iov;
+	a_req.iovcnt = 1;
+	a_req.total = a_rec->len;
+
+	a_uring->fallbacks++;
+	zlog_uring_write_rest(&a_req, 0);
+	zlog_rule_async_written(a_req.a_rule, a_req.fd, a_req.total);
+	return;
+}
+
+static void zlog_uring_flush(zlog_uring_t * a_uring, char *batch, size_t len)
+{
+	zlog_spool_rec_t *a_rec;
+	zlog_uring_req_t *a_req = NULL;
+	zlog_uring_ring_t *a_ring = a_uring->ring;
+
+	a_uring->round++;
+	zlog_spool_foreach(batch, len, a_rec) {
+		if (a_ring->broken) {
+			/* reqs and iovs may still be read by the kernel */
+			zlog_uring_write_direct(a_uring, a_rec);
+			continue;
+		}
+
+		if (a_ring->niov == ZLOG_URING_IOVS) {
+			zlog_uring_submit(a_uring);
+			a_req = NULL;
+		}
+
+		/* lines in a row of the same rule go in one writev */
+		if (!a_req || a_req->a_rule != a_rec->owner || a_req->iovcnt == IOV_MAX) {
+			if (a_ring->nreq == ZLOG_URING_ENTRIES) zlog_uring_submit(a_uring);
+			a_req = &(a_ring->reqs[a_ring->nreq++]);
+			a_req->a_rule = a_rec->owner;
+			a_req->fd = zlog_rule_async_fd(a_req->a_rule, a_uring->round);
+			a_req->iov = &(a_ring->iovs[a_ring->niov]);
+			a_req->iovcnt = 0;
+			a_req->total = 0;
+		}
+
+		a_ring->iovs[a_ring->niov].iov_base = a_rec->data;
+		a_ring->iovs[a_ring->niov].iov_len = a_rec->len;
+		a_ring->niov++;
+		a_req->iovcnt++;
+		a_req->total += a_rec->len;
+	}
+	zlog_uring_submit(a_uring);
+	a_uring->batches++;
+	return;
+}
+
+static void zlog_uring_run(void *arg)
+{
+	char *batch;
+	size_t len;
+	zlog_spool_rec_t *a_rec;
+	zlog_uring_t *a_uring = arg;
+
+	while ((batch = zlog_spool_take(a_uring->spool, &len))) {
+		/* a broken ring is left as it is, the kernel may still read it */
+		if (a_uring->ring && a_uring->ring->broken) a_uring->ring = NULL;
+
+		/* forked, the ring is shared with parent, get a new one */
+		if (a_uring->pid != getpid() || !a_uring->ring) {
+			if (a_uring->ring) zlog_uring_ring_del(a_uring->ring);
+			a_uring->ring = zlog_uring_ring_new();
+			if (!a_uring->ring) {
+				/* lines taken are never lost, a ring is tried again next batch */
+				zc_error("zlog_uring_ring_new fail, batch written by write()");
+				a_uring->round++;
+				zlog_spool_foreach(batch, len, a_rec) {
+					zlog_uring_write_direct(a_uring, a_rec);
+				}
+				zlog_spool_done(a_uring->spool);
+				continue;
+			}
+			a_uring->pid = getpid();
+		}
+
+		zlog_uring_flush(a_uring, batch, len);
+		zlog_spool_done(a_uring->spool);
+	}
+	return;
+}
+
+#else
+
+static zlog_uring_ring_t *zlog_uring_ring_new(void)
+{
+	zc_warn("io_uring is not supported on this platform");
+	return NULL;
+}
+
+static void zlog_uring_ring_del(zlog_uring_ring_t * a_ring)
+{
+	return;
+}
+
+static int zlog_uring_ring_broken(zlog_uring_ring_t * a_ring)
+{
+	return 0;
+}
+
+static void zlog_uring_run(void *arg)
+{
+	return;
+}
+
+#endif
+
+/*******************************************************************************/
+void zlog_uring_del(zlog_uring_t * a_uring)
+{
+	zc_assert(a_uring,);
+
+	/* worker flushes the rest before it stops */
+	if (a_uring->worker) zlog_worker_del(a_uring->worker);
+	if (a_uring->ring && !zlog_uring_ring_broken(a_uring->ring)) zlog_uring_ring_del(a_uring->ring);
+	if (a_uring->spool) zlog_spool_del(a_uring->spool);
+	free(a_uring);
+	zc_debug("zlog_uring_del[%p]", a_uring);
+	return;
+}
+
+zlog_uring_t *zlog_uring_new(size_t spool_size)
+{
+	zlog_uring_t *a_uring;
+
+	a_uring = calloc(1, sizeof(zlog_uring_t));
+	if (!a_uring) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	a_uring->ring = zlog_uring_ring_new();
+	if (!a_uring->ring) {
+		zc_warn("kernel has no io_uring");
+		goto err;
+	}
+	a_uring->pid = getpid();
+
+	a_uring->spool = zlog_spool_new(spool_size);
+	if (!a_uring->spool) {
+		zc_error("zlog_spool_new fail");
+		goto err;
+	}
+
+	/* thread is not started until the first line */
+	a_uring->worker = zlog_worker_new("uring", 0, 0, zlog_uring_run, a_uring);
+	if (!a_uring->worker) {
+		zc_error("zlog_worker_new fail");
+		goto err;
+	}
+
+	zlog_uring_profile(a_uring, ZC_DEBUG);
+	return a_uring;
+err:
+	zlog_uring_del(a_uring);
+	return NULL;
+}
+
+/*******************************************************************************/
+int zlog_uring_write(zlog_uring_t * a_uring, void *owner, const char *buf, size_t len)
+{
+	int rc;
+
+	/* before the put, a forked child has no flusher yet */
+	if (zlog_worker_start(a_uring->worker)) {
+		zc_error("zlog_worker_start fail");
+		return -1;
+	}
+	rc = zlog_spool_put(a_uring->spool, owner, buf, len, -1);
+	if (rc < 0) {
+		zc_error("zlog_spool_put fail");
+		return -1;
+	} else if (rc == 1) {
+		/* 1st line of a batch */
+		zlog_worker_kick(a_uring->worker);
+	}
+	return 0;
+}
+
+void zlog_uring_drain(zlog_uring_t * a_uring)
+{
+	if (zlog_worker_start(a_uring->worker)) {
+		zc_error("zlog_worker_start fail");
+		return;
+	}
+	zlog_worker_kick(a_uring->worker);
+	zlog_spool_drain(a_uring->spool);
+	return;
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_uring_h
+#define __zlog_uring_h
+
+/* uring, is the io engine for static file rules when [global] says
+ *	io engine = uring
+ * writers copy messages into a spool and return,
+ * a flusher thread turns each batch into writev requests,
+ * linked in order, and submits them with one io_uring_enter().
+ * if the kernel has no io_uring, zlog_uring_new() fails
+ * and rules go on with write().
+ */
+
+#include <sys/types.h>
+
+#include "zc_defs.h"
+#include "spool.h"
+#include "worker.h"
+
+#define ZLOG_IO_ENGINE_SYNC  0
+#define ZLOG_IO_ENGINE_URING 1
+
+typedef struct zlog_uring_ring_s zlog_uring_ring_t;
+
+typedef struct zlog_uring_s {
+	zlog_spool_t *spool;
+	zlog_worker_t *worker;
+	zlog_uring_ring_t *ring;	/* only used by the flusher */
+	pid_t pid;			/* ring is set up in this process */
+	size_t round;
+
+	size_t batches;
+	size_t submits;
+	size_t fallbacks;		/* requests redone by write() */
+	size_t losts;			/* requests left in a broken ring */
+} zlog_uring_t;
+
+zlog_uring_t *zlog_uring_new(size_t spool_size);
+void zlog_uring_del(zlog_uring_t * a_uring);
+void zlog_uring_profile(zlog_uring_t * a_uring, int flag);
+
+#define zlog_uring_fits(a_uring, len) \
+	(zlog_spool_rec_size(len) <= (a_uring)->spool->size)
+
+/* owner is a static file rule */
+int zlog_uring_write(zlog_uring_t * a_uring, void *owner, const char *buf, size_t len);
+
+/* wait until all written before is in the file */
+void zlog_uring_drain(zlog_uring_t * a_uring);
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "zc_defs.h"
+#include "worker.h"
+
+/* all workers, so a forked child can make their locks again */
+static pthread_mutex_t zlog_workers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zlog_worker_t *zlog_workers;
+/* bumped in a child, so start knows to check the pid */
+static int zlog_worker_forks = 0;
+static pthread_once_t zlog_worker_once = PTHREAD_ONCE_INIT;
+
+static void zlog_worker_prepare(void)
+{
+	pthread_mutex_lock(&zlog_workers_mutex);
+}
+
+static void zlog_worker_parent(void)
+{
+	pthread_mutex_unlock(&zlog_workers_mutex);
+}
+
+/* the lock may be held by a thread which does not exist here */
+static void zlog_worker_child(void)
+{
+	zlog_worker_t *a_worker;
+
+	pthread_mutex_init(&zlog_workers_mutex, NULL);
+	for (a_worker = zlog_workers; a_worker; a_worker = a_worker->next) {
+		pthread_mutex_init(&(a_worker->lock_mutex), NULL);
+		pthread_cond_init(&(a_worker->cond), NULL);
+	}
+	zlog_worker_forks++;
+}
+
+static void zlog_worker_atfork(void)
+{
+	pthread_atfork(zlog_worker_prepare, zlog_worker_parent, zlog_worker_child);
+}
+
+void zlog_worker_profile(zlog_worker_t * a_worker, int flag)
+{
+	zc_assert(a_worker,);
+	zc_profile(flag, "--worker[%p][%s][%ld,%d][%ld,%d]--",
+		a_worker,
+		a_worker->name,
+		(long)a_worker->pid,
+		a_worker->stop,
+		a_worker->period,
+		a_worker->nice);
+	return;
+}
+
+/*******************************************************************************/
+static void *zlog_worker_run(void *arg)
+{
+	int stop;
+	struct timespec ts;
+	struct timeval now;
+	sigset_t all;
+	zlog_worker_t *a_worker = arg;
+
+	/* signals belong to the application threads */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+#ifdef __linux__
+	/* on linux the priority of a single thread can be changed by its tid */
+	if (a_worker->nice) setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#endif
+
+	do {
+		pthread_mutex_lock(&(a_worker->lock_mutex));
+		if (!a_worker->stop && !a_worker->kicked && !a_worker->period) {
+			pthread_cond_wait(&(a_worker->cond), &(a_worker->lock_mutex));
+		} else if (!a_worker->stop && !a_worker->kicked) {
+			gettimeofday(&now, NULL);
+			ts.tv_sec = now.tv_sec + a_worker->period / 1000;
+			ts.tv_nsec = now.tv_usec * 1000 + (a_worker->period % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&(a_worker->cond), &(a_worker->lock_mutex), &ts);
+		}
+		a_worker->kicked = 0;
+		stop = a_worker->stop;
+		pthread_mutex_unlock(&(a_worker->lock_mutex));
+
+		a_worker->round(a_worker->arg);
+	} while (!stop);
+
+	return NULL;
+}
+
+/*******************************************************************************/
+void zlog_worker_del(zlog_worker_t * a_worker)
+{
+	zc_assert(a_worker,);
+
+	pthread_mutex_lock(&zlog_workers_mutex);
+	if (a_worker->prev) a_worker->prev->next = a_worker->next;
+	else if (zlog_workers == a_worker) zlog_workers = a_worker->next;
+	if (a_worker->next) a_worker->next->prev = a_worker->prev;
+	pthread_mutex_unlock(&zlog_workers_mutex);
+
+	/* in a forked child the thread is gone, nothing to join */
+	if (a_worker->pid && a_worker->pid == getpid()) {
+		pthread_mutex_lock(&(a_worker->lock_mutex));
+		a_worker->stop = 1;
+		pthread_cond_signal(&(a_worker->cond));
+		pthread_mutex_unlock(&(a_worker->lock_mutex));
+
+		if (pthread_join(a_worker->tid, NULL)) {
+			zc_error("pthread_join worker[%s] fail", a_worker->name);
+		}
+	} else {
+		/* never started, or forked, drain here */
+		a_worker->round(a_worker->arg);
+	}
+
+	pthread_cond_destroy(&(a_worker->cond));
+	pthread_mutex_destroy(&(a_worker->lock_mutex));
+	free(a_worker);
+	zc_debug("zlog_worker_del[%p]", a_worker);
+	return;
+}
+
+zlog_worker_t *zlog_worker_new(const char *name, long period, int nice,
+			zlog_worker_fn round, void *arg)
+{
+	zlog_worker_t *a_worker;
+
+	zc_assert(name, NULL);
+	zc_assert(round, NULL);
+
+	pthread_once(&zlog_worker_once, zlog_worker_atfork);
+
+	a_worker = calloc(1, sizeof(zlog_worker_t));
+	if (!a_worker) {
+		zc_error("calloc fail, errno[%d]", errno);
+		return NULL;
+	}
+
+	snprintf(a_worker->name, sizeof(a_worker->name), "%s", name);
+	a_worker->period = (period > 0) ? period : 0;
+	a_worker->nice = nice;
+	a_worker->round = round;
+	a_worker->arg = arg;
+
+	if (pthread_mutex_init(&(a_worker->lock_mutex), NULL)) {
+		zc_error("pthread_mutex_init fail, errno[%d]", errno);
+		free(a_worker);
+		return NULL;
+	}
+
+	if (pthread_cond_init(&(a_worker->cond), NULL)) {
+		zc_error("pthread_cond_init fail, errno[%d]", errno);
+		pthread_mutex_destroy(&(a_worker->lock_mutex));
+		free(a_worker);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&zlog_workers_mutex);
+	a_worker->next = zlog_workers;
+	if (zlog_workers) zlog_workers->prev = a_worker;
+	zlog_workers = a_worker;
+	pthread_mutex_unlock(&zlog_workers_mutex);
+
+	zlog_worker_profile(a_worker, ZC_DEBUG);
+	return a_worker;
+}
+
+/*******************************************************************************/
+int zlog_worker_start(zlog_worker_t * a_worker)
+{
+	int rc = 0;
+	pid_t pid;
+
+	if (a_worker->pid && a_worker->forks == zlog_worker_forks) return 0;
+
+	pid = getpid();
+	if (a_worker->pid == pid) {
+		a_worker->forks = zlog_worker_forks;
+		return 0;
+	}
+
+	pthread_mutex_lock(&(a_worker->lock_mutex));
+	if (a_worker->pid != pid) {
+		a_worker->stop = 0;
+		a_worker->kicked = 0;
+		rc = pthread_create(&(a_worker->tid), NULL, zlog_worker_run, a_worker);
+		if (rc) {
+			zc_error("pthread_create worker[%s] fail, rc[%d]", a_worker->name, rc);
+			a_worker->pid = 0;
+		} else {
+			a_worker->pid = pid;
+			a_worker->forks = zlog_worker_forks;
+		}
+	}
+	pthread_mutex_unlock(&(a_worker->lock_mutex));
+
+	return rc ? -1 : 0;
+}
+
+void zlog_worker_kick(zlog_worker_t * a_worker)
+{
+	pthread_mutex_lock(&(a_worker->lock_mutex));
+	a_worker->kicked = 1;
+	pthread_cond_signal(&(a_worker->cond));
+	pthread_mutex_unlock(&(a_worker->lock_mutex));
+	return;
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#ifndef __zlog_worker_h
+#define __zlog_worker_h
+
+/* worker, is a background thread doing one round of housekeeping
+ * every period, or at once when it is kicked.
+ * log calls never wait for it, they only kick it.
+ * a thread does not survive fork(), so the worker remembers the pid
+ * it runs in, and zlog_worker_start() restarts it in a child process.
+ * it is cheap when nothing forked, so it is called on every put.
+ */
+
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "zc_defs.h"
+
+typedef void (*zlog_worker_fn) (void *arg);
+
+typedef struct zlog_worker_s {
+	char name[MAXLEN_PATH + 1];
+	pthread_mutex_t lock_mutex;
+	pthread_cond_t cond;
+	pthread_t tid;
+	pid_t pid;		/* process the thread runs in, 0 if not running */
+	int forks;		/* fork count seen when it was started */
+	int stop;
+	int kicked;
+
+	long period;		/* ms between two rounds, 0 only when kicked */
+	int nice;		/* 1: run at the lowest cpu priority */
+	zlog_worker_fn round;	/* called once more after stop, to drain */
+	void *arg;
+
+	struct zlog_worker_s *prev;
+	struct zlog_worker_s *next;
+} zlog_worker_t;
+
+zlog_worker_t *zlog_worker_new(const char *name, long period, int nice,
+			zlog_worker_fn round, void *arg);
+void zlog_worker_del(zlog_worker_t * a_worker);
+void zlog_worker_profile(zlog_worker_t * a_worker, int flag);
+
+/* start the thread, if it is not running in this process */
+int zlog_worker_start(zlog_worker_t * a_worker);
+void zlog_worker_kick(zlog_worker_t * a_worker);
+
+#endif
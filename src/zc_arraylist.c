@@ -131,3 +131,15 @@ int zc_arraylist_sortadd(zc_arraylist_t * a_list, zc_arraylist_cmp_fn cmp,
 	else
 		return zc_arraylist_insert_inner(a_list, i, data);
 }
+
+void zc_arraylist_remove_idx(zc_arraylist_t * a_list, int idx)
+{
+	if (idx < 0 || idx >= a_list->len)
+		return;
+	if (a_list->array[idx] && a_list->del) a_list->del(a_list->array[idx]);
+	memmove(a_list->array + idx, a_list->array + idx + 1,
+		(a_list->len - idx - 1) * sizeof(void *));
+	a_list->len--;
+	a_list->array[a_list->len] = NULL;
+	return;
+}
@@ -29,6 +29,7 @@ int zc_arraylist_set(zc_arraylist_t * a_list, int i, void *data);
 int zc_arraylist_add(zc_arraylist_t * a_list, void *data);
 int zc_arraylist_sortadd(zc_arraylist_t * a_list, zc_arraylist_cmp_fn cmp,
 			 void *data);
+void zc_arraylist_remove_idx(zc_arraylist_t * a_list, int idx);
 
 #define zc_arraylist_len(a_list)  (a_list->len)
 
@@ -75,6 +75,47 @@ size_t zc_parse_byte_size(char *astring)
 	return (res);
 }
 
+/*******************************************************************************/
+long zc_parse_time_span(char *astring)
+{
+	/* Parse time span in seconds depending on the suffix. Valid suffixes are s, m, h and d */
+	char *p;
+	long res;
+
+	zc_assert(astring, 0);
+
+	res = strtol(astring, &p, 10);
+	if (res <= 0)
+		return 0;
+
+	while (isspace(*p)) p++;
+
+	switch (*p) {
+	case '\0':
+	case 's':
+	case 'S':
+		break;
+	case 'm':
+	case 'M':
+		res *= 60;
+		break;
+	case 'h':
+	case 'H':
+		res *= 60 * 60;
+		break;
+	case 'd':
+	case 'D':
+		res *= 24 * 60 * 60;
+		break;
+	default:
+		zc_error("Wrong suffix parsing time span for string [%s], ignoring suffix",
+			 astring);
+		break;
+	}
+
+	return res;
+}
+
 /*******************************************************************************/
 int zc_str_replace_env(char *str, size_t str_size)
 {
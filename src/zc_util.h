@@ -9,6 +9,7 @@
 #define __zc_util_h
 
 size_t zc_parse_byte_size(char *astring);
+long zc_parse_time_span(char *astring);
 int zc_str_replace_env(char *str, size_t str_size);
 
 #define zc_max(a,b) ((a) > (b) ? (a) : (b))
@@ -56,6 +56,13 @@
 #define zlog_fsync fsync
 #endif
 
+/* Define zlog_fallocate to fallocate() keeping file size in Linux, fail with ENOSYS for all the rest */
+#ifdef __linux__
+#define zlog_fallocate(fd, offset, len) fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len)
+#else
+#define zlog_fallocate(fd, offset, len) (errno = ENOSYS, -1)
+#endif
+
 
 
 #endif
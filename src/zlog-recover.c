@@ -0,0 +1,134 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "ring.h"
+#include "version.h"
+
+static int all;
+static int quiet;
+static char *line_buf;
+static size_t line_size;
+
+static int print_line(void *arg, const char *line, size_t len)
+{
+	return fwrite(line, 1, len, stdout) != len;
+}
+
+static void recover_ring(zlog_ring_head_t *a_head, const char *file, long offset)
+{
+	if (!quiet) {
+		fprintf(stderr, "ring in [%s] at [%ld], pid[%ld] size[%llu] head[%llu] dumped[%llu]\n",
+			file, offset, (long)a_head->pid,
+			(unsigned long long)a_head->size,
+			(unsigned long long)a_head->head,
+			(unsigned long long)a_head->dumped);
+	}
+	zlog_ring_walk(a_head, all ? 0 : a_head->dumped, 0,
+		&line_buf, &line_size, print_line, NULL);
+	return;
+}
+
+/* a ring file starts with the head, a core file has rings of
+ * the process somewhere, a head is 16 bytes aligned in memory and in core
+ */
+static int recover(const char *file)
+{
+	int fd;
+	int found = 0;
+	char *base;
+	size_t off;
+	size_t size;
+	struct stat stb;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &stb)) {
+		fprintf(stderr, "open [%s] fail, %s\n", file, strerror(errno));
+		if (fd >= 0) close(fd);
+		return -1;
+	}
+	size = stb.st_size;
+	if (size < sizeof(zlog_ring_head_t)) {
+		fprintf(stderr, "[%s] is too small\n", file);
+		close(fd);
+		return -1;
+	}
+
+	base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "mmap [%s] fail, %s\n", file, strerror(errno));
+		return -1;
+	}
+
+	for (off = 0; off + sizeof(zlog_ring_head_t) <= size; off += 16) {
+		if (base[off] != ZLOG_RING_MAGIC[0]) continue;
+		if (zlog_ring_check_head((zlog_ring_head_t *)(base + off), size - off)) continue;
+		recover_ring((zlog_ring_head_t *)(base + off), file, (long)off);
+		found++;
+		off += sizeof(zlog_ring_head_t) + ((zlog_ring_head_t *)(base + off))->size - 16;
+	}
+	munmap(base, size);
+
+	if (!found) {
+		fprintf(stderr, "no ring found in [%s]\n", file);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int rc = 0;
+	int op;
+	static const char *help =
+		"useage: zlog-recover [ring files or core files]...\n"
+		"\tprint lines of $ring not dumped yet, after a crash\n"
+		"\t-a,\tprint all lines in the ring\n"
+		"\t-q,\tsuppress non-error message\n"
+		"\t-h,\tshow help message\n"
+		"zlog version: " ZLOG_VERSION "\n";
+
+	while((op = getopt(argc, argv, "aqhv")) > 0) {
+		if (op == 'h') {
+			fputs(help, stdout);
+			return 0;
+		} else if (op == 'a') {
+			all = 1;
+		} else if (op == 'q') {
+			quiet = 1;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc == 0) {
+		fputs(help, stdout);
+		return -1;
+	}
+
+	for (; argc > 0; argc--, argv++) {
+		if (recover(*argv)) rc = -1;
+	}
+	fflush(stdout);
+	if (line_buf) free(line_buf);
+	return rc;
+}
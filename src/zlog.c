@@ -12,7 +12,10 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "conf.h"
 #include "category_table.h"
@@ -20,6 +23,12 @@
 #include "mdc.h"
 #include "zc_defs.h"
 #include "rule.h"
+#include "syncer.h"
+#include "uring.h"
+#include "stats.h"
+#include "worker.h"
+#include "probe.h"
+#include "process.h"
 #include "version.h"
 
 /*******************************************************************************/
@@ -29,11 +38,17 @@ static pthread_rwlock_t zlog_env_lock = PTHREAD_RWLOCK_INITIALIZER;
 zlog_conf_t *zlog_env_conf;
 static pthread_key_t zlog_thread_key;
 static zc_hashtable_t *zlog_env_categories;
+static zc_arraylist_t *zlog_env_category_levels;	/* by zlog_set_category_level() */
 static zc_hashtable_t *zlog_env_records;
 static zlog_category_t *zlog_default_category;
-static size_t zlog_env_reload_conf_count;
+static int zlog_env_reload_pending;	/* set by the watch worker, read by log calls */
 static int zlog_env_is_init = 0;
 static int zlog_env_init_version = 0;
+static zlog_worker_t *zlog_env_stats_worker;
+static zlog_worker_t *zlog_env_watch_worker;
+static zlog_worker_t *zlog_env_dedup_worker;
+static struct timespec zlog_env_watch_mtime;	/* of the change told last */
+static ino_t zlog_env_watch_ino;
 /*******************************************************************************/
 /* inner no need thread-safe */
 static void zlog_fini_inner(void)
@@ -47,11 +62,42 @@ static void zlog_fini_inner(void)
 	
 	if (zlog_env_categories) zlog_category_table_del(zlog_env_categories);
 	zlog_env_categories = NULL;
+	if (zlog_env_category_levels) zc_arraylist_del(zlog_env_category_levels);
+	zlog_env_category_levels = NULL;
 	zlog_default_category = NULL;
+	if (zlog_env_stats_worker) zlog_worker_del(zlog_env_stats_worker);
+	zlog_env_stats_worker = NULL;
+	if (zlog_env_watch_worker) zlog_worker_del(zlog_env_watch_worker);
+	zlog_env_watch_worker = NULL;
+	if (zlog_env_dedup_worker) zlog_worker_del(zlog_env_dedup_worker);
+	zlog_env_dedup_worker = NULL;
 	if (zlog_env_records) zlog_record_table_del(zlog_env_records);
 	zlog_env_records = NULL;
 	if (zlog_env_conf) zlog_conf_del(zlog_env_conf);
 	zlog_env_conf = NULL;
+	/* states of threads exiting from now on are freed */
+	zlog_thread_pool_set_max(0);
+	return;
+}
+
+/* rules of the conf going away report repeats they folded,
+ * with the event of the calling thread, if it ever logged
+ */
+static void zlog_flush_repeated(void)
+{
+	int i;
+	zlog_rule_t *a_rule;
+	zlog_thread_t *a_thread;
+
+	if (!zlog_env_conf) return;
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (!a_thread || a_thread->init_version != zlog_env_init_version) return;
+
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		/* kept by a reload, repeats go on */
+		if (zlog_rule_is_shared(a_rule)) continue;
+		zlog_rule_flush_repeated(a_rule, a_thread);
+	}
 	return;
 }
 
@@ -59,8 +105,111 @@ static void zlog_clean_rest_thread(void)
 {
 	zlog_thread_t *a_thread;
 	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) return;
-	zlog_thread_del(a_thread);
+	if (a_thread) zlog_thread_del(a_thread);
+	zlog_thread_pool_clean();
+	return;
+}
+
+static int zlog_stats_snapshot_inner(zlog_stats_t * stats);
+static void zlog_dedup_worker_update(void);
+
+/* a round never waits for the lock, reload and fini hold it to stop the worker */
+static void zlog_stats_round(void *arg)
+{
+	zlog_stats_t stats;
+	char path[MAXLEN_PATH + 1];
+
+	if (pthread_rwlock_tryrdlock(&zlog_env_lock)) return;
+	if (!zlog_env_is_init || zlog_stats_snapshot_inner(&stats)) {
+		pthread_rwlock_unlock(&zlog_env_lock);
+		return;
+	}
+	strcpy(path, zlog_env_conf->stats_file);
+	pthread_rwlock_unlock(&zlog_env_lock);
+
+	if (zlog_stats_print(&stats, path)) {
+		zc_error("zlog_stats_print fail");
+	}
+	zlog_stats_free(&stats);
+	return;
+}
+
+/* after conf is changed, stats period may be changed */
+static void zlog_stats_worker_update(void)
+{
+	if (zlog_env_stats_worker) zlog_worker_del(zlog_env_stats_worker);
+	zlog_env_stats_worker = NULL;
+	if (!zlog_env_conf->stats_period) return;
+
+	zlog_env_stats_worker = zlog_worker_new("stats", zlog_env_conf->stats_period, 1,
+					zlog_stats_round, NULL);
+	if (!zlog_env_stats_worker) {
+		zc_error("zlog_worker_new fail, no stats dump");
+		return;
+	}
+	if (zlog_worker_start(zlog_env_stats_worker)) {
+		zc_error("zlog_worker_start fail, no stats dump");
+	}
+	return;
+}
+
+#define zlog_stat_is(a_stat, a_mtime, mtime, ino) \
+	((a_mtime).tv_sec == (mtime).tv_sec \
+	 && (a_mtime).tv_nsec == (mtime).tv_nsec \
+	 && (a_stat)->st_ino == (ino))
+
+/* a change of the conf file is told to the next log call, which reloads,
+ * a log call only reads the flag. each change is told once,
+ * a reload failing on a file half written is tried again when it is done.
+ */
+static void zlog_watch_round(void *arg)
+{
+	struct stat a_stat;
+	struct timespec a_mtime;
+	char file[MAXLEN_PATH + 1];
+	struct timespec mtime;
+	ino_t ino;
+
+	if (pthread_rwlock_tryrdlock(&zlog_env_lock)) return;
+	if (!zlog_env_is_init) {
+		pthread_rwlock_unlock(&zlog_env_lock);
+		return;
+	}
+	strcpy(file, zlog_env_conf->file);
+	mtime = zlog_env_conf->mtime_ts;
+	ino = zlog_env_conf->ino;
+	pthread_rwlock_unlock(&zlog_env_lock);
+
+	/* being replaced, next round */
+	if (stat(file, &a_stat)) return;
+	zlog_stat_mtime(&a_stat, a_mtime);
+	if (zlog_stat_is(&a_stat, a_mtime, mtime, ino)) return;
+	if (zlog_stat_is(&a_stat, a_mtime, zlog_env_watch_mtime, zlog_env_watch_ino)) return;
+
+	zlog_env_watch_mtime = a_mtime;
+	zlog_env_watch_ino = a_stat.st_ino;
+	__atomic_store_n(&zlog_env_reload_pending, 1, __ATOMIC_RELAXED);
+	return;
+}
+
+/* after conf is changed, reload conf interval may be changed */
+static void zlog_watch_worker_update(void)
+{
+	if (zlog_env_watch_worker) zlog_worker_del(zlog_env_watch_worker);
+	zlog_env_watch_worker = NULL;
+	memset(&zlog_env_watch_mtime, 0x00, sizeof(zlog_env_watch_mtime));
+	zlog_env_watch_ino = 0;
+	if (!zlog_env_conf->reload_conf_interval || zlog_env_conf->file[0] == '\0') return;
+
+	zlog_env_watch_worker = zlog_worker_new("watch", zlog_env_conf->reload_conf_interval, 1,
+					zlog_watch_round, NULL);
+	if (!zlog_env_watch_worker) {
+		zc_error("zlog_worker_new fail, no reload on change");
+		return;
+	}
+	if (zlog_worker_start(zlog_env_watch_worker)) {
+		zc_error("zlog_worker_start fail, no reload on change");
+	}
 	return;
 }
 
@@ -70,8 +219,9 @@ static int zlog_init_inner(const char *confpath)
 
 	/* the 1st time in the whole process do init */
 	if (zlog_env_init_version == 0) {
-		/* clean up is done by OS when a thread call pthread_exit */
-		rc = pthread_key_create(&zlog_thread_key, (void (*) (void *)) zlog_thread_del);
+		/* clean up is done by OS when a thread call pthread_exit,
+		 * the state goes to the pool for a thread to come */
+		rc = pthread_key_create(&zlog_thread_key, (void (*) (void *)) zlog_thread_recycle);
 		if (rc) {
 			zc_error("pthread_key_create fail, rc[%d]", rc);
 			goto err;
@@ -88,11 +238,18 @@ static int zlog_init_inner(const char *confpath)
 		zlog_env_init_version++;
 	} /* else maybe after zlog_fini() and need not create pthread_key */
 
-	zlog_env_conf = zlog_conf_new(confpath);
+	if (zlog_process_update()) {
+		zc_error("zlog_process_update fail");
+		goto err;
+	}
+	zlog_env_reload_pending = 0;
+
+	zlog_env_conf = zlog_conf_new(confpath, NULL);
 	if (!zlog_env_conf) {
 		zc_error("zlog_conf_new[%s] fail", confpath);
 		goto err;
 	}
+	zlog_thread_pool_set_max(zlog_env_conf->thread_pool);
 
 	zlog_env_categories = zlog_category_table_new();
 	if (!zlog_env_categories) {
@@ -100,12 +257,21 @@ static int zlog_init_inner(const char *confpath)
 		goto err;
 	}
 
+	zlog_env_category_levels = zc_arraylist_new(free);
+	if (!zlog_env_category_levels) {
+		zc_error("zc_arraylist_new fail");
+		goto err;
+	}
+
 	zlog_env_records = zlog_record_table_new();
 	if (!zlog_env_records) {
 		zc_error("zlog_record_table_new fail");
 		goto err;
 	}
 
+	zlog_stats_worker_update();
+	zlog_watch_worker_update();
+	zlog_dedup_worker_update();
 	return 0;
 err:
 	zlog_fini_inner();
@@ -203,7 +369,8 @@ int dzlog_init(const char *confpath, const char *cname)
 	zlog_default_category = zlog_category_table_fetch_category(
 				zlog_env_categories,
 				cname,
-				zlog_env_conf->rules);
+				zlog_env_conf->rules,
+				zlog_env_category_levels);
 	if (!zlog_default_category) {
 		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
@@ -232,6 +399,7 @@ err:
 
 /*
  * @brief 从confpath重载配置, 并根据这个配置文件来重计算内部的分类规则匹配, 重建每个线程的缓存, 并设置原有的用户自定义输出函数.
+ * 和上一次一样的格式和规则会被保留, 打开的文件和状态不变, 只有涉及变了的规则的分类会重算, 线程的缓存只在大小等变了时才重建.
  * 如果confpath为NULL, 会重载上一次zlog_init()或者zlog_reload()使用的配置文件.
  * 如果zlog_reload()失败, 上一次的配置依然有效, 所以zlog_reload()具有原子性.
  *
@@ -248,6 +416,7 @@ int zlog_reload(const char *confpath)
 	int c_up = 0;
 
 	zc_debug("------zlog_reload start------");
+	ZLOG_PROBE(reload__start);
 	rc = pthread_rwlock_wrlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_wrlock fail, rc[%d]", rc);
@@ -262,10 +431,10 @@ int zlog_reload(const char *confpath)
 	/* use last conf file */
 	if (confpath == NULL) confpath = zlog_env_conf->file;
 
-	/* reach reload period */
+	/* the conf file is changed */
 	if (confpath == (char*)-1) {
 		/* test again, avoid other threads already reloaded */
-		if (zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period) {
+		if (zlog_env_reload_pending) {
 			confpath = zlog_env_conf->file;
 		} else {
 			/* do nothing, already done */
@@ -273,10 +442,16 @@ int zlog_reload(const char *confpath)
 		}
 	}
 
-	/* reset counter, whether automaticlly or mannually */
-	zlog_env_reload_conf_count = 0;
+	/* reset flag, whether automaticlly or mannually */
+	__atomic_store_n(&zlog_env_reload_pending, 0, __ATOMIC_RELAXED);
 
-	new_conf = zlog_conf_new(confpath);
+	/* keep the old hostname if it fails */
+	if (zlog_process_update()) {
+		zc_warn("zlog_process_update fail");
+	}
+
+	/* formats and rules the same are kept, not opened again */
+	new_conf = zlog_conf_new(confpath, zlog_env_conf);
 	if (!new_conf) {
 		zc_error("zlog_conf_new fail");
 		goto err;
@@ -286,7 +461,8 @@ int zlog_reload(const char *confpath)
 		zlog_rule_set_record(a_rule, zlog_env_records);
 	}
 
-	if (zlog_category_table_update_rules(zlog_env_categories, new_conf->rules)) {
+	if (zlog_category_table_update_rules(zlog_env_categories,
+			zlog_env_conf->rules, new_conf->rules)) {
 		c_up = 0;
 		zc_error("zlog_category_table_update fail");
 		goto err;
@@ -294,12 +470,22 @@ int zlog_reload(const char *confpath)
 		c_up = 1;
 	}
 
-	zlog_env_init_version++;
+	zlog_flush_repeated();
+	/* threads rebuild on their next call, only if their bufs and time caches change */
+	if (zlog_conf_thread_changed(new_conf, zlog_env_conf)) zlog_env_init_version++;
 
 	if (c_up) zlog_category_table_commit_rules(zlog_env_categories);
 	zlog_conf_del(zlog_env_conf);
 	zlog_env_conf = new_conf;
+	if (zlog_syncer_resume(zlog_env_conf->syncer)) {
+		zc_error("zlog_syncer_resume fail");
+	}
+	zlog_thread_pool_set_max(zlog_env_conf->thread_pool);
+	zlog_stats_worker_update();
+	zlog_watch_worker_update();
+	zlog_dedup_worker_update();
 	zc_debug("------zlog_reload success, total init verison[%d] ------", zlog_env_init_version);
+	ZLOG_PROBE1(reload__done, 0);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
@@ -312,6 +498,7 @@ err:
 	if (new_conf) zlog_conf_del(new_conf);
 	if (c_up) zlog_category_table_rollback_rules(zlog_env_categories);
 	zc_error("------zlog_reload fail, total init version[%d] ------", zlog_env_init_version);
+	ZLOG_PROBE1(reload__done, -1);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
@@ -320,6 +507,7 @@ err:
 	return -1;
 quit:
 	zc_debug("------zlog_reload do nothing------");
+	ZLOG_PROBE1(reload__done, 1);
 	rc = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rc) {
 		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
@@ -349,6 +537,7 @@ void zlog_fini(void)
 		goto exit;
 	}
 
+	zlog_flush_repeated();
 	zlog_fini_inner();
 	zlog_env_is_init = 0;
 
@@ -362,6 +551,47 @@ exit:
 	return;
 }
 /*******************************************************************************/
+/*
+ * @brief 把所有规则写过的文件刷到磁盘上, 返回时调用前写的日志都已落盘.
+ * 平时由后台线程按fsync period和fsync interval刷盘, 写日志的线程不会等待fsync.
+ *
+ * @return 0: 成功 / -1: 失败, 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面
+ */
+int zlog_sync(void)
+{
+	int rc = 0;
+
+	zc_debug("------zlog_sync start------");
+	rc = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return -1;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		rc = -1;
+		goto exit;
+	}
+
+	/* lines in io engine go to files first */
+	if (zlog_env_conf->uring) zlog_uring_drain(zlog_env_conf->uring);
+
+	if (zlog_env_conf->syncer && zlog_syncer_sync(zlog_env_conf->syncer)) {
+		zc_error("zlog_syncer_sync fail");
+		rc = -1;
+		goto exit;
+	}
+
+exit:
+	zc_debug("------zlog_sync end------");
+	if (pthread_rwlock_unlock(&zlog_env_lock)) {
+		zc_error("pthread_rwlock_unlock fail");
+		return -1;
+	}
+	return rc;
+}
+/*******************************************************************************/
 /*
  * @brief 从zlog的全局分类表里面找到分类, 用于以后输出日志, 如果没有的话, 就建一个.
  * 然后它会遍历所有的规则, 寻找和cname匹配的规则并绑定.
@@ -390,7 +620,8 @@ zlog_category_t *zlog_get_category(const char *cname)
 	a_category = zlog_category_table_fetch_category(
 				zlog_env_categories,
 				cname,
-				zlog_env_conf->rules);
+				zlog_env_conf->rules,
+				zlog_env_category_levels);
 	if (!a_category) {
 		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
@@ -439,7 +670,8 @@ int dzlog_set_category(const char *cname)
 	zlog_default_category = zlog_category_table_fetch_category(
 				zlog_env_categories,
 				cname,
-				zlog_env_conf->rules);
+				zlog_env_conf->rules,
+				zlog_env_category_levels);
 	if (!zlog_default_category) {
 		zc_error("zlog_category_table_fetch_category[%s] fail", cname);
 		goto err;
@@ -461,12 +693,35 @@ err:
 	}
 	return -1;
 }
+/*******************************************************************************/
+/* a level set on the thread goes over the category, and its state is
+ * got only when some thread has one, else just the bitmap as before.
+ * the state is of the calling thread, so no lock.
+ */
+static int zlog_thread_needless_level(zlog_category_t * a_category, int level)
+{
+	zlog_thread_t *a_thread;
+
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (!a_thread || a_thread->level_set < 0) {
+		return zlog_category_needless_level(a_category, level);
+	}
+	return level < a_thread->level_set;
+}
+
+#define zlog_needless_level(a_category, lv) \
+	(zlog_thread_level_any() ? zlog_thread_needless_level(a_category, lv) \
+		: zlog_category_needless_level(a_category, lv))
+
 /*******************************************************************************/
 #define zlog_fetch_thread(a_thread, fail_goto) do {  \
 	int rd = 0;  \
 	a_thread = pthread_getspecific(zlog_thread_key);  \
 	if (!a_thread) {  \
-		a_thread = zlog_thread_new(zlog_env_init_version,  \
+		/* one left by a thread gone, else a new one */  \
+		a_thread = zlog_thread_reuse();  \
+		if (!a_thread) a_thread = zlog_thread_new(zlog_env_init_version,  \
+				zlog_env_conf->thread_needs, \
 				zlog_env_conf->buf_size_min, zlog_env_conf->buf_size_max, \
 				zlog_env_conf->time_cache_count); \
 		if (!a_thread) {  \
@@ -480,27 +735,93 @@ err:
 			zc_error("pthread_setspecific fail, rd[%d]", rd);  \
 			goto fail_goto;  \
 		}  \
+		zlog_thread_set_stats(a_thread, zlog_env_conf->stats);  \
 	}  \
   \
 	if (a_thread->init_version != zlog_env_init_version) {  \
 		/* as mdc is still here, so can not easily del and new */ \
 		rd = zlog_thread_rebuild_msg_buf(a_thread, \
+				zlog_env_conf->thread_needs, \
 				zlog_env_conf->buf_size_min, \
 				zlog_env_conf->buf_size_max);  \
 		if (rd) {  \
 			zc_error("zlog_thread_resize_msg_buf fail, rd[%d]", rd);  \
 			goto fail_goto;  \
 		}  \
+  \
+		rd = zlog_thread_rebuild_path_buf(a_thread, zlog_env_conf->thread_needs);  \
+		if (rd) {  \
+			zc_error("zlog_thread_rebuild_path_buf fail, rd[%d]", rd);  \
+			goto fail_goto;  \
+		}  \
   \
 		rd = zlog_thread_rebuild_event(a_thread, zlog_env_conf->time_cache_count);  \
 		if (rd) {  \
 			zc_error("zlog_thread_resize_msg_buf fail, rd[%d]", rd);  \
 			goto fail_goto;  \
 		}  \
+		zlog_thread_set_stats(a_thread, zlog_env_conf->stats);  \
 		a_thread->init_version = zlog_env_init_version;  \
 	}  \
 } while (0)
 
+/*******************************************************************************/
+/* repeats of a rule gone quiet are reported when the window ends,
+ * as syslogd does, with the state of the worker thread.
+ * a round never waits for the lock, reload and fini hold it to stop the worker
+ */
+static void zlog_dedup_round(void *arg)
+{
+	int i;
+	zlog_rule_t *a_rule;
+	zlog_thread_t *a_thread;
+
+	if (pthread_rwlock_tryrdlock(&zlog_env_lock)) return;
+	if (!zlog_env_is_init) goto exit;
+
+	zlog_fetch_thread(a_thread, exit);
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		zlog_rule_flush_expired(a_rule, a_thread);
+	}
+exit:
+	pthread_rwlock_unlock(&zlog_env_lock);
+	return;
+}
+
+/* after conf is changed, rules with dedup may come or go */
+static void zlog_dedup_worker_update(void)
+{
+	int i;
+	int dedup = 0;
+	zlog_rule_t *a_rule;
+
+	if (zlog_env_dedup_worker) zlog_worker_del(zlog_env_dedup_worker);
+	zlog_env_dedup_worker = NULL;
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		if (a_rule->dedup_window) dedup = 1;
+	}
+	if (!dedup) return;
+
+	zlog_env_dedup_worker = zlog_worker_new("dedup", 1000, 1, zlog_dedup_round, NULL);
+	if (!zlog_env_dedup_worker) {
+		zc_error("zlog_worker_new fail, repeats wait for the next line");
+		return;
+	}
+	if (zlog_worker_start(zlog_env_dedup_worker)) {
+		zc_error("zlog_worker_start fail, repeats wait for the next line");
+	}
+	return;
+}
+
+/* threads do not survive fork(), the 1st log call in a child starts them */
+static void zlog_env_workers_start(void)
+{
+	if (zlog_env_stats_worker) zlog_worker_start(zlog_env_stats_worker);
+	if (zlog_env_watch_worker) zlog_worker_start(zlog_env_watch_worker);
+	if (zlog_env_dedup_worker) zlog_worker_start(zlog_env_dedup_worker);
+	return;
+}
+
 /*******************************************************************************/
 // MDC操作
 // MDC(Mapped Diagnostic Context)是一个每线程拥有的键-值表, 所以和分类没什么关系.
@@ -534,6 +855,14 @@ int zlog_put_mdc(const char *key, const char *value)
 
 	zlog_fetch_thread(a_thread, err);
 
+	if (!a_thread->mdc) {
+		a_thread->mdc = zlog_mdc_new();
+		if (!a_thread->mdc) {
+			zc_error("zlog_mdc_new fail");
+			goto err;
+		}
+	}
+
 	if (zlog_mdc_put(a_thread->mdc, key, value)) {
 		zc_error("zlog_mdc_put fail, key[%s], value[%s]", key, value);
 		goto err;
@@ -580,7 +909,7 @@ char *zlog_get_mdc(char *key)
 	}
 
 	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) {
+	if (!a_thread || !a_thread->mdc) {
 		zc_error("thread not found, maybe not use zlog_put_mdc before");
 		goto err;
 	}
@@ -625,7 +954,7 @@ void zlog_remove_mdc(char *key)
 	}
 
 	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) {
+	if (!a_thread || !a_thread->mdc) {
 		zc_error("thread not found, maybe not use zlog_put_mdc before");
 		goto exit;
 	}
@@ -658,7 +987,7 @@ void zlog_clean_mdc(void)
 	}
 
 	a_thread = pthread_getspecific(zlog_thread_key);
-	if (!a_thread) {
+	if (!a_thread || !a_thread->mdc) {
 		zc_error("thread not found, maybe not use zlog_put_mdc before");
 		goto exit;
 	}
@@ -699,7 +1028,9 @@ void vzlog(zlog_category_t * category,
 	 * For speed up, if one log will not be ouput,
 	 * There is no need to aquire rdlock.
 	 */
-	if (zlog_category_needless_level(category, level)) return;
+	ZLOG_PROBE3(entry, file, line, level);
+	if (zlog_needless_level(category, level)) return;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -709,6 +1040,7 @@ void vzlog(zlog_category_t * category,
 	}
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	zlog_event_set_fmt(a_thread->event,
 		category->name, category->name_len,
@@ -720,9 +1052,8 @@ void vzlog(zlog_category_t * category,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -733,7 +1064,7 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
@@ -760,7 +1091,9 @@ void hzlog(zlog_category_t *category,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(category, level)) return;
+	ZLOG_PROBE3(entry, file, line, level);
+	if (zlog_needless_level(category, level)) return;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -770,6 +1103,7 @@ void hzlog(zlog_category_t *category,
 	}
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	zlog_event_set_hex(a_thread->event,
 		category->name, category->name_len,
@@ -781,9 +1115,8 @@ void hzlog(zlog_category_t *category,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -794,7 +1127,7 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
@@ -808,7 +1141,9 @@ void vdzlog(const char *file, size_t filelen,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(zlog_default_category, level)) return;
+	ZLOG_PROBE3(entry, file, line, level);
+	if (zlog_needless_level(zlog_default_category, level)) return;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -825,6 +1160,7 @@ void vdzlog(const char *file, size_t filelen,
 	}
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	zlog_event_set_fmt(a_thread->event,
 		zlog_default_category->name, zlog_default_category->name_len,
@@ -836,9 +1172,8 @@ void vdzlog(const char *file, size_t filelen,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -849,7 +1184,7 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
@@ -861,7 +1196,9 @@ void hdzlog(const char *file, size_t filelen,
 {
 	zlog_thread_t *a_thread;
 
-	if (zlog_category_needless_level(zlog_default_category, level)) return;
+	ZLOG_PROBE3(entry, file, line, level);
+	if (zlog_needless_level(zlog_default_category, level)) return;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -878,6 +1215,7 @@ void hdzlog(const char *file, size_t filelen,
 	}
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	zlog_event_set_hex(a_thread->event,
 		zlog_default_category->name, zlog_default_category->name_len,
@@ -889,9 +1227,8 @@ void hdzlog(const char *file, size_t filelen,
 		goto exit;
 	}
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -902,11 +1239,22 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
 
+/*******************************************************************************/
+/*
+ * @brief 分类的这个等级会不会输出, 和写日志前的判断一样, 不加锁
+ *
+ * @return 1: 输出 / 0: 不输出
+ */
+int zlog_level_enabled(zlog_category_t * category, const int level)
+{
+	return category && !zlog_needless_level(category, level);
+}
+
 /*******************************************************************************/
 /*
  * @brief 写日志函数, 输入的数据对应于配置文件中的%m, category来自于调用zlog_get_category()
@@ -920,7 +1268,9 @@ void zlog(zlog_category_t * category,
 	zlog_thread_t *a_thread;
 	va_list args;
 
-	if (category && zlog_category_needless_level(category, level)) return;
+	ZLOG_PROBE3(entry, file, line, level);
+	if (category && zlog_needless_level(category, level)) return;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -930,6 +1280,7 @@ void zlog(zlog_category_t * category,
 	}
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	va_start(args, format);
 	zlog_event_set_fmt(a_thread->event, category->name, category->name_len,
@@ -942,9 +1293,8 @@ void zlog(zlog_category_t * category,
 	}
 	va_end(args);
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -955,7 +1305,7 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
@@ -967,6 +1317,7 @@ void dzlog(const char *file, size_t filelen, const char *func, size_t funclen, l
 	zlog_thread_t *a_thread;
 	va_list args;
 
+	ZLOG_PROBE3(entry, file, line, level);
 
 	pthread_rwlock_rdlock(&zlog_env_lock);
 
@@ -982,9 +1333,11 @@ void dzlog(const char *file, size_t filelen, const char *func, size_t funclen, l
 		goto exit;
 	}
 
-	if (zlog_category_needless_level(zlog_default_category, level)) goto exit;
+	if (zlog_needless_level(zlog_default_category, level)) goto exit;
+	ZLOG_PROBE3(level__pass, file, line, level);
 
 	zlog_fetch_thread(a_thread, exit);
+	zlog_env_workers_start();
 
 	va_start(args, format);
 	zlog_event_set_fmt(a_thread->event,
@@ -999,9 +1352,8 @@ void dzlog(const char *file, size_t filelen, const char *func, size_t funclen, l
 	}
 	va_end(args);
 
-	if (zlog_env_conf->reload_conf_period &&
-		++zlog_env_reload_conf_count > zlog_env_conf->reload_conf_period ) {
-		/* under the protection of lock read env conf */
+	if (__atomic_load_n(&zlog_env_reload_pending, __ATOMIC_RELAXED)) {
+		/* the watch worker saw the conf file changed */
 		goto reload;
 	}
 
@@ -1012,7 +1364,7 @@ reload:
 	pthread_rwlock_unlock(&zlog_env_lock);
 	/* will be wrlock, so after unlock */
 	if (zlog_reload((char *)-1)) {
-		zc_error("reach reload-conf-period but zlog_reload fail, zlog-chk-conf [file] see detail");
+		zc_error("conf file changed but zlog_reload fail, zlog-chk-conf [file] see detail");
 	}
 	return;
 }
@@ -1039,6 +1391,7 @@ void zlog_profile(void)
 	zc_warn("------zlog_profile start------ ");
 	zc_warn("is init:[%d]", zlog_env_is_init);
 	zc_warn("init version:[%d]", zlog_env_init_version);
+	zlog_process_profile(ZC_WARN);
 	zlog_conf_profile(zlog_env_conf, ZC_WARN);
 	zlog_record_table_profile(zlog_env_records, ZC_WARN);
 	zlog_category_table_profile(zlog_env_categories, ZC_WARN);
@@ -1055,23 +1408,19 @@ void zlog_profile(void)
 	return;
 }
 /*******************************************************************************/
-/*
- * @brief 用户自定义输出, 绑定动作
- *
- * @return 0: 成功 / -1: 失败
- * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
- */
-int zlog_set_record(const char *rname, zlog_record_fn record_output)
+/* record_output or record_batch, the other is NULL */
+static int zlog_set_record_inner(const char *rname,
+	zlog_record_fn record_output, zlog_record_batch_fn record_batch)
 {
 	int rc = 0;
 	int rd = 0;
 	zlog_rule_t *a_rule;
 	zlog_record_t *a_record;
+	zlog_record_t *a_old = NULL;
+	zc_hashtable_entry_t *a_entry;
+	size_t spool_size;
 	int i = 0;
 
-	zc_assert(rname, -1);
-	zc_assert(record_output, -1);
-
 	rd = pthread_rwlock_wrlock(&zlog_env_lock);
 	if (rd) {
 		zc_error("pthread_rwlock_rdlock fail, rd[%d]", rd);
@@ -1083,18 +1432,37 @@ int zlog_set_record(const char *rname, zlog_record_fn record_output)
 		goto zlog_set_record_exit;
 	}
 
-	a_record = zlog_record_new(rname, record_output);
+	if (record_batch) {
+		/* a msg of buffer max always fits */
+		spool_size = ZLOG_RECORD_SPOOL_SIZE;
+		if (spool_size < zlog_env_conf->buf_size_max * 2) {
+			spool_size = zlog_env_conf->buf_size_max * 2;
+		}
+		a_record = zlog_record_new_batch(rname, record_batch, spool_size);
+	} else {
+		a_record = zlog_record_new(rname, record_output);
+	}
 	if (!a_record) {
 		rc = -1;
 		zc_error("zlog_record_new fail");
 		goto zlog_set_record_exit;
 	}
 
-	rc = zc_hashtable_put(zlog_env_records, a_record->name, a_record);
-	if (rc) {
-		zlog_record_del(a_record);
-		zc_error("zc_hashtable_put fail");
-		goto zlog_set_record_exit;
+	/* the old one is deleted out of the lock, its dispatcher drains
+	 * msgs put before, and must not wait for a writer waiting for us
+	 */
+	a_entry = zc_hashtable_get_entry(zlog_env_records, a_record->name);
+	if (a_entry) {
+		a_old = a_entry->value;
+		a_entry->key = a_record->name;
+		a_entry->value = a_record;
+	} else {
+		rc = zc_hashtable_put(zlog_env_records, a_record->name, a_record);
+		if (rc) {
+			zlog_record_del(a_record);
+			zc_error("zc_hashtable_put fail");
+			goto zlog_set_record_exit;
+		}
 	}
 
 	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
@@ -1102,6 +1470,331 @@ int zlog_set_record(const char *rname, zlog_record_fn record_output)
 	}
 
       zlog_set_record_exit:
+	rd = pthread_rwlock_unlock(&zlog_env_lock);
+	if (a_old) zlog_record_del(a_old);
+	if (rd) {
+		zc_error("pthread_rwlock_unlock fail, rd=[%d]", rd);
+		return -1;
+	}
+	return rc;
+}
+
+/*
+ * @brief 用户自定义输出, 绑定动作
+ *
+ * @return 0: 成功 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_set_record(const char *rname, zlog_record_fn record_output)
+{
+	zc_assert(rname, -1);
+	zc_assert(record_output, -1);
+
+	return zlog_set_record_inner(rname, record_output, NULL);
+}
+
+/*
+ * @brief 用户自定义批量输出, 绑定动作
+ *
+ * @return 0: 成功 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_set_record_batch(const char *rname, zlog_record_batch_fn record_batch)
+{
+	zc_assert(rname, -1);
+	zc_assert(record_batch, -1);
+
+	return zlog_set_record_inner(rname, NULL, record_batch);
+}
+
+/*******************************************************************************/
+/*
+ * @brief 导出所有$ring规则的内存日志
+ *
+ * @return 0: 成功 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_dump_ring(void)
+{
+	int i;
+	int rc = 0;
+	int rd = 0;
+	zlog_rule_t *a_rule;
+
+	rd = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rd) {
+		zc_error("pthread_rwlock_rdlock fail, rd[%d]", rd);
+		return -1;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		rc = -1;
+		goto exit;
+	}
+
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		if (a_rule->ring && zlog_ring_dump(a_rule->ring, "api")) {
+			zc_error("zlog_ring_dump fail");
+			rc = -1;
+		}
+	}
+
+exit:
+	rd = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rd) {
+		zc_error("pthread_rwlock_unlock fail, rd=[%d]", rd);
+		return -1;
+	}
+	return rc;
+}
+
+/*******************************************************************************/
+static int zlog_set_category_level_inner(const char *cname, int level)
+{
+	int rc = 0;
+	int rd = 0;
+
+	/* categories of the rules in use read the bitmap, so under the write lock */
+	rd = pthread_rwlock_wrlock(&zlog_env_lock);
+	if (rd) {
+		zc_error("pthread_rwlock_wrlock fail, rd[%d]", rd);
+		return -1;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		rc = -1;
+		goto exit;
+	}
+
+	if (level >= 0 && (level == 0 || level > 254
+			|| !zc_arraylist_get(zlog_env_conf->levels, level))) {
+		zc_error("level[%d] is not in the level list", level);
+		rc = -1;
+		goto exit;
+	}
+
+	rc = zlog_category_table_set_level(zlog_env_categories, zlog_env_category_levels,
+			cname, level);
+	zc_debug("zlog_set_category_level[%s][%d], categories[%d]", cname, level, rc);
+
+exit:
+	rd = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rd) {
+		zc_error("pthread_rwlock_unlock fail, rd=[%d]", rd);
+		return -1;
+	}
+	return rc;
+}
+
+/*
+ * @brief 运行时改变分类的等级, 不用重载配置
+ *
+ * @param[in] cname: 分类名, 和规则里的一样, *是所有分类, aa_是aa和aa_xx, 其他是这个分类
+ * @param[in] level: 这个等级及以上的日志输出到分类的所有规则, 不管规则的等级, 直到重置.
+ *                   之后才获取的分类也一样
+ *
+ * @return 改变的已有分类个数 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_set_category_level(const char *cname, int level)
+{
+	zc_assert(cname, -1);
+	zc_assert(level >= 0, -1);
+
+	return zlog_set_category_level_inner(cname, level);
+}
+
+/*
+ * @brief 重置zlog_set_category_level()改变的等级, 分类重新按规则的等级输出
+ *
+ * @return 重置的分类个数 / -1: 失败
+ */
+int zlog_reset_category_level(const char *cname)
+{
+	zc_assert(cname, -1);
+
+	return zlog_set_category_level_inner(cname, -1);
+}
+
+/*
+ * @brief 改变调用线程的等级, 只对这个线程有效, 比如只对带调试标记的请求打开DEBUG
+ *
+ * @param[in] level: 这个线程这个等级及以上的日志输出到任何分类的所有规则,
+ *                   不管分类和规则的等级, 直到重置或者线程退出
+ *
+ * @return 0: 成功 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_set_thread_level(int level)
+{
+	int rc = 0;
+	zlog_thread_t *a_thread;
+
+	rc = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return -1;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		goto err;
+	}
+
+	if (level <= 0 || level > 254 || !zc_arraylist_get(zlog_env_conf->levels, level)) {
+		zc_error("level[%d] is not in the level list", level);
+		goto err;
+	}
+
+	zlog_fetch_thread(a_thread, err);
+	zlog_thread_set_level(a_thread, level);
+
+	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
+		return -1;
+	}
+	return 0;
+err:
+	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
+		return -1;
+	}
+	return -1;
+}
+
+/*
+ * @brief 重置zlog_set_thread_level()改变的等级, 调用线程重新按分类和规则的等级输出
+ */
+void zlog_reset_thread_level(void)
+{
+	int rc = 0;
+	zlog_thread_t *a_thread;
+
+	rc = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		goto exit;
+	}
+
+	/* a thread never logged has nothing to reset */
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (a_thread) zlog_thread_set_level(a_thread, -1);
+
+exit:
+	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
+		return;
+	}
+	return;
+}
+
+/*
+ * @brief 调用线程的名字改过了, 下一条日志的%N重新取名字
+ * 在pthread_setname_np()之后调用, 不调用的话%N一直是第一次取到的名字, 直到zlog_reload()
+ */
+void zlog_thread_name_changed(void)
+{
+	int rc = 0;
+	zlog_thread_t *a_thread;
+
+	rc = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_rdlock fail, rc[%d]", rc);
+		return;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		goto exit;
+	}
+
+	/* a thread never logged gets the name at the first %N */
+	a_thread = pthread_getspecific(zlog_thread_key);
+	if (a_thread) a_thread->event->thread_name_stale = 1;
+
+exit:
+	rc = pthread_rwlock_unlock(&zlog_env_lock);
+	if (rc) {
+		zc_error("pthread_rwlock_unlock fail, rc=[%d]", rc);
+		return;
+	}
+	return;
+}
+
+/*******************************************************************************/
+static int zlog_stats_snapshot_inner(zlog_stats_t * stats)
+{
+	int i;
+	size_t n;
+	zlog_rule_t *a_rule;
+	zc_hashtable_entry_t *a_entry;
+	zlog_category_t *a_category;
+
+	memset(stats, 0x00, sizeof(*stats));
+	zlog_stats_sum(stats);
+
+	n = 0;
+	zc_hashtable_foreach(zlog_env_categories, a_entry) {
+		n++;
+	}
+	stats->categories = calloc(n + 1, sizeof(zlog_stats_count_t));
+	stats->rules = calloc(zc_arraylist_len(zlog_env_conf->rules) + 1, sizeof(zlog_stats_count_t));
+	if (!stats->categories || !stats->rules) {
+		zc_error("calloc fail, errno[%d]", errno);
+		zlog_stats_free(stats);
+		return -1;
+	}
+
+	zc_hashtable_foreach(zlog_env_categories, a_entry) {
+		a_category = (zlog_category_t *)a_entry->value;
+		zlog_stats_slot_get(a_category->stats_slot,
+			stats->categories + stats->category_count++, a_category->name);
+	}
+	zc_arraylist_foreach(zlog_env_conf->rules, i, a_rule) {
+		zlog_stats_slot_get(a_rule->stats_slot,
+			stats->rules + stats->rule_count++, a_rule->name);
+	}
+	return 0;
+}
+
+/*
+ * @brief 取得日志统计的快照
+ *
+ * @return 0: 成功 / -1: 失败
+ * 详细错误会被写在由环境变量ZLOG_PROFILE_ERROR指定的错误日志里面.
+ */
+int zlog_stats_snapshot(zlog_stats_t * stats)
+{
+	int rc = 0;
+	int rd = 0;
+
+	zc_assert(stats, -1);
+
+	rd = pthread_rwlock_rdlock(&zlog_env_lock);
+	if (rd) {
+		zc_error("pthread_rwlock_rdlock fail, rd[%d]", rd);
+		return -1;
+	}
+
+	if (!zlog_env_is_init) {
+		zc_error("never call zlog_init() or dzlog_init() before");
+		rc = -1;
+		goto exit;
+	}
+
+	rc = zlog_stats_snapshot_inner(stats);
+
+exit:
 	rd = pthread_rwlock_unlock(&zlog_env_lock);
 	if (rd) {
 		zc_error("pthread_rwlock_unlock fail, rd=[%d]", rd);
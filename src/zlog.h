@@ -27,6 +27,7 @@ typedef struct zlog_category_s zlog_category_t;
 int zlog_init(const char *confpath);
 int zlog_reload(const char *confpath);
 void zlog_fini(void);
+int zlog_sync(void);
 
 void zlog_profile(void);
 
@@ -87,6 +88,126 @@ typedef struct zlog_msg_s {
 typedef int (*zlog_record_fn)(zlog_msg_t *msg);
 int zlog_set_record(const char *rname, zlog_record_fn record);
 
+/* 批量自定义输出
+ * 和zlog_set_record()一样绑定到$name规则上, 但是输出函数不在写日志的线程里调用.
+ * 日志被复制到一个队列, 由zlog的一个分发线程按顺序收集, 每次调用传入多条(最多256条).
+ * 缓冲区的生命周期:
+ *   msgs数组和其中buf, path指向的内容, 只在这次调用返回之前有效, 之后会被zlog重用.
+ *   在调用期间可以不复制直接使用. buf[len]和path都以'\0'结尾.
+ * 同一个name的输出函数只会被一个线程调用, 不需要加锁.
+ * 不要在输出函数里调用zlog写日志, zlog_fini()等分发线程结束时会死锁.
+ * fork()之后子进程有自己的分发线程, 父进程队列中的日志只由父进程输出.
+ * 队列满时写日志的线程会等待, 不会丢日志. zlog_fini()返回前队列中的日志都会被输出.
+ * 返回非0表示这一批输出失败, zlog只记录错误, 不会重试.
+ */
+typedef int (*zlog_record_batch_fn)(zlog_msg_t *msgs, size_t count);
+int zlog_set_record_batch(const char *rname, zlog_record_batch_fn record_batch);
+
+/* 内存飞行记录
+ * 规则 *.DEBUG $ring(64MB), "/tmp/my.ring.dump" 把日志写到进程内的环形缓冲区, 不写磁盘.
+ * 等级不低于dump_level(默认ERROR)的日志, dump_signal指定的信号, 或者zlog_dump_ring(),
+ * 会把缓冲区里上次导出之后的日志追加到导出文件.
+ * zlog_dump_ring()导出当前配置里所有的$ring规则, 返回0成功, -1有失败.
+ * 不要在信号处理函数里调用, 请用dump_signal.
+ */
+int zlog_dump_ring(void);
+
+/* 运行时改变分类的等级, 不用重载配置, 事故时临时打开某些分类的DEBUG
+ * cname和规则里的分类一样: *是所有分类, aa_是aa和aa_xx, 其他是这个分类.
+ * 这个等级及以上的日志输出到分类的所有规则, 不管规则的等级. zlog_reload()后依然有效,
+ * 直到zlog_reset_category_level(). 之后才zlog_get_category()的分类也会被设置,
+ * 多个cname匹配同一个分类时, 最后设置的有效.
+ * 返回改变的已有分类个数, -1失败. 写日志的路径上没有额外开销.
+ */
+int zlog_set_category_level(const char *cname, int level);
+int zlog_reset_category_level(const char *cname);
+
+/* 只改变调用线程的等级, 比如收到带调试标记的请求时打开DEBUG, 处理完重置,
+ * 其他线程和请求不受影响. 这个等级及以上的日志输出到任何分类的所有规则.
+ * 没有线程设置等级时写日志的路径上没有额外开销, 有的话过滤前多一次pthread_getspecific().
+ * zlog_set_thread_level()返回0成功, -1失败.
+ */
+int zlog_set_thread_level(int level);
+void zlog_reset_thread_level(void);
+
+/* %N的线程名每个线程第一次用到时取一次, 之后pthread_setname_np()改名字的话,
+ * 调用这个函数让下一条日志重新取. zlog_reload()后也会重新取.
+ */
+void zlog_thread_name_changed(void);
+
+/* 分类的这个等级会不会输出, 和写日志时的判断一样, 包括调用线程的等级. 1输出, 0不输出.
+ * 不加锁, 只读分类的位图, 拼日志内容很花时间时可以先判断.
+ */
+int zlog_level_enabled(zlog_category_t *category, const int level);
+
+/* 按调用点限速和采样
+ * zlog_xxx_ratelimited(cat, per_sec, burst, format, ...)
+ *   每个调用点一个令牌桶, 每秒per_sec条, 最多连续burst条, 超出的日志被丢弃并计数.
+ *   下一条通过的日志之前, 会先输出一条同等级的"suppressed N messages".
+ * zlog_xxx_sampled(cat, n, format, ...)
+ *   每个调用点每n条输出1条.
+ * 状态是调用点的static变量, 不用全局表, 不加锁, 多线程下也是原子操作.
+ * 等级不输出的调用先被zlog_level_enabled()挡住, 不取时间, 不消耗令牌, 也不计数.
+ */
+typedef struct zlog_ratelimit_s {
+	long long tat;			/* 下一条按速率应该到达的时间, ns */
+	unsigned long suppressed;
+	unsigned long count;		/* 采样计数 */
+} zlog_ratelimit_t;
+
+/* 返回1输出, 0丢弃. 输出时*suppressed是上次输出之后丢弃的条数 */
+int zlog_ratelimit(zlog_ratelimit_t *rl, double per_sec, long burst, unsigned long *suppressed);
+/* 返回1输出, 0丢弃 */
+int zlog_sample(zlog_ratelimit_t *rl, unsigned long n);
+
+/* 日志统计
+ * [global]中stats = true时开启, stats period = 60s和stats file = /tmp/zlog.stats
+ * 会每60秒把一份快照追加到stats file. 关闭时写日志的路径上没有任何额外开销.
+ * 计数按线程累加, 不加锁, 分类和规则的计数也在每个线程自己的块里, 快照时相加.
+ * lines和bytes是规则写出的条数和字节数, 一条日志被两个规则写出算两条,
+ * 分类的lines一条日志只算一次. 被dedup折叠的重复日志不计数.
+ * truncates是超过buffer max被截断的条数.
+ * format和output是每条日志在格式化和输出上花的时间(ns)的直方图,
+ * 每个2的幂分4个桶, 百分位的误差不超过25%.
+ * 规则的计数在zlog_reload()后从0开始, 其他计数一直累加.
+ */
+#define ZLOG_STATS_BUCKETS 256
+#define ZLOG_STATS_NAME_LEN 256
+
+typedef struct zlog_stats_hist_s {
+	unsigned long long count;
+	unsigned long long sum;		/* ns */
+	unsigned long long max;
+	unsigned long long buckets[ZLOG_STATS_BUCKETS];
+} zlog_stats_hist_t;
+
+typedef struct zlog_stats_count_s {
+	char name[ZLOG_STATS_NAME_LEN];	/* 分类名, 或者规则的"选择器 输出" */
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+} zlog_stats_count_t;
+
+typedef struct zlog_stats_s {
+	unsigned long long lines;
+	unsigned long long bytes;
+	unsigned long long errors;
+	unsigned long long truncates;
+	unsigned long long levels[256];	/* 按等级数值的条数 */
+	zlog_stats_hist_t format;
+	zlog_stats_hist_t output;
+	size_t category_count;
+	zlog_stats_count_t *categories;
+	size_t rule_count;
+	zlog_stats_count_t *rules;
+} zlog_stats_t;
+
+/* 返回0成功, -1失败. 成功后要用zlog_stats_free()释放categories和rules */
+int zlog_stats_snapshot(zlog_stats_t *stats);
+void zlog_stats_free(zlog_stats_t *stats);
+/* percent如99.9, 返回ns */
+unsigned long long zlog_stats_percentile(const zlog_stats_hist_t *hist, double percent);
+
 /******* useful macros, can be redefined at user's h file **********/
 
 /*
@@ -149,6 +270,48 @@ typedef enum {
 #define dzlog_debug(...) \
 	dzlog(__FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
 	ZLOG_LEVEL_DEBUG, __VA_ARGS__)
+/* rate limited and sampled zlog macros */
+#define zlog_ratelimited(cat, level, per_sec, burst, ...) do { \
+	static zlog_ratelimit_t zlog_rl_; \
+	unsigned long zlog_rl_n_; \
+	if (zlog_level_enabled(cat, level) \
+		&& zlog_ratelimit(&zlog_rl_, per_sec, burst, &zlog_rl_n_)) { \
+		if (zlog_rl_n_) zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, \
+			__LINE__, level, "suppressed %lu messages", zlog_rl_n_); \
+		zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
+			level, __VA_ARGS__); \
+	} \
+} while (0)
+#define zlog_sampled(cat, level, n, ...) do { \
+	static zlog_ratelimit_t zlog_rl_; \
+	if (zlog_level_enabled(cat, level) && zlog_sample(&zlog_rl_, n)) \
+		zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
+			level, __VA_ARGS__); \
+} while (0)
+#define zlog_fatal_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_FATAL, per_sec, burst, __VA_ARGS__)
+#define zlog_error_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_ERROR, per_sec, burst, __VA_ARGS__)
+#define zlog_warn_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_WARN, per_sec, burst, __VA_ARGS__)
+#define zlog_notice_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_NOTICE, per_sec, burst, __VA_ARGS__)
+#define zlog_info_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_INFO, per_sec, burst, __VA_ARGS__)
+#define zlog_debug_ratelimited(cat, per_sec, burst, ...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_DEBUG, per_sec, burst, __VA_ARGS__)
+#define zlog_fatal_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_FATAL, n, __VA_ARGS__)
+#define zlog_error_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_ERROR, n, __VA_ARGS__)
+#define zlog_warn_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_WARN, n, __VA_ARGS__)
+#define zlog_notice_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_NOTICE, n, __VA_ARGS__)
+#define zlog_info_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_INFO, n, __VA_ARGS__)
+#define zlog_debug_sampled(cat, n, ...) \
+	zlog_sampled(cat, ZLOG_LEVEL_DEBUG, n, __VA_ARGS__)
 #elif defined __GNUC__
 /* zlog macros */
 #define zlog_fatal(cat, format, args...) \
@@ -188,6 +351,48 @@ typedef enum {
 #define dzlog_debug(format, args...) \
 	dzlog(__FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
 	ZLOG_LEVEL_DEBUG, format, ##args)
+/* rate limited and sampled zlog macros */
+#define zlog_ratelimited(cat, level, per_sec, burst, format, args...) do { \
+	static zlog_ratelimit_t zlog_rl_; \
+	unsigned long zlog_rl_n_; \
+	if (zlog_level_enabled(cat, level) \
+		&& zlog_ratelimit(&zlog_rl_, per_sec, burst, &zlog_rl_n_)) { \
+		if (zlog_rl_n_) zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, \
+			__LINE__, level, "suppressed %lu messages", zlog_rl_n_); \
+		zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
+			level, format, ##args); \
+	} \
+} while (0)
+#define zlog_sampled(cat, level, n, format, args...) do { \
+	static zlog_ratelimit_t zlog_rl_; \
+	if (zlog_level_enabled(cat, level) && zlog_sample(&zlog_rl_, n)) \
+		zlog(cat, __FILE__, sizeof(__FILE__)-1, __func__, sizeof(__func__)-1, __LINE__, \
+			level, format, ##args); \
+} while (0)
+#define zlog_fatal_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_FATAL, per_sec, burst, format, ##args)
+#define zlog_error_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_ERROR, per_sec, burst, format, ##args)
+#define zlog_warn_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_WARN, per_sec, burst, format, ##args)
+#define zlog_notice_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_NOTICE, per_sec, burst, format, ##args)
+#define zlog_info_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_INFO, per_sec, burst, format, ##args)
+#define zlog_debug_ratelimited(cat, per_sec, burst, format, args...) \
+	zlog_ratelimited(cat, ZLOG_LEVEL_DEBUG, per_sec, burst, format, ##args)
+#define zlog_fatal_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_FATAL, n, format, ##args)
+#define zlog_error_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_ERROR, n, format, ##args)
+#define zlog_warn_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_WARN, n, format, ##args)
+#define zlog_notice_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_NOTICE, n, format, ##args)
+#define zlog_info_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_INFO, n, format, ##args)
+#define zlog_debug_sampled(cat, n, format, args...) \
+	zlog_sampled(cat, ZLOG_LEVEL_DEBUG, n, format, ##args)
 #endif
 
 /* vzlog macros */
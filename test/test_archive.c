@@ -0,0 +1,42 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "zlog.h"
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	zlog_category_t *zc;
+
+	rc = zlog_init("test_archive.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < 1000; i++) {
+		zlog_info(zc, "hello, zlog, archive retention test line %d", i);
+	}
+
+	/* janitor is in background, give it a round */
+	sleep(1);
+	printf("see ls -l test_archive.*.log, total size no more than 4KB\n");
+
+	zlog_fini();
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+/* the level set goes over the levels of rules, lasts over a reload,
+ * is set on categories got later, and the rules decide again after reset
+ */
+static const char *expect[] = {
+	"my_late_x DEBUG 0\n",	/* set before it is got */
+	"my_cat INFO 1\n",
+	"my_cat DEBUG 2\n",
+	"my_other DEBUG 2\n",
+	"my_cat DEBUG 3\n",	/* after reload */
+	"my_cat ERROR 4\n",
+	"my_cat INFO 5\n",	/* reset */
+	"my_other WARN 5\n",
+};
+
+static void log_all(zlog_category_t *zc, zlog_category_t *zo, const char *n)
+{
+	zlog_debug(zc, "%s", n);
+	zlog_info(zc, "%s", n);
+	zlog_debug(zo, "%s", n);
+	zlog_warn(zo, "%s", n);
+	return;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int n = 0;
+	char line[256];
+	FILE *fp;
+	zlog_category_t *zc;
+	zlog_category_t *zo;
+	zlog_category_t *zl;
+
+	unlink("test_category_level.log");
+	if (zlog_init("test_category_level.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	if (zlog_set_category_level("my_late_", ZLOG_LEVEL_DEBUG) != 0) rc = -1;
+	zl = zlog_get_category("my_late_x");
+	if (zl) zlog_debug(zl, "0");
+
+	zc = zlog_get_category("my_cat");
+	zo = zlog_get_category("my_other");
+	if (!zc || !zo || !zl) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_debug(zc, "1");
+	zlog_info(zc, "1");
+
+	/* all are my_xx */
+	if (zlog_set_category_level("my_", ZLOG_LEVEL_DEBUG) != 3) rc = -1;
+	zlog_debug(zc, "2");
+	zlog_debug(zo, "2");
+
+	if (zlog_reload(NULL)) rc = -1;
+	if (zlog_reset_category_level("my_other") != 1) rc = -1;
+	zlog_debug(zc, "3");
+	zlog_debug(zo, "3");
+
+	if (zlog_set_category_level("my_cat", ZLOG_LEVEL_ERROR) != 1) rc = -1;
+	zlog_info(zc, "4");
+	zlog_error(zc, "4");
+
+	if (zlog_reset_category_level("*") != 3) rc = -1;
+	/* 3 is not a level */
+	if (zlog_set_category_level("*", 3) != -1) rc = -1;
+	log_all(zc, zo, "5");
+	zlog_fini();
+
+	fp = fopen("test_category_level.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		printf("%s", line);
+		if (n >= sizeof(expect) / sizeof(expect[0]) || strcmp(line, expect[n])) rc = -1;
+		n++;
+	}
+	fclose(fp);
+	if (n != sizeof(expect) / sizeof(expect[0])) rc = -1;
+
+	unlink("test_category_level.log");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+static const char *expect[] = {
+	"ERROR disk full\n",
+	"ERROR last message repeated 999 times\n",
+	"ERROR disk ok\n",
+	"INFO disk ok\n",
+	"INFO last message repeated 9 times\n",
+	"WARN disk ok\n",
+	"WARN last message repeated 4 times\n",
+};
+
+/* the rule goes quiet, repeats are reported when the window ends, not at fini */
+static const char *expect_quiet[] = {
+	"ERROR storm\n",
+	"ERROR last message repeated 4 times\n",
+};
+
+static int check(const char *path, const char **expect, int count)
+{
+	int rc = 0;
+	int n = 0;
+	char line[256];
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		printf("fopen[%s] fail\n", path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		printf("%s", line);
+		if (n >= count || strcmp(line, expect[n])) rc = -1;
+		n++;
+	}
+	fclose(fp);
+	if (n != count) rc = -1;
+	return rc;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int i;
+	zlog_category_t *zc;
+	zlog_category_t *zq;
+
+	unlink("test_dedup.log");
+	unlink("test_dedup_quiet.log");
+	if (zlog_init("test_dedup.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	zq = zlog_get_category("my_quiet");
+	if (!zc || !zq) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < 1000; i++) {
+		zlog_error(zc, "disk %s", "full");
+	}
+	zlog_error(zc, "disk ok");
+	/* same message of another level is not a repeat */
+	for (i = 0; i < 10; i++) {
+		zlog_info(zc, "disk ok");
+	}
+	/* reported at fini */
+	for (i = 0; i < 5; i++) {
+		zlog_warn(zc, "disk ok");
+	}
+
+	for (i = 0; i < 5; i++) {
+		zlog_error(zq, "storm");
+	}
+	/* window of 1s, and a round of the worker */
+	sleep(3);
+	printf("--quiet--\n");
+	if (check("test_dedup_quiet.log", expect_quiet,
+			sizeof(expect_quiet) / sizeof(expect_quiet[0]))) rc = -1;
+	zlog_fini();
+
+	printf("--log--\n");
+	if (check("test_dedup.log", expect, sizeof(expect) / sizeof(expect[0]))) rc = -1;
+
+	unlink("test_dedup.log");
+	unlink("test_dedup_quiet.log");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
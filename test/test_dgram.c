@@ -0,0 +1,109 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "zlog.h"
+
+#define LINES 1000
+#define ERRORS 10
+
+static int sock;
+static long rfc5424_info;
+static long rfc5424_error;
+static long rfc3164_error;
+static long bad;
+
+/* a local unix datagram socket stands in for syslogd */
+static void *receive(void *ptr)
+{
+	ssize_t len;
+	char frame[2048];
+	struct timeval tv = {3, 0};
+
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	while ((len = recv(sock, frame, sizeof(frame) - 1, 0)) > 0) {
+		frame[len] = '\0';
+		if (rfc5424_info + rfc5424_error + rfc3164_error + bad == 0) printf("%s\n", frame);
+		if (frame[len - 1] == '\n') {
+			bad++;
+		} else if (strncmp(frame, "<134>1 ", 7) == 0) {
+			rfc5424_info++;
+		} else if (strncmp(frame, "<131>1 ", 7) == 0) {
+			rfc5424_error++;
+		} else if (strncmp(frame, "<131>", 5) == 0 && strstr(frame, "]: error ")) {
+			rfc3164_error++;
+		} else {
+			printf("bad frame[%s]\n", frame);
+			bad++;
+		}
+		if (rfc5424_info + rfc5424_error + rfc3164_error + bad == LINES + 2 * ERRORS) break;
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long i;
+	pthread_t tid;
+	struct sockaddr_un addr;
+	zlog_category_t *zc;
+
+	unlink("test_dgram.sock");
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, "test_dgram.sock");
+	sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+		printf("bind fail\n");
+		return -1;
+	}
+	pthread_create(&tid, NULL, receive, NULL);
+
+	rc = zlog_init("test_dgram.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < LINES; i++) {
+		zlog_info(zc, "info %ld", i);
+	}
+	for (i = 0; i < ERRORS; i++) {
+		zlog_error(zc, "error %ld", i);
+	}
+
+	/* senders send the rest before they stop */
+	zlog_fini();
+	pthread_join(tid, NULL);
+	close(sock);
+	unlink("test_dgram.sock");
+
+	printf("rfc5424 info[%ld] error[%ld], rfc3164 error[%ld], bad[%ld]\n",
+		rfc5424_info, rfc5424_error, rfc3164_error, bad);
+	rc = (rfc5424_info == LINES && rfc5424_error == ERRORS
+		&& rfc3164_error == ERRORS && bad == 0) ? 0 : -1;
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
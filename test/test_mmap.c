@@ -0,0 +1,150 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+
+#define THREADS 4
+#define LINES 100000
+
+static zlog_category_t *zc;
+
+static void *work(void *ptr)
+{
+	long i;
+	long id = (long)ptr;
+
+	for (i = 1; i < LINES; i++) {
+		zlog_info(zc, "%ld %ld", id, i);
+	}
+	return NULL;
+}
+
+/* parent and child run THREADS threads each, the child's ids follow */
+static void run(long first)
+{
+	long j;
+	pthread_t tid[THREADS];
+
+	for (j = 0; j < THREADS; j++) {
+		pthread_create(&(tid[j]), NULL, work, (void *)(first + j));
+	}
+	for (j = 0; j < THREADS; j++) {
+		pthread_join(tid[j], NULL);
+	}
+}
+
+/* every thread's lines are there one after another, nothing after them.
+ * return the number of lines, -1 for disorder or garbage
+ */
+static long check_file(const char *path, int from_start)
+{
+	FILE *fp;
+	long id;
+	long i;
+	long total = 0;
+	long next[2 * THREADS];
+
+	for (id = 0; id < 2 * THREADS; id++) next[id] = from_start ? 0 : -1;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while (fscanf(fp, "%ld %ld", &id, &i) == 2) {
+		if (id < 0 || id >= 2 * THREADS || (next[id] >= 0 && i != next[id])) {
+			printf("%s: thread %ld line %ld, but %ld expected\n", path, id, i, next[id]);
+			fclose(fp);
+			return -1;
+		}
+		next[id] = i + 1;
+		total++;
+	}
+	fgetc(fp);
+	if (!feof(fp)) {
+		printf("%s: garbage after line %ld\n", path, total);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	return total;
+}
+
+static int check(void)
+{
+	int n;
+	long total;
+	char path[64];
+	struct stat st;
+
+	total = check_file("test_mmap.log", 1);
+	printf("%ld lines in order\n", total);
+	if (total != 2 * THREADS * LINES) return -1;
+
+	/* rotated by both processes, still no hole and no line out of order */
+	if (check_file("test_mmap_rotate.log", 0) < 0) return -1;
+	for (n = 0; n < 3; n++) {
+		snprintf(path, sizeof(path), "test_mmap_rotate.log.%d", n);
+		if (stat(path, &st) || st.st_size > 2 * 1024 * 1024 + 64 * 1024
+			|| check_file(path, 0) < 0) {
+			printf("rotate fail, %s\n", path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int status;
+	long j;
+	pid_t pid;
+
+	system("rm -f test_mmap.log* test_mmap_rotate.log*");
+	rc = zlog_init("test_mmap.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* the first lines before, so the child inherits an open mapping */
+	for (j = 0; j < 2 * THREADS; j++) {
+		zlog_info(zc, "%ld 0", j);
+	}
+
+	/* a child appends to the same file, in step with the parent */
+	pid = fork();
+	if (pid == 0) {
+		run(THREADS);
+		zlog_fini();
+		_exit(0);
+	}
+	run(0);
+	waitpid(pid, &status, 0);
+
+	/* the file is truncated to the real length at close */
+	zlog_fini();
+	rc = check();
+
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "zlog.h"
+
+#define LINES 10000
+
+static long count_lines(const char *path)
+{
+	FILE *fp;
+	int c;
+	long n = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '\n') n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+/* lines may be dropped when the spool is full, but never cut or out of order */
+static long check_order(const char *path)
+{
+	FILE *fp;
+	long i;
+	long last = -1;
+	long n = 0;
+	char tail;
+
+	fp = fopen(path, "r");
+	if (!fp) return -1;
+	while (fscanf(fp, "%ld%c", &i, &tail) == 2) {
+		if (i <= last || tail != '\n') {
+			printf("line %ld after %ld\n", i, last);
+			fclose(fp);
+			return -1;
+		}
+		last = i;
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long i;
+	long ms;
+	long lines;
+	long restarted;
+	struct timeval start, end;
+	zlog_category_t *zc;
+	zlog_category_t *stuck;
+	zlog_category_t *dying;
+
+	unlink("test_pipe_full.log");
+	unlink("test_pipe_full.restart.log");
+	rc = zlog_init("test_pipe_full.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	stuck = zlog_get_category("my_dog");
+	dying = zlog_get_category("my_pig");
+	if (!zc || !stuck || !dying) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* a child which reads nothing does not block the writer */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < LINES; i++) {
+		zlog_info(zc, "%ld", i);
+		zlog_info(stuck, "%0100ld", i);
+	}
+	gettimeofday(&end, NULL);
+	ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+
+	/* head exits after one line, it is started again for the next */
+	for (i = 0; i < 3; i++) {
+		zlog_info(dying, "line %ld", i);
+		usleep(1200 * 1000);
+	}
+
+	zlog_fini();
+
+	lines = check_order("test_pipe_full.log");
+	restarted = count_lines("test_pipe_full.restart.log");
+	printf("%ld lines in %ld ms, %ld lines by restarted child\n", lines, ms, restarted);
+
+	rc = (lines > 0 && ms < 1000 && restarted == 3) ? 0 : -1;
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
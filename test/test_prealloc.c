@@ -0,0 +1,70 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "zlog.h"
+
+#define CHUNK (1024 * 1024)
+
+static int show(const char *when, struct stat *info)
+{
+	if (stat("test_prealloc.log", info)) {
+		printf("stat fail\n");
+		return -1;
+	}
+	printf("%s: size[%ld], allocated[%ld]\n", when,
+		(long)info->st_size, (long)info->st_blocks * 512);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	struct stat info;
+	zlog_category_t *zc;
+
+	unlink("test_prealloc.log");
+	rc = zlog_init("test_prealloc.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < 10000; i++) {
+		zlog_info(zc, "hello, zlog, preallocate test line %d", i);
+	}
+
+	/* at least half a chunk is kept ahead of the end */
+	rc = show("before fini, allocated ahead of size", &info);
+	if (!rc && (long)info.st_blocks * 512 < (long)info.st_size + CHUNK / 2) {
+		printf("not allocated ahead\n");
+		rc = -1;
+	}
+
+	/* nothing beyond the last block is kept */
+	zlog_fini();
+	if (!rc) rc = show("after fini, trimmed", &info);
+	if (!rc && (long)info.st_blocks * 512 >= (long)info.st_size + 64 * 1024) {
+		printf("not trimmed\n");
+		rc = -1;
+	}
+
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
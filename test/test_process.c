@@ -0,0 +1,91 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "zlog.h"
+
+/* %p and %k of a child after fork are its own, not of the parent,
+ * %N is got again after the thread tells a rename
+ */
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int lines = 0;
+	long pid;
+	long ktid;
+	long real_pid;
+	long real_ktid;
+	pid_t child;
+	char line[512];
+	char name[17];
+	char host[257];
+	char host_name[257];
+	FILE *fp;
+	zlog_category_t *zc;
+
+	unlink("test_process.log");
+	if (zlog_init("test_process.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	pthread_setname_np(pthread_self(), "zlog-test");
+	zlog_info(zc, "%ld %ld", (long)getpid(), (long)syscall(SYS_gettid));
+	child = fork();
+	if (child == 0) {
+		zlog_info(zc, "%ld %ld", (long)getpid(), (long)syscall(SYS_gettid));
+		zlog_fini();
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+	zlog_info(zc, "%ld %ld", (long)getpid(), (long)syscall(SYS_gettid));
+	pthread_setname_np(pthread_self(), "zlog-renamed");
+	zlog_thread_name_changed();
+	zlog_info(zc, "%ld %ld", (long)getpid(), (long)syscall(SYS_gettid));
+	zlog_fini();
+
+	memset(host_name, 0x00, sizeof(host_name));
+	gethostname(host_name, sizeof(host_name) - 1);
+
+	fp = fopen("test_process.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		printf("%s", line);
+		lines++;
+		if (sscanf(line, "%ld %ld %16s %256s %ld %ld",
+				&pid, &ktid, name, host, &real_pid, &real_ktid) != 6
+			|| pid != real_pid || ktid != real_ktid
+			|| strcmp(name, lines < 4 ? "zlog-test" : "zlog-renamed")
+			|| strcmp(host, host_name)) {
+			rc = -1;
+		}
+	}
+	fclose(fp);
+	if (lines != 4) rc = -1;
+
+	unlink("test_process.log");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+#define STORM 1000
+#define BURST 5
+
+/* one call site, one limit */
+static void storm(zlog_category_t *zc, int i)
+{
+	zlog_error_ratelimited(zc, 1, BURST, "storm %d", i);
+}
+
+/* calls of a level not output take no token and are not counted */
+static void quiet(zlog_category_t *zq, int level, int i)
+{
+	zlog_ratelimited(zq, level, 1, BURST, "quiet %d", i);
+	zlog_sampled(zq, level, 10, "quiet sample %d", i);
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int i;
+	long n;
+	long storms = 0;
+	long sample = 0;
+	long suppressed = 0;
+	long quiets = 0;
+	char line[256];
+	FILE *fp;
+	zlog_category_t *zc;
+	zlog_category_t *zq;
+
+	unlink("test_ratelimit.log");
+	if (zlog_init("test_ratelimit.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	zq = zlog_get_category("my_quiet");
+	if (!zc || !zq) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* 1 line a second, 5 at once, the rest of the storm is suppressed */
+	for (i = 0; i < STORM; i++) {
+		storm(zc, i);
+	}
+	sleep(1);
+	storm(zc, i);
+
+	for (i = 0; i < 100; i++) {
+		zlog_debug_sampled(zc, 10, "sample %d", i);
+	}
+
+	/* my_quiet is INFO, so only the last one, with nothing suppressed */
+	for (i = 1; i < STORM; i++) {
+		quiet(zq, ZLOG_LEVEL_DEBUG, i);
+	}
+	quiet(zq, ZLOG_LEVEL_INFO, i);
+	zlog_fini();
+
+	fp = fopen("test_ratelimit.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "quiet sample %ld", &n) == 1
+				|| sscanf(line, "quiet %ld", &n) == 1) {
+			if (n != STORM) rc = -1;
+			quiets++;
+		} else if (sscanf(line, "storm %ld", &n) == 1) {
+			storms++;
+		} else if (sscanf(line, "sample %ld", &n) == 1) {
+			if (n % 10) rc = -1;
+			sample++;
+		} else if (sscanf(line, "suppressed %ld messages", &n) == 1) {
+			suppressed = n;
+		} else {
+			printf("bad line[%s]\n", line);
+			rc = -1;
+		}
+	}
+	fclose(fp);
+
+	printf("storm[%ld] suppressed[%ld] sample[%ld] quiet[%ld]\n", storms, suppressed, sample, quiets);
+	if (storms != BURST + 1 || suppressed != STORM - BURST || sample != 10) rc = -1;
+	if (quiets != 2) rc = -1;
+
+	unlink("test_ratelimit.log");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "zlog.h"
+
+#define THREADS 4
+#define LINES 10000
+
+static zlog_category_t *zc;
+static long next[THREADS];
+static long total;
+static long calls;
+static long bad;
+static long forks;
+static long childs;
+static volatile int busy;
+static volatile int inside;
+
+/* called by one dispatcher thread, no lock here */
+int output_batch(zlog_msg_t *msgs, size_t count)
+{
+	size_t i;
+	long id;
+	long n;
+
+	calls++;
+	for (i = 0; i < count; i++) {
+		if (strcmp(msgs[i].buf, "fork\n") == 0) {
+			forks++;
+			continue;
+		}
+		if (strcmp(msgs[i].buf, "child\n") == 0) {
+			childs++;
+			continue;
+		}
+		if (msgs[i].buf[msgs[i].len] != '\0' || strcmp(msgs[i].path, "mypath my_cat")
+			|| sscanf(msgs[i].buf, "%ld %ld", &id, &n) != 2
+			|| id < 0 || id >= THREADS || n != next[id]) {
+			bad++;
+			continue;
+		}
+		next[id]++;
+		total++;
+	}
+
+	/* the sink is busy when the parent forks */
+	inside = 1;
+	while (busy) usleep(1000);
+	return 0;
+}
+
+/* the child gets a dispatcher of its own, and never the parent's msgs */
+static int fork_check(void)
+{
+	pid_t pid;
+	int status;
+
+	busy = 1;
+	zlog_info(zc, "fork");
+	while (!inside) usleep(1000);
+	/* left in the spool while the sink is busy */
+	zlog_info(zc, "fork");
+
+	pid = fork();
+	if (pid < 0) {
+		printf("fork fail\n");
+		busy = 0;
+		return -1;
+	} else if (pid == 0) {
+		busy = 0;
+		alarm(10);
+		total = forks = childs = 0;
+		zlog_info(zc, "child");
+		zlog_fini();
+		printf("child %ld msgs, %ld child, %ld fork\n", total, childs, forks);
+		fflush(stdout);
+		_exit((childs == 1 && forks == 0 && total == 0) ? 0 : 1);
+	}
+
+	busy = 0;
+	if (waitpid(pid, &status, 0) != pid) return -1;
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static void *work(void *ptr)
+{
+	long i;
+	long id = (long)ptr;
+
+	for (i = 0; i < LINES; i++) {
+		zlog_info(zc, "%ld %ld", id, i);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long j;
+	pthread_t tid[THREADS];
+
+	rc = zlog_init("test_record_batch.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zlog_set_record_batch("mybatch", output_batch);
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (j = 0; j < THREADS; j++) {
+		pthread_create(&(tid[j]), NULL, work, (void *)j);
+	}
+	for (j = 0; j < THREADS; j++) {
+		pthread_join(tid[j], NULL);
+	}
+
+	rc = fork_check();
+
+	/* all msgs are given to output_batch before zlog_fini() returns */
+	zlog_fini();
+
+	printf("%ld msgs in %ld calls, %ld bad, %ld fork\n", total, calls, bad, forks);
+	if (total != THREADS * LINES || bad != 0 || forks != 2) rc = -1;
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zlog.h"
+
+/* the ring rule is the same in every conf, so a reload keeps it with
+ * the lines in it, the dump has lines from before the reloads.
+ * the file rule changes its time format, not the count of time caches,
+ * a thread must not print what it cached for the old one.
+ * a reload failing in the middle leaves the kept rule as it was.
+ */
+static const char *expect_log[] = {
+	"Y1\n",
+	"X2\n",
+	"X3\n",		/* the reload before failed */
+	"X4\n",
+};
+
+static const char *expect_dump[] = {
+	"INFO 1\n",
+	"INFO 2\n",
+	"INFO 3\n",
+	"ERROR 4\n",
+};
+
+static int write_conf(const char *time_format, const char *file_format)
+{
+	FILE *fp;
+
+	fp = fopen("test_reload_keep.conf", "w");
+	if (!fp) return -1;
+	fprintf(fp, "[formats]\nsimple = \"%%V %%m%%n\"\n"
+		"t = \"%%d(%s)%%m%%n\"\n"
+		"[rules]\nmy_cat.* $ring(4KB), \"test_reload_keep.dump\"; simple\n"
+		"my_cat.* \"test_reload_keep.log\"; %s\n", time_format, file_format);
+	return fclose(fp);
+}
+
+static int check(const char *path, const char **expect, int count, int skip_header)
+{
+	int rc = 0;
+	int n = 0;
+	char line[256];
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		printf("fopen[%s] fail\n", path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (skip_header && strncmp(line, "====", 4) == 0) continue;
+		printf("%s", line);
+		if (n >= count || strcmp(line, expect[n])) rc = -1;
+		n++;
+	}
+	fclose(fp);
+	if (n != count) rc = -1;
+	return rc;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	zlog_category_t *zc;
+
+	unlink("test_reload_keep.log");
+	unlink("test_reload_keep.dump");
+	if (write_conf("Y", "t") || zlog_init("test_reload_keep.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_info(zc, "1");
+
+	if (write_conf("X", "t") || zlog_reload(NULL)) {
+		printf("reload fail\n");
+		rc = -1;
+	}
+	zlog_info(zc, "2");
+
+	if (write_conf("X", "no_such_format") || !zlog_reload(NULL)) {
+		printf("reload of a bad conf does not fail\n");
+		rc = -1;
+	}
+	zlog_info(zc, "3");
+	zlog_error(zc, "4");
+	zlog_fini();
+
+	printf("--log--\n");
+	if (check("test_reload_keep.log", expect_log,
+			sizeof(expect_log) / sizeof(expect_log[0]), 0)) rc = -1;
+	printf("--dump--\n");
+	if (check("test_reload_keep.dump", expect_dump,
+			sizeof(expect_dump) / sizeof(expect_dump[0]), 1)) rc = -1;
+
+	unlink("test_reload_keep.log");
+	unlink("test_reload_keep.dump");
+	unlink("test_reload_keep.conf");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define THREADS 4
+#define LINES 20000
+
+static zlog_category_t *zc;
+
+/* lines of each dump in the file, and lines not made by zlog */
+static int dumps;
+static int lines[16];
+static int bad;
+static char last[16][256];
+
+static void check_dump(void)
+{
+	FILE *fp;
+	int t;
+	long n;
+	char line[512];
+
+	dumps = 0;
+	bad = 0;
+	memset(lines, 0x00, sizeof(lines));
+	fp = fopen("test_ring.dump", "r");
+	if (!fp) return;
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "==== zlog ring dump", 19) == 0) {
+			if (dumps < 15) dumps++;
+			continue;
+		}
+		if (sscanf(line, "DEBUG debug %ld\n", &n) != 1
+			&& sscanf(line, "DEBUG thread %d %ld\n", &t, &n) != 2
+			&& strcmp(line, "ERROR error\n")) {
+			printf("bad line[%s]\n", line);
+			bad++;
+		}
+		lines[dumps]++;
+		strcpy(last[dumps], line);
+	}
+	fclose(fp);
+	return;
+}
+
+static void *work(void *ptr)
+{
+	long i;
+	long t = (long)ptr;
+
+	for (i = 0; i < LINES; i++) {
+		zlog_debug(zc, "thread %ld %ld", t, i);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	long i;
+	pthread_t tid[THREADS];
+
+	unlink("test_ring.dump");
+	if (zlog_init("test_ring.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* much more than the ring holds, nothing on disk */
+	for (i = 0; i < 1000; i++) {
+		zlog_debug(zc, "debug %ld", i);
+	}
+	if (access("test_ring.dump", F_OK) == 0) {
+		printf("debug lines reach disk\n");
+		rc = -1;
+	}
+
+	/* an error dumps the latest lines, with itself at the end */
+	zlog_error(zc, "error");
+	check_dump();
+	printf("error dump: %d lines, last[%s]\n", lines[1], last[1]);
+	if (dumps != 1 || lines[1] < 100 || lines[1] > 4096 / 15
+		|| strcmp(last[1], "ERROR error\n")) rc = -1;
+
+	/* only lines after the last dump */
+	for (i = 0; i < 3; i++) zlog_debug(zc, "debug %ld", i);
+	zlog_dump_ring();
+	check_dump();
+	printf("api dump: %d lines\n", lines[2]);
+	if (dumps != 2 || lines[2] != 3) rc = -1;
+
+	for (i = 0; i < 2; i++) zlog_debug(zc, "debug %ld", i);
+	raise(SIGUSR2);
+	sleep(1);
+	check_dump();
+	printf("signal dump: %d lines\n", lines[3]);
+	if (dumps != 3 || lines[3] != 2) rc = -1;
+
+	/* dump while writers go round and round */
+	for (i = 0; i < THREADS; i++) {
+		pthread_create(&tid[i], NULL, work, (void *)i);
+	}
+	for (i = 0; i < 10; i++) {
+		zlog_dump_ring();
+		usleep(1000);
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(tid[i], NULL);
+	}
+	zlog_dump_ring();
+	zlog_fini();
+
+	check_dump();
+	printf("dumps[%d] bad[%d]\n", dumps, bad);
+	if (bad) rc = -1;
+
+	unlink("test_ring.dump");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
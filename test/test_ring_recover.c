@@ -0,0 +1,95 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "zlog.h"
+
+#define DUMPED 100
+#define LOST 50
+
+/* lines from zlog-recover must be debug [from] ... debug [to - 1] */
+static int check(const char *cmd, long from, long to)
+{
+	FILE *fp;
+	long n;
+	long i = from;
+	char line[256];
+
+	fp = popen(cmd, "r");
+	if (!fp) {
+		printf("popen [%s] fail\n", cmd);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "DEBUG debug %ld", &n) != 1 || n != i) {
+			printf("[%s] expect[%ld] get[%s]\n", cmd, i, line);
+			pclose(fp);
+			return -1;
+		}
+		i++;
+	}
+	if (pclose(fp) || i != to) {
+		printf("[%s] got [%ld] lines, expect [%ld]\n", cmd, i - from, to - from);
+		return -1;
+	}
+	printf("[%s] got [%ld] lines\n", cmd, i - from);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int status;
+	long i;
+	pid_t pid;
+	struct rlimit rl = {0, 0};
+	zlog_category_t *zc;
+
+	unlink("test_ring_recover.ring");
+	unlink("test_ring_recover.dump");
+
+	pid = fork();
+	if (pid == 0) {
+		/* crash without a core file */
+		setrlimit(RLIMIT_CORE, &rl);
+		if (zlog_init("test_ring_recover.conf")) {
+			printf("init failed\n");
+			_exit(1);
+		}
+		zc = zlog_get_category("my_cat");
+		for (i = 0; i < DUMPED; i++) {
+			zlog_debug(zc, "debug %ld", i);
+		}
+		zlog_dump_ring();
+		for (; i < DUMPED + LOST; i++) {
+			zlog_debug(zc, "debug %ld", i);
+		}
+		abort();
+	}
+	waitpid(pid, &status, 0);
+	if (!WIFSIGNALED(status)) {
+		printf("child does not crash\n");
+		return -1;
+	}
+
+	/* lines after the last dump, then all lines */
+	if (check("LD_LIBRARY_PATH=../src ../src/zlog-recover -q test_ring_recover.ring", DUMPED, DUMPED + LOST)) rc = -1;
+	if (check("LD_LIBRARY_PATH=../src ../src/zlog-recover -q -a test_ring_recover.ring", 0, DUMPED + LOST)) rc = -1;
+
+	unlink("test_ring_recover.ring");
+	unlink("test_ring_recover.dump");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
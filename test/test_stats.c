@@ -0,0 +1,143 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define CHECK(expr) do { \
+	if (!(expr)) { \
+		printf("check [%s] fail\n", #expr); \
+		rc = -1; \
+	} \
+} while (0)
+
+/* counters of a thread gone are kept */
+static void *work(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		zlog_info((zlog_category_t *)arg, "thread %d", i);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int i;
+	size_t j;
+	char big[4000];
+	char line[256];
+	FILE *fp;
+	zlog_stats_t stats;
+	zlog_category_t *zc;
+	pthread_t tid;
+
+	unlink("test_stats.log");
+	unlink("test_stats.err.log");
+	unlink("test_stats.dump");
+	if (zlog_init("test_stats.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = 0; i < 100; i++) {
+		zlog_info(zc, "info %d", i);
+	}
+	/* to both rules */
+	for (i = 0; i < 10; i++) {
+		zlog_error(zc, "error %d", i);
+	}
+	/* over buffer max, cut and not written */
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	zlog_info(zc, "%s", big);
+
+	if (pthread_create(&tid, NULL, work, zc)) {
+		printf("pthread_create fail\n");
+		zlog_fini();
+		return -1;
+	}
+	pthread_join(tid, NULL);
+
+	if (zlog_stats_snapshot(&stats)) {
+		printf("zlog_stats_snapshot fail\n");
+		zlog_fini();
+		return -1;
+	}
+	printf("lines[%llu] bytes[%llu] errors[%llu] truncates[%llu]\n",
+		stats.lines, stats.bytes, stats.errors, stats.truncates);
+	printf("format p50[%llu] p99[%llu] output p50[%llu] p99[%llu] max[%llu]\n",
+		zlog_stats_percentile(&stats.format, 50),
+		zlog_stats_percentile(&stats.format, 99),
+		zlog_stats_percentile(&stats.output, 50),
+		zlog_stats_percentile(&stats.output, 99),
+		stats.output.max);
+
+	CHECK(stats.lines == 131);
+	CHECK(stats.errors == 1);
+	CHECK(stats.truncates == 1);
+	CHECK(stats.levels[ZLOG_LEVEL_INFO] == 111);
+	CHECK(stats.levels[ZLOG_LEVEL_ERROR] == 20);
+	CHECK(stats.format.count == 131);
+	CHECK(stats.output.count == 131);
+	CHECK(stats.output.max > 0);
+	CHECK(zlog_stats_percentile(&stats.output, 99) <= stats.output.max);
+
+	CHECK(stats.category_count == 1);
+	for (j = 0; j < stats.category_count; j++) {
+		printf("category[%s] lines[%llu] bytes[%llu]\n", stats.categories[j].name,
+			stats.categories[j].lines, stats.categories[j].bytes);
+		CHECK(stats.categories[j].lines == 121);
+		CHECK(stats.categories[j].bytes == stats.bytes);
+	}
+	CHECK(stats.rule_count == 2);
+	for (j = 0; j < stats.rule_count; j++) {
+		printf("rule[%s] lines[%llu] bytes[%llu]\n", stats.rules[j].name,
+			stats.rules[j].lines, stats.rules[j].bytes);
+	}
+	if (stats.rule_count == 2) {
+		CHECK(stats.rules[0].lines == 121);
+		CHECK(stats.rules[1].lines == 10);
+		CHECK(stats.rules[0].bytes + stats.rules[1].bytes == stats.bytes);
+	}
+	zlog_stats_free(&stats);
+
+	/* stats period */
+	sleep(2);
+	zlog_fini();
+
+	fp = fopen("test_stats.dump", "r");
+	CHECK(fp != NULL);
+	if (fp) {
+		i = 0;
+		while (fgets(line, sizeof(line), fp)) {
+			if (strstr(line, "category[my_cat] lines[121]")) i++;
+		}
+		fclose(fp);
+		CHECK(i > 0);
+	}
+
+	unlink("test_stats.log");
+	unlink("test_stats.err.log");
+	unlink("test_stats.dump");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
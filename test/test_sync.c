@@ -0,0 +1,54 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+#include "zlog.h"
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int i;
+	double start;
+	zlog_category_t *zc;
+
+	rc = zlog_init("test_sync.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* writers only count lines, syncer thread does fdatasync */
+	start = now();
+	for (i = 0; i < 100000; i++) {
+		zlog_info(zc, "hello, zlog, sync test line %d", i);
+	}
+	printf("write 100000 lines, %f s\n", now() - start);
+
+	start = now();
+	rc = zlog_sync();
+	printf("zlog_sync rc[%d], %f s\n", rc, now() - start);
+
+	zlog_profile();
+	zlog_fini();
+	return 0;
+}
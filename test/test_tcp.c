@@ -0,0 +1,132 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "zlog.h"
+
+#define LINES 3000
+
+static int sock;
+static long got;
+static long bad;
+
+/* a local listener stands in for the collector */
+static void *receive(void *ptr)
+{
+	int fd;
+	uint32_t net;
+	size_t len;
+	char line[256];
+	char expect[256];
+
+	fd = accept(sock, NULL, NULL);
+	if (fd < 0) {
+		printf("accept fail\n");
+		return NULL;
+	}
+	while (recv(fd, &net, sizeof(net), MSG_WAITALL) == sizeof(net)) {
+		len = ntohl(net);
+		if (len >= sizeof(line)
+			|| recv(fd, line, len, MSG_WAITALL) != (ssize_t)len) {
+			bad++;
+			break;
+		}
+		line[len] = '\0';
+		sprintf(expect, "line %ld\n", got);
+		if (strcmp(line, expect)) {
+			if (bad == 0) printf("expect[%s] get[%s]\n", expect, line);
+			bad++;
+		}
+		got++;
+	}
+	close(fd);
+	return NULL;
+}
+
+static int log_lines(long from, long to)
+{
+	long i;
+	zlog_category_t *zc;
+
+	if (zlog_init("test_tcp.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (i = from; i < to; i++) {
+		zlog_info(zc, "line %ld", i);
+	}
+
+	zlog_fini();
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	int on = 1;
+	pthread_t tid;
+	struct stat stb;
+	struct sockaddr_in addr;
+
+	unlink("test_tcp.overflow");
+
+	/* collector is down, lines go to spool, overflow file, and stay there */
+	if (log_lines(0, LINES)) return -1;
+	if (stat("test_tcp.overflow", &stb) || stb.st_size == 0) {
+		printf("nothing saved in overflow file\n");
+		return -1;
+	}
+	printf("saved [%ld] bytes\n", (long)stb.st_size);
+
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(19514);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(sock, 4)) {
+		printf("listen fail\n");
+		return -1;
+	}
+	pthread_create(&tid, NULL, receive, NULL);
+
+	/* collector is up, saved lines go first */
+	if (log_lines(LINES, 2 * LINES)) return -1;
+	pthread_join(tid, NULL);
+	close(sock);
+
+	if (stat("test_tcp.overflow", &stb) == 0 && stb.st_size != 0) {
+		printf("[%ld] bytes left in overflow file\n", (long)stb.st_size);
+		bad++;
+	}
+	unlink("test_tcp.overflow");
+
+	printf("got[%ld] bad[%ld]\n", got, bad);
+	rc = (got == 2 * LINES && bad == 0) ? 0 : -1;
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+/* the level set on a thread is only of that thread,
+ * the other thread keeps the level of the rule
+ */
+static const char *expect[] = {
+	"my_cat DEBUG traced\n",
+	"my_cat INFO traced\n",
+	"my_cat INFO other\n",
+	"my_cat ERROR quiet\n",
+	"my_cat INFO reset\n",
+};
+
+static zlog_category_t *zc;
+
+static void *other(void *arg)
+{
+	zlog_debug(zc, "other");
+	zlog_info(zc, "other");
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int n = 0;
+	char line[256];
+	FILE *fp;
+	pthread_t tid;
+
+	unlink("test_thread_level.log");
+	if (zlog_init("test_thread_level.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	if (zlog_set_thread_level(ZLOG_LEVEL_DEBUG)) rc = -1;
+	zlog_debug(zc, "traced");
+	zlog_info(zc, "traced");
+
+	pthread_create(&tid, NULL, other, NULL);
+	pthread_join(tid, NULL);
+
+	/* a level higher than the rule is kept too */
+	if (zlog_set_thread_level(ZLOG_LEVEL_ERROR)) rc = -1;
+	zlog_info(zc, "quiet");
+	zlog_error(zc, "quiet");
+
+	/* 3 is not a level */
+	if (zlog_set_thread_level(3) != -1) rc = -1;
+	zlog_reset_thread_level();
+	zlog_debug(zc, "reset");
+	zlog_info(zc, "reset");
+	zlog_fini();
+
+	fp = fopen("test_thread_level.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		printf("%s", line);
+		if (n >= sizeof(expect) / sizeof(expect[0]) || strcmp(line, expect[n])) rc = -1;
+		n++;
+	}
+	fclose(fp);
+	if (n != sizeof(expect) / sizeof(expect[0])) rc = -1;
+
+	unlink("test_thread_level.log");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
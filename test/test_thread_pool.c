@@ -0,0 +1,101 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define THREADS 20
+
+static zlog_category_t *zc;
+
+/* even threads put mdc, an odd one after must not see it */
+static void *work(void *arg)
+{
+	long i = (long)arg;
+
+	if (i % 2 == 0) zlog_put_mdc("who", "even");
+	zlog_info(zc, "%lu %ld", (unsigned long)pthread_self(), i);
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	long i;
+	long n;
+	int lines = 0;
+	char line[256];
+	char tid[64];
+	char who[64];
+	char self[64];
+	FILE *fp;
+	pthread_t tids[THREADS];
+
+	unlink("test_thread_pool.log");
+	if (zlog_init("test_thread_pool.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	/* one after another, each takes the state the last one left */
+	for (i = 0; i < THREADS; i++) {
+		pthread_create(tids + i, NULL, work, (void *)i);
+		pthread_join(tids[i], NULL);
+	}
+	/* and some at once */
+	for (i = 0; i < THREADS; i++) {
+		pthread_create(tids + i, NULL, work, (void *)i);
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(tids[i], NULL);
+	}
+	zlog_fini();
+
+	fp = fopen("test_thread_pool.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		lines++;
+		if (sscanf(line, "%63s [%63[^]]] %63s %ld", tid, who, self, &n) != 4) {
+			/* no mdc, who is empty */
+			who[0] = '\0';
+			if (sscanf(line, "%63s [] %63s %ld", tid, self, &n) != 3) {
+				printf("bad line %s", line);
+				rc = -1;
+				continue;
+			}
+		}
+		if (strcmp(tid, self)) {
+			printf("tid of another thread: %s", line);
+			rc = -1;
+		}
+		if (strcmp(who, n % 2 == 0 ? "even" : "")) {
+			printf("mdc of another thread: %s", line);
+			rc = -1;
+		}
+	}
+	fclose(fp);
+	if (lines != THREADS * 2) rc = -1;
+
+	unlink("test_thread_pool.log");
+	printf("%d lines, check %s\n", lines, rc ? "fail" : "ok");
+	return rc;
+}
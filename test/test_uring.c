@@ -0,0 +1,91 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "zlog.h"
+
+#define THREADS 4
+#define LINES 100000
+
+static zlog_category_t *zc;
+
+static void *work(void *ptr)
+{
+	long i;
+	long id = (long)ptr;
+
+	for (i = 0; i < LINES; i++) {
+		zlog_info(zc, "%ld %ld", id, i);
+	}
+	return NULL;
+}
+
+/* every thread's lines are all there and in order */
+static int check(void)
+{
+	FILE *fp;
+	long id;
+	long i;
+	long total = 0;
+	long next[THREADS] = {0};
+
+	fp = fopen("test_uring.log", "r");
+	if (!fp) return -1;
+	while (fscanf(fp, "%ld %ld", &id, &i) == 2) {
+		if (id < 0 || id >= THREADS || i != next[id]) {
+			printf("thread %ld line %ld, but %ld expected\n", id, i, next[id]);
+			fclose(fp);
+			return -1;
+		}
+		next[id]++;
+		total++;
+	}
+	fclose(fp);
+	printf("%ld lines in order\n", total);
+	return (total == THREADS * LINES) ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+	int rc;
+	long j;
+	pthread_t tid[THREADS];
+
+	unlink("test_uring.log");
+	rc = zlog_init("test_uring.conf");
+	if (rc) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	for (j = 0; j < THREADS; j++) {
+		pthread_create(&(tid[j]), NULL, work, (void *)j);
+	}
+	for (j = 0; j < THREADS; j++) {
+		pthread_join(tid[j], NULL);
+	}
+
+	/* lines are in the file after zlog_sync */
+	zlog_sync();
+	rc = check();
+	zlog_fini();
+
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}
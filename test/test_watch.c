@@ -0,0 +1,102 @@
+/*
+ * This file is part of the zlog Library.
+ *
+ * Copyright (C) 2011 by Hardy Simpson <HardySimpson1984@gmail.com>
+ *
+ * Licensed under the LGPL v2.1, see the file COPYING in base directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "zlog.h"
+
+/* the conf is changed under a running zlog, the watch worker sees it
+ * within reload conf interval, and the log call after reloads.
+ * it is done in a forked child, as a prefork server does, the watch
+ * worker is started again there by the 1st log call
+ */
+static const char *expect[] = {
+	"A 1\n",
+	"A 2\n",	/* in the child, starts the watch worker */
+	"A 3\n",	/* reloads after it is written */
+	"B 4\n",
+};
+
+static int write_conf(const char *format)
+{
+	FILE *fp;
+
+	fp = fopen("test_watch.conf", "w");
+	if (!fp) return -1;
+	fprintf(fp, "[global]\nreload conf interval = 1s\n"
+		"[formats]\nsimple = \"%s %%m%%n\"\n"
+		"[rules]\nmy_cat.* \"test_watch.log\"; simple\n", format);
+	return fclose(fp);
+}
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int n = 0;
+	int status;
+	char line[256];
+	FILE *fp;
+	pid_t pid;
+	zlog_category_t *zc;
+
+	unlink("test_watch.log");
+	if (write_conf("A") || zlog_init("test_watch.conf")) {
+		printf("init failed\n");
+		return -1;
+	}
+	zc = zlog_get_category("my_cat");
+	if (!zc) {
+		printf("get cat fail\n");
+		zlog_fini();
+		return -2;
+	}
+
+	zlog_info(zc, "1");
+	pid = fork();
+	if (pid < 0) {
+		printf("fork fail\n");
+		zlog_fini();
+		return -1;
+	} else if (pid == 0) {
+		zlog_info(zc, "2");
+		if (write_conf("B")) {
+			printf("write conf fail\n");
+			rc = -1;
+		}
+		sleep(3);
+		zlog_info(zc, "3");
+		zlog_info(zc, "4");
+		zlog_fini();
+		_exit(rc ? 1 : 0);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) rc = -1;
+	zlog_fini();
+
+	fp = fopen("test_watch.log", "r");
+	if (!fp) {
+		printf("fopen fail\n");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		printf("%s", line);
+		if (n >= sizeof(expect) / sizeof(expect[0]) || strcmp(line, expect[n])) rc = -1;
+		n++;
+	}
+	fclose(fp);
+	if (n != sizeof(expect) / sizeof(expect[0])) rc = -1;
+
+	unlink("test_watch.log");
+	unlink("test_watch.conf");
+	printf("check %s\n", rc ? "fail" : "ok");
+	return rc;
+}